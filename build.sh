@@ -1,7 +1,13 @@
 #!/bin/bash
+# ./build.sh float : single precision fields and update coefficients
+precision=""
+if [ "$1" == "float" ]; then
+  precision="-DWASMEM_SINGLE_PRECISION"
+fi
+
 rm -rf payload
 rm -f wasmem.wasm;
-emcc wasmem.cpp -s STANDALONE_WASM -fno-exceptions -DNDEBUG -std=c++14 -Wall -O3 -msimd128 --no-entry -o wasmem.wasm;
+emcc wasmem.cpp $precision -s STANDALONE_WASM -fno-exceptions -DNDEBUG -std=c++14 -Wall -O3 -msimd128 -s ALLOW_MEMORY_GROWTH=1 -s MAXIMUM_MEMORY=2GB --no-entry -o wasmem.wasm;
 
 mkdir payload
 mv wasmem.wasm payload/.
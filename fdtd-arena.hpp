@@ -0,0 +1,68 @@
+#pragma once
+
+// One aligned heap block carved into typed arrays (bump allocation).
+// The block is only ever released as a whole; reserve() reuses it when large enough.
+class fdtdArena
+{
+public:
+  static const size_t alignment = 64; // cache line (and widest SIMD register)
+
+  fdtdArena() : block(nullptr), base(nullptr), capacity(0), used(0) {}
+  ~fdtdArena() { release(); }
+
+  fdtdArena(const fdtdArena&) = delete;
+  fdtdArena& operator=(const fdtdArena&) = delete;
+
+  // number of bytes needed to hold count objects of type T (with alignment padding)
+  template <typename T>
+  static size_t footprint(size_t count) {
+    return roundUp(count * sizeof(T));
+  }
+
+  // make room for (at least) bytes; previous allocations are invalidated
+  bool reserve(size_t bytes) {
+    used = 0;
+    if (bytes <= capacity)
+      return true;
+    release();
+    block = std::malloc(bytes + alignment);
+    if (block == nullptr)
+      return false;
+    const uintptr_t p = reinterpret_cast<uintptr_t>(block);
+    base = reinterpret_cast<char*>((p + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+    capacity = bytes;
+    return true;
+  }
+
+  void release() {
+    std::free(block);
+    block = nullptr;
+    base = nullptr;
+    capacity = 0;
+    used = 0;
+  }
+
+  // returns nullptr if the reserved block is exhausted
+  template <typename T>
+  T* allocate(size_t count) {
+    const size_t bytes = footprint<T>(count);
+    if (base == nullptr || used + bytes > capacity)
+      return nullptr;
+    T* p = reinterpret_cast<T*>(base + used);
+    used += bytes;
+    return p;
+  }
+
+  size_t bytesize() const { return capacity; }
+  size_t bytesUsed() const { return used; }
+
+private:
+  void* block;
+  char* base;
+  size_t capacity;
+  size_t used;
+
+  static size_t roundUp(size_t bytes) {
+    return (bytes + alignment - 1) & ~(alignment - 1);
+  }
+};
@@ -0,0 +1,227 @@
+#pragma once
+
+// Bloch-periodic boundaries, for band structure runs on a single unit cell of a periodic medium.
+// A Bloch mode of wavevector k has F(x + a) = F(x) exp(i k.a) for every lattice vector a, so one
+// cell carries the whole lattice when the seams apply that phase. The fields are complex; they are
+// held as two real solvers (real and imaginary part), which run the ordinary real kernels and only
+// mix at the seams: the H a period to the left of (below) the first column (row) is the one next
+// to the last column (row) times exp(-i k.a), and the last column (row) of Ez is the image of the
+// first one times exp(i k.a). With k = 0 this is the periodic solver, bit for bit.
+//
+// A band diagram sweeps k over the edge of the Brillouin zone (|kx|, |ky| <= pi / a), exciting each
+// cell with a broadband source off any symmetry point and reading the resonances from the spectrum
+// of Ez at a few nodes. The cells are small and independent, so a sweep is run as a batch (see
+// advanceBloch()).
+
+namespace TMz {
+
+template <typename T>
+class fdtdBlochCell
+{
+public:
+  fdtdBlochCell() : NX(0), NY(0), kx(0.0), ky(0.0), cx(1.0), sx(0.0), cy(1.0), sy(0.0) {}
+
+  fdtdBlochCell(const fdtdBlochCell&) = delete;
+  fdtdBlochCell& operator=(const fdtdBlochCell&) = delete;
+
+  // Unit cell of nx-by-ny nodes: the lattice periods are nx - 1 and ny - 1 cells (the last column
+  // and row are the images of the first). Starts at k = 0 with zero fields and no source.
+  // Returns false if the dimensions are invalid or the allocation failed.
+  bool initialize(int nx,
+                  int ny,
+                  double xmin,
+                  double ymin,
+                  double delta)
+  {
+    NX = 0;
+    NY = 0;
+    if (!re.initialize(nx, ny, xmin, ymin, delta) || !im.initialize(nx, ny, xmin, ymin, delta))
+      return false;
+    NX = nx;
+    NY = ny;
+    // the seams are applied here; the solvers leave their edges alone
+    re.setPECX();
+    re.setPECY();
+    im.setPECX();
+    im.setPECY();
+    re.sourceType(fdtdSourceType::NoSource);
+    im.sourceType(fdtdSourceType::NoSource);
+    setWavevector(0.0, 0.0);
+    return true;
+  }
+
+  int getNX() const { return NX; }
+  int getNY() const { return NY; }
+  double getPeriodX() const { return re.getXmax() - re.getXmin(); }
+  double getPeriodY() const { return re.getYmax() - re.getYmin(); }
+
+  // Bloch wavevector (radians per unit length; the phase across the cell is kx getPeriodX(), ...);
+  // the fields are kept, the seam images are remade
+  void setWavevector(double kx,
+                     double ky)
+  {
+    this->kx = kx;
+    this->ky = ky;
+    cx = static_cast<T>(std::cos(kx * getPeriodX()));
+    sx = static_cast<T>(std::sin(kx * getPeriodX()));
+    cy = static_cast<T>(std::cos(ky * getPeriodY()));
+    sy = static_cast<T>(std::sin(ky * getPeriodY()));
+    makeImages();
+  }
+
+  double getWavevectorX() const { return kx; }
+  double getWavevectorY() const { return ky; }
+
+  // The two parts. The source is taken from real() (a real excitation; imag() has none); kernels
+  // and tile widths may be set on either. Media and the Courant number go through the cell, so that
+  // both parts keep the same coefficients. The edges must stay as they are (PEC, for the seams).
+  fdtdSolver<T>& real() { return re; }
+  fdtdSolver<T>& imag() { return im; }
+  const fdtdSolver<T>& real() const { return re; }
+  const fdtdSolver<T>& imag() const { return im; }
+
+  bool setCourant(double c) { return re.setCourant(c) && im.setCourant(c); }
+
+  int defineMaterial(double mur,
+                     double epr,
+                     double sigmam,
+                     double sigma)
+  {
+    const int id = re.defineMaterial(mur, epr, sigmam, sigma);
+    im.defineMaterial(mur, epr, sigmam, sigma);
+    return id;
+  }
+
+  // (paint a medium the same in the last column and row as in the first, which they image)
+  void paintMaterial(int id,
+                     int ix0,
+                     int iy0,
+                     int ix1,
+                     int iy1)
+  {
+    re.paintMaterial(id, ix0, iy0, ix1, iy1);
+    im.paintMaterial(id, ix0, iy0, ix1, iy1);
+  }
+
+  // zero fields and update count (the source restarts)
+  void reset() {
+    re.reset();
+    im.reset();
+  }
+
+  // complex Ez at a node
+  void getEz(int ix,
+             int iy,
+             double& a,
+             double& b) const
+  {
+    a = re.dataEz()[NX * iy + ix];
+    b = im.dataEz()[NX * iy + ix];
+  }
+
+  // Ez of the last column and row from the first ones; call after setting fields by hand
+  // (through the row accessors of the solvers)
+  void makeImages() {
+    if (NX == 0)
+      return;
+    T* er0 = re.rowEz(0);
+    T* ei0 = im.rowEz(0);
+    T* er1 = re.rowEz(NY - 1);
+    T* ei1 = im.rowEz(NY - 1);
+    for (int ix = 0; ix < NX - 1; ix++) {
+      const T a = er0[ix];
+      const T b = ei0[ix];
+      er1[ix] = cy * a - sy * b;
+      ei1[ix] = sy * a + cy * b;
+    }
+    for (int iy = 0; iy < NY; iy++) {
+      T* er = re.rowEz(iy);
+      T* ei = im.rowEz(iy);
+      const T a = er[0];
+      const T b = ei[0];
+      er[NX - 1] = cx * a - sx * b;
+      ei[NX - 1] = sx * a + cx * b;
+    }
+  }
+
+  // nsteps timesteps; false (without stepping) for the (2,4) stencil, the fourth order integrator,
+  // or parts that have come apart in their Courant numbers
+  bool advance(int nsteps) {
+    if (re.getStencil() != fdtdStencilType::SecondOrder || im.getStencil() != fdtdStencilType::SecondOrder ||
+        re.getIntegrator() != fdtdIntegratorType::Leapfrog || im.getIntegrator() != fdtdIntegratorType::Leapfrog ||
+        re.getCourant() != im.getCourant())
+      return false;
+    for (int n = 0; n < nsteps; n++) {
+      re.updateHRows(0, NY);
+      im.updateHRows(0, NY);
+      re.updateERows(1, NY - 1);
+      im.updateERows(1, NY - 1);
+      updateSeams();
+      re.applySourceRows(0, NY);
+      makeImages();
+      re.finishSteps(1);
+      im.finishSteps(1);
+    }
+    return true;
+  }
+
+private:
+  int NX;
+  int NY;
+  double kx;
+  double ky;
+  T cx; // cos and sin of the phase across the cell in x
+  T sx;
+  T cy; // and in y
+  T sy;
+  fdtdSolver<T> re;
+  fdtdSolver<T> im;
+
+  // Ez of the first column and the first row, with the H across the seams from the far side of the
+  // cell times exp(-i k.a): (a + i b)(c - i s) = (c a + s b) + i (c b - s a)
+  void updateSeams() {
+    const T* hxr = re.dataHx();
+    const T* hxi = im.dataHx();
+    const T* hyr = re.dataHy();
+    const T* hyi = im.dataHy();
+    const int top = NX * (NY - 2); // the Hx row below the last row, which the first row images
+    for (int iy = 1; iy < NY - 1; iy++) {
+      const int l = NX * iy + NX - 2;
+      const int s = NX * (iy - 1);
+      re.updateEzNodeWith(0, iy, cx * hyr[l] + sx * hyi[l], hxr[s]);
+      im.updateEzNodeWith(0, iy, cx * hyi[l] - sx * hyr[l], hxi[s]);
+    }
+    for (int ix = 1; ix < NX - 1; ix++) {
+      const int s = top + ix;
+      re.updateEzNodeWith(ix, 0, hyr[ix - 1], cy * hxr[s] + sy * hxi[s]);
+      im.updateEzNodeWith(ix, 0, hyi[ix - 1], cy * hxi[s] - sy * hxr[s]);
+    }
+    const int l = NX - 2;
+    re.updateEzNodeWith(0, 0, cx * hyr[l] + sx * hyi[l], cy * hxr[top] + sy * hxi[top]);
+    im.updateEzNodeWith(0, 0, cx * hyi[l] - sx * hyr[l], cy * hxi[top] - sy * hxr[top]);
+  }
+};
+
+// nsteps on each of count cells (one per k-point, say), spread over the threads of the pool; the
+// cells only share the pool, so each runs in cache on one thread (keep the cells' own solvers at a
+// single thread). Returns false if a cell could not step.
+template <typename T>
+bool advanceBloch(fdtdBlochCell<T>* cells,
+                  int count,
+                  int nsteps,
+                  fdtdThreadPool& pool)
+{
+  const int nt = pool.size();
+  bool ok[fdtdThreadPool::maxThreads];
+  auto job = [&](int t) {
+    ok[t] = true;
+    for (int c = t; c < count; c += nt)
+      ok[t] = cells[c].advance(nsteps) && ok[t];
+  };
+  pool.run(job);
+  for (int t = 0; t < nt; t++)
+    if (!ok[t]) return false;
+  return true;
+}
+
+}
@@ -5,4 +5,8 @@ const double vacuum_permittivity = 8.854187812813 * 1.0e-12; // [F / m]
 const double vacuum_impedance = std::sqrt(vacuum_permeability / vacuum_permittivity);
 const double vacuum_velocity = 1.0 / std::sqrt(vacuum_permeability * vacuum_permittivity);
 const double courant_factor = 1.0 / std::sqrt(2.0);
+const double courant_factor_24 = 0.3; // FDTD(2,4), well below its limit of 0.606 (the time error dominates at 0.6)
+const double courant_limit = 1.0 / std::sqrt(2.0); // largest stable Courant numbers in 2D: Yee leapfrog,
+const double courant_limit_24 = 6.0 / (7.0 * std::sqrt(2.0)); // FDTD(2,4),
+const double courant_limit_t4 = 2.0133607664497; // and Yee with the fourth order time integrator (8 S^2 = L, L (1 - L / 24)^2 = 4)
 const double two_pi = 2.0 * M_PI;
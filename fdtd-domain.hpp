@@ -0,0 +1,212 @@
+#pragma once
+
+// Domain decomposition of one fdtdSolver grid over several ranks (processes), in slabs of rows.
+// Each rank runs an fdtdSolver on its own rows plus one halo row below and above (where it has
+// a neighbour; the rows across the periodic y seam are held in row buffers instead, so the layout
+// does not depend on the y boundaries). Only two halo quantities cross ranks in TMz: Ez of the
+// row above (for Hx of the top row) and Hx of the row below (for Ez of the bottom row); Hy is
+// row local.
+
+// Point-to-point messages between ranks. send() is buffered (returns once data may be reused),
+// recv() blocks; messages from one rank to another arrive in the order sent. Both return false
+// on failure (tags are checked to catch a driver that got out of step).
+class fdtdTransport
+{
+public:
+  virtual ~fdtdTransport() {}
+  virtual int rank() const = 0;
+  virtual int size() const = 0;
+  virtual bool send(int dst, int tag, const void* data, size_t bytes) = 0;
+  virtual bool recv(int src, int tag, void* data, size_t bytes) = 0;
+};
+
+namespace TMz {
+
+template <typename T>
+class fdtdDomain
+{
+public:
+  fdtdDomain() : comm(nullptr), NX(0), NY(0), g0(0), g1(0), lo(0), wrapHx(nullptr), wrapHxBelow(nullptr) {}
+  ~fdtdDomain() { std::free(wrapHx); std::free(wrapHxBelow); }
+
+  fdtdDomain(const fdtdDomain&) = delete;
+  fdtdDomain& operator=(const fdtdDomain&) = delete;
+
+  // Collective: all ranks call with the same global grid; rows are split evenly.
+  // Returns false if a slab would fall below the solver's minimum grid size.
+  bool initialize(fdtdTransport* transport,
+                  int nx,
+                  int ny,
+                  double xmin,
+                  double ymin,
+                  double delta)
+  {
+    comm = transport;
+    NX = nx;
+    NY = ny;
+    const int r = comm->rank();
+    const int p = comm->size();
+    g0 = (ny * r) / p;
+    g1 = (ny * (r + 1)) / p;
+    periodicY = true; // as fdtdSolver::initialize()
+    absorbingY = false;
+    if (!layout())
+      return false;
+    return sub.initialize(nx, hi - lo, xmin, ymin + lo * delta, delta) && setupEdges();
+  }
+
+  // the subdomain solver: kernels, media, source, x boundaries and the Courant number are set on it
+  // directly (the same on every rank; the Yee stencil and the leapfrog integrator only, see
+  // advance()); positions are physical, so they mean the same on every rank
+  fdtdSolver<T>& local() { return sub; }
+  const fdtdSolver<T>& local() const { return sub; }
+
+  // owned global rows [firstRow(), endRow()); global row g is local row g - localOffset()
+  int firstRow() const { return g0; }
+  int endRow() const { return g1; }
+  int localOffset() const { return lo; }
+
+  // y boundaries are global; choose them before the fields are set (there is no border taper).
+  // They leave the settings of local() alone, so the two can be made in either order.
+  // The local solver's own CPML in y would put layers at the slab edges too; advance() refuses it.
+  bool setPeriodicY() { periodicY = true; absorbingY = false; return setupEdges(); }
+  bool setAbsorbingY() { periodicY = false; absorbingY = true; return setupEdges(); }
+  bool setPECY() { periodicY = false; absorbingY = false; return setupEdges(); }
+  bool isPeriodicY() const { return periodicY; }
+  bool isAbsorbingY() const { return absorbingY; }
+
+  // material painting in global cell indices
+  void paintMaterial(int id,
+                     int ix0,
+                     int iy0,
+                     int ix1,
+                     int iy1)
+  {
+    sub.paintMaterial(id, ix0, iy0 - lo, ix1, iy1 - lo);
+  }
+
+  // Collective: nsteps timesteps, bit-identical to fdtdSolver::advance() on the whole grid.
+  // Halo rows are sent as soon as they are final and received only right before they are
+  // needed, so the transfers overlap the update of the rows that do not touch a halo.
+  // Returns false without stepping if the local solver has the (2,4) stencil, which would
+  // need two halo rows, or the fourth order integrator (whose sweeps these row updates do not
+  // make), or a Courant number above the leapfrog limit, or CPML layers in y.
+  bool advance(int nsteps) {
+    if (sub.getStencil() != fdtdStencilType::SecondOrder ||
+        sub.getIntegrator() != fdtdIntegratorType::Leapfrog ||
+        sub.getCourant() > courant_limit ||
+        sub.isCPMLY())
+      return false;
+    const int r = comm->rank();
+    const int p = comm->size();
+    const bool below = (r > 0);
+    const bool above = (r < p - 1);
+    const size_t rowBytes = sizeof(T) * NX;
+    const int b = g0 - lo; // local row of the first owned row
+    const int t = g1 - lo; // local end row
+    bool ok = true;
+
+    for (int n = 0; n < nsteps && ok; n++) {
+      // H; the top row needs Ez from the rank above
+      if (below) ok = ok && comm->send(r - 1, tagEz, sub.rowEz(b), rowBytes);
+      sub.updateHRows(b, above ? t - 1 : t);
+      if (above) {
+        ok = ok && comm->recv(r + 1, tagEz, sub.rowEz(t), rowBytes);
+        sub.updateHRows(t - 1, t);
+      }
+
+      // E; the bottom row needs Hx from the rank below (with periodic y, the seams use the other side)
+      if (above) ok = ok && comm->send(r + 1, tagHx, sub.rowHx(t - 1), rowBytes);
+      if (periodicY && r == p - 1) ok = ok && comm->send(0, tagWrapUp, sub.rowHx(t - 2), rowBytes);
+      if (periodicY && r == 0) ok = ok && comm->send(p - 1, tagWrapDown, sub.rowHx(b), rowBytes);
+
+      const bool seamBottom = (periodicY && r == 0);
+      const bool seamTop = (periodicY && r == p - 1);
+      sub.updateERows(b + 1, seamTop ? t - 1 : t);
+      if (below) {
+        ok = ok && comm->recv(r - 1, tagHx, sub.rowHx(b - 1), rowBytes);
+        sub.updateERows(b, b + 1);
+      }
+      if (seamBottom) {
+        ok = ok && comm->recv(p - 1, tagWrapUp, wrapHxBelow, rowBytes);
+        sub.updateEzRowWith(b, sub.rowHx(b), wrapHxBelow);
+      }
+      if (seamTop) {
+        ok = ok && comm->recv(0, tagWrapDown, wrapHx, rowBytes);
+        sub.updateEzRowWith(t - 1, wrapHx, sub.rowHx(t - 2));
+      }
+
+      if (r == 0) sub.updateEdgeBottom();
+      if (r == p - 1) sub.updateEdgeTop();
+      sub.applySourceRows(b, t);
+      sub.finishSteps(1);
+    }
+    return ok;
+  }
+
+  // Collective: rank 0 receives the owned rows of every rank into the NX * NY arrays
+  // (which are only touched on rank 0)
+  bool gather(T* ez,
+              T* hx,
+              T* hy)
+  {
+    const int r = comm->rank();
+    const size_t bytes = sizeof(T) * NX * (g1 - g0);
+    if (r != 0) {
+      return comm->send(0, tagGather, sub.rowEz(g0 - lo), bytes) &&
+             comm->send(0, tagGather, sub.rowHx(g0 - lo), bytes) &&
+             comm->send(0, tagGather, sub.rowHy(g0 - lo), bytes);
+    }
+    std::memcpy(ez, sub.rowEz(g0 - lo), bytes);
+    std::memcpy(hx, sub.rowHx(g0 - lo), bytes);
+    std::memcpy(hy, sub.rowHy(g0 - lo), bytes);
+    for (int q = 1; q < comm->size(); q++) {
+      const int q0 = (NY * q) / comm->size();
+      const int q1 = (NY * (q + 1)) / comm->size();
+      const size_t qbytes = sizeof(T) * NX * (q1 - q0);
+      if (!comm->recv(q, tagGather, ez + NX * q0, qbytes) ||
+          !comm->recv(q, tagGather, hx + NX * q0, qbytes) ||
+          !comm->recv(q, tagGather, hy + NX * q0, qbytes))
+        return false;
+    }
+    return true;
+  }
+
+private:
+  enum { tagEz = 1, tagHx = 2, tagWrapUp = 3, tagWrapDown = 4, tagGather = 5 };
+
+  fdtdTransport* comm;
+  int NX;
+  int NY;
+  int g0; // owned global rows [g0, g1)
+  int g1;
+  int lo; // local rows are global [lo, hi)
+  int hi;
+  bool periodicY;
+  bool absorbingY;
+  T* wrapHx; // Hx of global row 0, for the top seam with periodic y (last rank)
+  T* wrapHxBelow; // Hx of global row NY - 2, for the bottom seam (first rank)
+  fdtdSolver<T> sub;
+
+  // halo below for all but the first rank, halo above for all but the last rank;
+  // the Mur edges need 3 rows at the global edges
+  bool layout() {
+    const int r = comm->rank();
+    const int p = comm->size();
+    lo = (r > 0 ? g0 - 1 : g0);
+    hi = (r < p - 1 ? g1 + 1 : g1);
+    std::free(wrapHx);
+    std::free(wrapHxBelow);
+    wrapHx = (r == p - 1 ? static_cast<T*>(std::malloc(sizeof(T) * NX)) : nullptr);
+    wrapHxBelow = (r == 0 ? static_cast<T*>(std::malloc(sizeof(T) * NX)) : nullptr);
+    return g1 - g0 >= 3 && hi - lo >= fdtdSolver<T>::minimumGridSize;
+  }
+
+  bool setupEdges() {
+    const int r = comm->rank();
+    sub.setEdgesY(absorbingY && r == 0, absorbingY && r == comm->size() - 1);
+    return true;
+  }
+};
+
+}
@@ -0,0 +1,909 @@
+#pragma once
+
+// Rasterizer for the fields of an fdtdSolver: the bilinear image of fdtdSolver::rasterizeEz()
+// (the same up to rounding), written row by row. The grid column and x weights of every pixel
+// column, and the grid row and y weight of every pixel row, are tabulated once per viewport (with
+// the mirror images of symmetry planes folded into them). A pixel row then blends its two grid
+// rows over the columns in view (vector code), picks pairs out of that line with the column
+// table, and maps the values to colormap indices (vector code again) into a packed table of
+// RGBA words (rgb_packed_table).
+//
+// renderEzNodes() colors the grid nodes themselves, one pixel each (or every step-th node, as a
+// preview of a large grid), for the caller to scale up (in the browser: drawImage() with
+// smoothing). Its cost goes with the number of nodes shown rather than the size of the screen.
+//
+// The same pass draws H and the quantities derived from it (fdtdFieldType). The H components are
+// staggered half a cell off the nodes (Hx[iy] at y + 1/2, Hy[ix] at x + 1/2), so a grid row is
+// first brought to the nodes: each component is interpolated from the two edges on either side
+// (by the cell sizes, on a graded mesh; across a periodic seam or a symmetry plane from the edge
+// on the far side or its mirror image, and from the one edge inside at other boundaries), and
+// the quantity is formed there. Only the two grid rows a pixel row blends are held (and kept
+// while the pixel rows stay between them), so no field is stored at full size.
+//
+// The colormap index stage also counts every fourth pixel of a row into a coarse histogram
+// (histogramBins bins over the color range and as much again on either side, the outermost ones
+// open), from which renderedPercentile() and autoRange() read a color range for the next frame:
+// robust against a few hot cells, and without a pass of its own. With a log scale
+// (setColorScale()) the index goes with log |value| (from the float bits, logBits() in
+// fdtd-simd.hpp), and the histogram with it.
+//
+// A window that takes in two grid cells or more per pixel (along both axes; uniform meshes) samples a
+// level of a mip pyramid instead: the field halved in resolution level times, each time through the
+// halfband filter of halfband.hpp (on every other node, then every other row; edges held). Only that
+// level is stored. The rows of the grid stream through the levels below it, each of which holds
+// just the few rows its filter spans, so the memory goes with the screen rather than the grid. The
+// pyramid is refreshed lazily, from the render call: a frame brings in grid rows worth
+// setPyramidBudget() nodes per pixel, carrying on where the last one stopped, so the frame time
+// stays bounded by the screen size whatever the grid (parts of the image lag by a frame or
+// a few on very large grids). The level is built whole the first time it is sampled (and again
+// after a change of field or zoom level).
+
+namespace TMz {
+
+// What fdtdRaster draws, in the units of Ez (so that one color range fits all of them): H as
+// vacuum_impedance H, the energy density over the vacuum permittivity, (epr Ez^2 + mur (eta0 H)^2) / 2,
+// and the magnitude of the Poynting vector E x H times vacuum_impedance, |Ez| eta0 |H|. H is half a
+// step behind Ez (as in energyB()).
+enum class fdtdFieldType {
+  Ez,
+  Hx,
+  Hy,
+  MagnitudeH,
+  EnergyDensity,
+  MagnitudeS
+};
+
+enum class fdtdColorScale {
+  Linear,
+  Logarithmic
+};
+
+template <typename T>
+class fdtdRaster
+{
+public:
+  fdtdRaster()
+    : W(0), H(0), colorScale(fdtdColorScale::Linear), lastColorScale(fdtdColorScale::Linear),
+      lastScale(1.0), lastOffset(0.0), lowest(0.0), highest(0.0), count(0),
+      pyramidBudget(4), level(0), built(0)
+  {
+    HalfbandFilter<pyramidK> hbf;
+    hbf.init();
+    for (int n = -pyramidK; n <= pyramidK; n++)
+      taps[n + pyramidK] = static_cast<T>(hbf.coefficient(n));
+  }
+
+  fdtdRaster(const fdtdRaster&) = delete;
+  fdtdRaster& operator=(const fdtdRaster&) = delete;
+
+  // The tables are rebuilt when the window, the image size, the grid size or extent, the mesh
+  // type, the periodic edges, the symmetry planes or the field change; call this after setGrid()
+  // moves the points in between (the pyramid is rebuilt too).
+  void invalidate() {
+    W = 0;
+    built = 0;
+  }
+
+  // Grid nodes per image pixel brought into the pyramid per frame (4 by default); 0 refreshes all of
+  // it every frame, and -1 turns the pyramid off (the grid is sampled directly at any zoom)
+  void setPyramidBudget(int nodesPerPixel) {
+    pyramidBudget = nodesPerPixel;
+    invalidate();
+  }
+
+  // the pyramid level the last window was drawn from (0: the grid itself)
+  int getPyramidLevel() const { return level; }
+
+  // A field of the solver over the window as in rasterizeEz(): (xmin, ymin) is the lower left pixel,
+  // and (xmax, ymax) the upper right corner; values in [vmin, vmax] span the colormap lut[256]
+  void renderField(const fdtdSolver<T>& s,
+                   fdtdFieldType field,
+                   uint32_t* imgdata,
+                   int w,
+                   int h,
+                   const uint32_t* lut,
+                   double vmin,
+                   double vmax,
+                   double xmin,
+                   double xmax,
+                   double ymin,
+                   double ymax)
+  {
+    if (imgdata == nullptr || !validRange(vmin, vmax) || w < 1 || h < 1)
+      return;
+    if (prepare(s, field, w, h, xmin, xmax, ymin, ymax, 0))
+      render(s, imgdata, lut, vmin, vmax);
+  }
+
+  void renderEz(const fdtdSolver<T>& s,
+                uint32_t* imgdata,
+                int w,
+                int h,
+                const uint32_t* lut,
+                double ezmin,
+                double ezmax,
+                double xmin,
+                double xmax,
+                double ymin,
+                double ymax)
+  {
+    renderField(s, fdtdFieldType::Ez, imgdata, w, h, lut, ezmin, ezmax, xmin, xmax, ymin, ymax);
+  }
+
+  // Size of the image of renderEzNodes(): every step-th node of the whole (unfolded) grid, from the
+  // first one (the image of the last one with a symmetry plane) and from the top row down
+  static int nodesWidth(const fdtdSolver<T>& s,
+                        int step)
+  {
+    const int n = (s.getSymmetryX() == fdtdSymmetryType::NoSymmetry ? s.getNX() : 2 * s.getNX() - 1);
+    return (n - 1) / (step < 1 ? 1 : step) + 1;
+  }
+
+  static int nodesHeight(const fdtdSolver<T>& s,
+                         int step)
+  {
+    const int n = (s.getSymmetryY() == fdtdSymmetryType::NoSymmetry ? s.getNY() : 2 * s.getNY() - 1);
+    return (n - 1) / (step < 1 ? 1 : step) + 1;
+  }
+
+  // A field at the nodes into a nodesWidth() by nodesHeight() image; the nodes of a graded mesh
+  // are not evenly spaced (render a window with renderField() at that size instead)
+  void renderFieldNodes(const fdtdSolver<T>& s,
+                        fdtdFieldType field,
+                        uint32_t* imgdata,
+                        const uint32_t* lut,
+                        double vmin,
+                        double vmax,
+                        int step)
+  {
+    if (step < 1) step = 1;
+    if (imgdata == nullptr || !validRange(vmin, vmax))
+      return;
+    if (prepare(s, field, nodesWidth(s, step), nodesHeight(s, step), 0.0, 0.0, 0.0, 0.0, step))
+      render(s, imgdata, lut, vmin, vmax);
+  }
+
+  void renderEzNodes(const fdtdSolver<T>& s,
+                     uint32_t* imgdata,
+                     const uint32_t* lut,
+                     double ezmin,
+                     double ezmax,
+                     int step)
+  {
+    renderFieldNodes(s, fdtdFieldType::Ez, imgdata, lut, ezmin, ezmax, step);
+  }
+
+  // Linear: [vmin, vmax] spans the colormap evenly; Logarithmic: in log |value| (0 < vmin < vmax)
+  void setColorScale(fdtdColorScale scale) { colorScale = scale; }
+  fdtdColorScale getColorScale() const { return colorScale; }
+
+  // Range of the values at the pixels of the last image (before they were clamped to the colormap;
+  // |value| with a log scale)
+  double renderedMinimum() const { return unmap(lowest); }
+  double renderedMaximum() const { return unmap(highest); }
+
+  static const int histogramBins = 256;
+
+  // The value below which a fraction p of the pixels of the last image lie, from the histogram
+  // (to within a bin, 3 / 256 of the color range, inside the color range and the widths beside it)
+  double renderedPercentile(double p) const
+  {
+    if (count == 0)
+      return 0.0;
+    const double target = (p < 0.0 ? 0.0 : (p > 1.0 ? 1.0 : p)) * count;
+    double below = 0.0;
+    int k = 0;
+    for (; k < histogramBins - 1 && (histogram[k] == 0 || below + histogram[k] < target); k++)
+      below += histogram[k];
+    const double f = (histogram[k] > 0 ? (target - below) / histogram[k] : 0.0);
+    // the outer bins are open; all end at the extremes of the image
+    double c0 = binLow + binWidth * k;
+    double c1 = c0 + binWidth;
+    if (k == 0) c0 = (lowest < c1 ? lowest : c1);
+    if (k == histogramBins - 1) c1 = (highest > c0 ? highest : c0);
+    const double c = c0 + f * (c1 - c0);
+    return unmap(c < lowest ? lowest : (c > highest ? highest : c));
+  }
+
+  // A color range from the last image: the percentiles plo and phi (0.01 and 0.99, say), made
+  // symmetric about zero if asked (a signed field; not for a log scale, which keeps it to at most
+  // maxDecades below the upper end). Returns false, leaving the range alone, if the image is flat.
+  bool autoRange(double plo,
+                 double phi,
+                 bool symmetric,
+                 double& vmin,
+                 double& vmax) const
+  {
+    const double maxDecades = 6.0;
+    double a = renderedPercentile(plo);
+    double b = renderedPercentile(phi);
+    if (colorScale == fdtdColorScale::Logarithmic) {
+      const double floor = b * std::pow(10.0, -maxDecades);
+      a = (a > floor ? a : floor);
+    } else if (symmetric) {
+      b = (std::fabs(a) > std::fabs(b) ? std::fabs(a) : std::fabs(b));
+      a = -b;
+    }
+    if (!(a < b) || !validRange(a, b))
+      return false;
+    vmin = a;
+    vmax = b;
+    return true;
+  }
+
+private:
+  typedef fdtdVec<T> V;
+  typedef fdtdVec<float> F;
+
+  // the viewport the tables are for
+  int W;
+  int H;
+  double X0, X1, Y0, Y1;
+  int NX, NY;
+  double gx0, gx1, gy0, gy1;
+  bool graded;
+  bool periodicX, periodicY;
+  fdtdSymmetryType symX, symY;
+  fdtdFieldType view;
+  int nodeStep;     // renderEzNodes() (0: a window)
+
+  fdtdArena arena;
+  int* colIndex;    // grid column left of each pixel column (at it, for nodes)
+  float* colWeight0; // weights of that column and the next (with the sign of an odd mirror image)
+  float* colWeight1;
+  int* rowIndex;    // grid row below each pixel row (at it, for nodes)
+  T* rowWeight;     // weight of the row above
+  float* rowSign;   // -1 in the mirror image of an odd plane
+  int c0, c1;       // grid columns in view, [c0, c1]
+  T* line;          // a pixel row blended over the grid columns
+  float* value;     // and at the pixels
+  int* index;       // colormap indices
+  int* hyIndex0;    // the Hy edges left and right of each node, and their weights
+  int* hyIndex1;
+  T* hyWeight0;
+  T* hyWeight1;
+  T* rows[2];       // the field at the nodes of two grid rows (not for Ez)
+  int rowOf[2];     // which ones (-1: none)
+
+  // the colormap index of the last image, c = lastScale v + lastOffset (v = logBits(|value|) for a
+  // log scale), its range over the pixels, and the histogram of c over [binLow, binLow + 768)
+  fdtdColorScale colorScale;
+  fdtdColorScale lastColorScale;
+  double lastScale;
+  double lastOffset;
+  double lowest;
+  double highest;
+  size_t count;
+  int histogram[histogramBins];
+  int partial[4 * histogramBins]; // (four interleaved, to keep the increments apart)
+  static constexpr double binLow = -256.0;
+  static constexpr double binWidth = 768.0 / histogramBins;
+
+  // the mip pyramid: the level sampled (0: none), its nodes, and per level the rows of the level below
+  // filtered along x (a ring of the last ringRows) and the row being made
+  static const int pyramidK = 5;            // HalfbandFilter<pyramidK>, 2 pyramidK + 1 taps
+  static const int ringRows = 2 * pyramidK + 2;
+  static const int maxLevels = 10;
+  static const int minLevelSize = 2 * pyramidK + 2;
+  T taps[2 * pyramidK + 1];
+  int pyramidBudget;
+  int level;
+  int built;                               // level of the data (0: none yet, or out of date)
+  fdtdFieldType builtField;
+  bool complete;                           // the data has been made whole once
+  fdtdArena pyramidArena;
+  int levelNX[maxLevels + 1];
+  int levelNY[maxLevels + 1];
+  T* levelData;
+  T* ring[maxLevels + 1];
+  T* outRow[maxLevels + 1];
+  T* gridRowBuffer;                        // a grid row of a derived field
+  int pushed[maxLevels + 1];               // rows of the level below taken in
+  int made[maxLevels + 1];                 // rows of the level made
+  int nextGridRow;
+
+  bool validRange(double vmin,
+                  double vmax) const
+  {
+    return vmin < vmax && (colorScale == fdtdColorScale::Linear || vmin > 0.0);
+  }
+
+  // the float bits of v as an int (see fdtdVec<float>::logBits()), and back
+  static double logBits(double v)
+  {
+    const float f = static_cast<float>(v);
+    int32_t i;
+    __builtin_memcpy(&i, &f, sizeof(i));
+    return static_cast<double>(i);
+  }
+
+  static double fromBits(double u)
+  {
+    const int32_t i = (u < 0.0 ? 0 : (u > 2139095039.0 ? 2139095039 : static_cast<int32_t>(u)));
+    float f;
+    __builtin_memcpy(&f, &i, sizeof(f));
+    return static_cast<double>(f);
+  }
+
+  // a colormap index of the last image back to a value
+  double unmap(double c) const
+  {
+    const double u = (c - lastOffset) / lastScale;
+    return (lastColorScale == fdtdColorScale::Logarithmic ? fromBits(u) : u);
+  }
+
+  // the image of the tables, row by row
+  void render(const fdtdSolver<T>& s,
+              uint32_t* imgdata,
+              const uint32_t* lut,
+              double vmin,
+              double vmax)
+  {
+    // colormap index 255 (A v + B) as in rgb_d_viridis(), v = logBits(|value|) for a log scale
+    const bool logScale = (colorScale == fdtdColorScale::Logarithmic);
+    const double u0 = (logScale ? logBits(vmin) : vmin);
+    const double u1 = (logScale ? logBits(vmax) : vmax);
+    const float scale = static_cast<float>(255.0 / (u1 - u0));
+    const float offset = static_cast<float>(-255.0 * u0 / (u1 - u0));
+    const typename F::type zero = F::set1(0.0f);
+    const typename F::type lo = F::set1(0.0f);
+    const typename F::type hi = F::set1(255.0f);
+    const typename F::type b = F::set1(offset);
+    for (int k = 0; k < 4 * histogramBins; k++)
+      partial[k] = 0;
+    typename F::type cmin = F::set1(3.0e38f);
+    typename F::type cmax = F::set1(-3.0e38f);
+    float smin = 3.0e38f;
+    float smax = -3.0e38f;
+    const int nx = s.getNX();
+    const T* ez = s.dataEz();
+    const int w = W;
+    rowOf[0] = -1;
+    rowOf[1] = -1;
+
+    if (level > 0)
+      refresh(s);
+
+    for (int j = 0; j < H; j++) {
+      const int iy = rowIndex[j];
+      if (level > 0) {
+        const T* r0 = levelData + levelNX[level] * iy;
+        blendRows(r0, r0 + levelNX[level], rowWeight[j]);
+        for (int i = 0; i < w; i++) {
+          const T* v = line + colIndex[i];
+          value[i] = static_cast<float>(v[0]) * colWeight0[i] + static_cast<float>(v[1]) * colWeight1[i];
+        }
+      } else if (nodeStep > 0) {
+        const T* r0 = (view == fdtdFieldType::Ez ? ez + nx * iy : fieldRow(s, iy, -1));
+        for (int i = 0; i < w; i++)
+          value[i] = static_cast<float>(r0[colIndex[i]]) * colWeight0[i];
+      } else {
+        if (view == fdtdFieldType::Ez) {
+          blendRows(ez + nx * iy, ez + nx * (iy + 1), rowWeight[j]);
+        } else {
+          const T* r0 = fieldRow(s, iy, iy + 1);
+          blendRows(r0, fieldRow(s, iy + 1, iy), rowWeight[j]);
+        }
+        for (int i = 0; i < w; i++) {
+          const T* v = line + colIndex[i];
+          value[i] = static_cast<float>(v[0]) * colWeight0[i] + static_cast<float>(v[1]) * colWeight1[i];
+        }
+      }
+
+      const typename F::type a = F::set1(logScale ? scale : scale * rowSign[j]);
+      int i = 0;
+      for (; i + F::width <= w; i += F::width) {
+        typename F::type v = F::load(value + i);
+        if (logScale)
+          v = F::logBits(F::max(v, F::sub(zero, v)));
+        const typename F::type c = F::add(F::mul(a, v), b);
+        cmin = F::min(cmin, c);
+        cmax = F::max(cmax, c);
+        F::storeIndex(index + i, F::min(F::max(c, lo), hi));
+      }
+      for (; i < w; i++) {
+        const float v = (logScale ? static_cast<float>(logBits(std::fabs(value[i]))) : rowSign[j] * value[i]);
+        const float c = scale * v + offset;
+        smin = (c < smin ? c : smin);
+        smax = (c > smax ? c : smax);
+        index[i] = (c > 0.0f ? (c < 255.0f ? static_cast<int>(c) : 255) : 0);
+      }
+
+      uint32_t* out = imgdata + static_cast<size_t>(j) * w;
+      for (i = 0; i < w; i++)
+        out[i] = lut[index[i] & 255];
+      // (every fourth pixel is plenty for a histogram this coarse)
+      const float sr = (logScale ? 1.0f : rowSign[j]);
+      for (i = 0; i < w; i += 4) {
+        const float v = (logScale ? static_cast<float>(logBits(std::fabs(value[i]))) : sr * value[i]);
+        const float u = (scale * v + offset - static_cast<float>(binLow)) * static_cast<float>(1.0 / binWidth);
+        const int k = (u > 0.0f ? (u < histogramBins - 1 ? static_cast<int>(u) : histogramBins - 1) : 0);
+        partial[((i >> 2) & 3) * histogramBins + k]++;
+      }
+    }
+
+    for (int k = 0; k < histogramBins; k++)
+      histogram[k] = partial[k] + partial[histogramBins + k] + partial[2 * histogramBins + k] + partial[3 * histogramBins + k];
+    count = static_cast<size_t>((W + 3) / 4) * H;
+    lastColorScale = colorScale;
+    lastScale = scale;
+    lastOffset = offset;
+
+    float lanes[2 * F::width];
+    F::store(lanes, cmin);
+    F::store(lanes + F::width, cmax);
+    for (int k = 0; k < F::width; k++) {
+      smin = (lanes[k] < smin ? lanes[k] : smin);
+      smax = (lanes[F::width + k] > smax ? lanes[F::width + k] : smax);
+    }
+    lowest = smin;
+    highest = smax;
+  }
+
+  // the field at the nodes of grid row iy (columns c0 .. c1), computed into a slot unless held;
+  // the slot of grid row keep (the other row of the pair) is left alone
+  const T* fieldRow(const fdtdSolver<T>& s,
+                    int iy,
+                    int keep)
+  {
+    if (rowOf[0] == iy) return rows[0];
+    if (rowOf[1] == iy) return rows[1];
+    const int k = (rowOf[0] == keep && keep >= 0 ? 1 : 0);
+    rowOf[k] = iy;
+    computeRow(s, iy, rows[k], c0, c1);
+    return rows[k];
+  }
+
+  // the field at the nodes x0 .. x1 of grid row iy into q (not Ez)
+  void computeRow(const fdtdSolver<T>& s,
+                  int iy,
+                  T* q,
+                  int x0,
+                  int x1) const
+  {
+    const int nx = s.getNX();
+    const T eta0 = static_cast<T>(vacuum_impedance);
+    const T* e = s.dataEz() + nx * iy;
+    const T* hy = s.dataHy() + nx * iy;
+    int i0, i1;
+    T a, b;
+    stagger(s, false, iy, i0, a, i1, b);
+    const T* hx0 = s.dataHx() + nx * i0; // Hx below and above the row
+    const T* hx1 = s.dataHx() + nx * i1;
+
+    switch (view) {
+    case fdtdFieldType::Hx:
+      for (int ix = x0; ix <= x1; ix++)
+        q[ix] = eta0 * (a * hx0[ix] + b * hx1[ix]);
+      break;
+    case fdtdFieldType::Hy:
+      for (int ix = x0; ix <= x1; ix++)
+        q[ix] = eta0 * (hyWeight0[ix] * hy[hyIndex0[ix]] + hyWeight1[ix] * hy[hyIndex1[ix]]);
+      break;
+    case fdtdFieldType::MagnitudeH:
+    case fdtdFieldType::MagnitudeS:
+      for (int ix = x0; ix <= x1; ix++) {
+        const T hxn = a * hx0[ix] + b * hx1[ix];
+        const T hyn = hyWeight0[ix] * hy[hyIndex0[ix]] + hyWeight1[ix] * hy[hyIndex1[ix]];
+        const T m = eta0 * std::sqrt(hxn * hxn + hyn * hyn);
+        q[ix] = (view == fdtdFieldType::MagnitudeH ? m : std::abs(e[ix]) * m);
+      }
+      break;
+    case fdtdFieldType::EnergyDensity: {
+      // the mean of the squares on either side (the sum of which is energyB()), not the square of
+      // the mean; the medium is the one of the node
+      const T aa = std::abs(a);
+      const T bb = std::abs(b);
+      for (int ix = x0; ix <= x1; ix++) {
+        const T hxa = hx0[ix];
+        const T hxb = hx1[ix];
+        const T hya = hy[hyIndex0[ix]];
+        const T hyb = hy[hyIndex1[ix]];
+        const T h2 = aa * hxa * hxa + bb * hxb * hxb + std::abs(hyWeight0[ix]) * hya * hya + hyWeight1[ix] * hyb * hyb;
+        const fdtdMaterial<T>& m = s.getMaterialProperties(s.getMaterial(ix, iy));
+        q[ix] = static_cast<T>(0.5) * (m.epr * e[ix] * e[ix] + m.mur * eta0 * eta0 * h2);
+      }
+      break;
+    }
+    default:
+      for (int ix = x0; ix <= x1; ix++)
+        q[ix] = e[ix];
+      break;
+    }
+  }
+
+  // brings grid rows into the pyramid: all of them (the first time, or with no budget), or as many as
+  // the budget allows from where the last frame stopped
+  void refresh(const fdtdSolver<T>& s)
+  {
+    const bool whole = (!complete || pyramidBudget == 0);
+    const double budget = static_cast<double>(pyramidBudget) * W * H;
+    double done = 0.0;
+    while (whole || done < budget) {
+      const int iy = nextGridRow;
+      if (builtField == fdtdFieldType::Ez) {
+        push(1, s.dataEz() + static_cast<size_t>(NX) * iy);
+      } else {
+        computeRow(s, iy, gridRowBuffer, 0, NX - 1);
+        push(1, gridRowBuffer);
+      }
+      done += NX;
+      if (++nextGridRow == NY) {
+        complete = true;
+        restartPyramid();
+        if (whole) break;
+      }
+    }
+  }
+
+  void restartPyramid()
+  {
+    nextGridRow = 0;
+    for (int l = 0; l <= maxLevels; l++) {
+      pushed[l] = 0;
+      made[l] = 0;
+    }
+  }
+
+  // row pushed[l] of level l - 1 into level l: filtered along x at every other node, into the ring;
+  // then the rows of level l whose filter along y that completes (every other row of level l - 1,
+  // the last one held past the edge) to the level sampled, or on to the next level
+  void push(int l,
+            const T* row)
+  {
+    const int K = pyramidK;
+    const int n0 = levelNX[l - 1];
+    const int n1 = levelNX[l];
+    const int last = levelNY[l - 1] - 1;
+    const int r = pushed[l]++;
+    T* dst = ring[l] + (r % ringRows) * n1;
+    for (int i = 0; i < n1; i++) {
+      T sum = 0;
+      if (2 * i - K >= 0 && 2 * i + K < n0) {
+        const T* x = row + 2 * i;
+        for (int n = -K; n <= K; n++)
+          sum += taps[n + K] * x[n];
+      } else {
+        for (int n = -K; n <= K; n++) {
+          const int q = 2 * i + n;
+          sum += taps[n + K] * row[q < 0 ? 0 : (q >= n0 ? n0 - 1 : q)];
+        }
+      }
+      dst[i] = sum;
+    }
+    while (made[l] < levelNY[l] && (2 * made[l] + K <= r || r == last)) {
+      const int j = made[l]++;
+      T* out = (l == level ? levelData + static_cast<size_t>(n1) * j : outRow[l]);
+      for (int i = 0; i < n1; i++)
+        out[i] = 0;
+      for (int n = -K; n <= K; n++) {
+        const int q = 2 * j + n;
+        const T* src = ring[l] + ((q < 0 ? 0 : (q > last ? last : q)) % ringRows) * n1;
+        const T c = taps[n + K];
+        for (int i = 0; i < n1; i++)
+          out[i] += c * src[i];
+      }
+      if (l < level)
+        push(l + 1, out);
+    }
+  }
+
+  // the level for a window of w by h pixels (0 for none), and its storage; false if that could not
+  // be allocated (the grid is sampled then)
+  bool pyramidFor(const fdtdSolver<T>& s,
+                  fdtdFieldType field,
+                  int w,
+                  int h,
+                  double xmin,
+                  double xmax,
+                  double ymin,
+                  double ymax)
+  {
+    int l = 0;
+    if (!s.isGraded() && pyramidBudget >= 0) {
+      double px = (xmax - xmin) / (s.getDelta() * w); // grid cells per pixel
+      double py = (ymax - ymin) / (s.getDelta() * h);
+      int nx = s.getNX();
+      int ny = s.getNY();
+      while (l < maxLevels && px >= 2.0 && py >= 2.0 && (nx - 1) / 2 + 1 >= minLevelSize && (ny - 1) / 2 + 1 >= minLevelSize) {
+        px *= 0.5;
+        py *= 0.5;
+        nx = (nx - 1) / 2 + 1;
+        ny = (ny - 1) / 2 + 1;
+        l++;
+      }
+    }
+    level = l;
+    if (l == 0 || (l == built && field == builtField && levelNX[0] == s.getNX() && levelNY[0] == s.getNY()))
+      return true;
+
+    built = 0;
+    levelNX[0] = s.getNX();
+    levelNY[0] = s.getNY();
+    size_t bytes = fdtdArena::footprint<T>(s.getNX());
+    for (int k = 1; k <= l; k++) {
+      levelNX[k] = (levelNX[k - 1] - 1) / 2 + 1;
+      levelNY[k] = (levelNY[k - 1] - 1) / 2 + 1;
+      bytes += fdtdArena::footprint<T>(static_cast<size_t>(ringRows) * levelNX[k]) + fdtdArena::footprint<T>(levelNX[k]);
+    }
+    bytes += fdtdArena::footprint<T>(static_cast<size_t>(levelNX[l]) * levelNY[l]);
+    if (!pyramidArena.reserve(bytes)) {
+      level = 0;
+      return false;
+    }
+    gridRowBuffer = pyramidArena.allocate<T>(s.getNX());
+    for (int k = 1; k <= l; k++) {
+      ring[k] = pyramidArena.allocate<T>(static_cast<size_t>(ringRows) * levelNX[k]);
+      outRow[k] = pyramidArena.allocate<T>(levelNX[k]);
+    }
+    levelData = pyramidArena.allocate<T>(static_cast<size_t>(levelNX[l]) * levelNY[l]);
+    built = l;
+    builtField = field;
+    complete = false;
+    restartPyramid();
+    return true;
+  }
+
+  // The H edges (along an axis) on either side of node k, and the weights that interpolate them to
+  // it: by the two cell sizes inside, with the last cell before a periodic seam, or with the
+  // mirror image of the first edge at a symmetry plane (which flips H along the axis for an even
+  // plane: -1/2 then); the one edge inside at other boundaries.
+  static void stagger(const fdtdSolver<T>& s,
+                      bool alongX,
+                      int k,
+                      int& i0,
+                      T& w0,
+                      int& i1,
+                      T& w1)
+  {
+    const int n = (alongX ? s.getNX() : s.getNY());
+    const bool periodic = (alongX ? s.isPeriodicX() : s.isPeriodicY());
+    const fdtdSymmetryType sym = (alongX ? s.getSymmetryX() : s.getSymmetryY());
+    double h0, h1;
+    if (k > 0 && k < n - 1) {
+      i0 = k - 1;
+      i1 = k;
+      h0 = (alongX ? s.getX(k) - s.getX(k - 1) : s.getY(k) - s.getY(k - 1));
+      h1 = (alongX ? s.getX(k + 1) - s.getX(k) : s.getY(k + 1) - s.getY(k));
+    } else if (periodic) {
+      i0 = n - 2;
+      i1 = 0;
+      h0 = (alongX ? s.getX(n - 1) - s.getX(n - 2) : s.getY(n - 1) - s.getY(n - 2));
+      h1 = (alongX ? s.getX(1) - s.getX(0) : s.getY(1) - s.getY(0));
+    } else if (k == 0) {
+      i0 = 0;
+      i1 = 0;
+      w0 = static_cast<T>(sym == fdtdSymmetryType::NoSymmetry ? 0.0 : (sym == fdtdSymmetryType::OddSymmetry ? 0.5 : -0.5));
+      w1 = static_cast<T>(sym == fdtdSymmetryType::NoSymmetry ? 1.0 : 0.5);
+      return;
+    } else {
+      i0 = n - 2;
+      i1 = n - 2;
+      w0 = 1;
+      w1 = 0;
+      return;
+    }
+    if (!s.isGraded())
+      h0 = h1;
+    w0 = static_cast<T>(h1 / (h0 + h1));
+    w1 = static_cast<T>(h0 / (h0 + h1));
+  }
+
+  // node u of the whole grid along an axis of n points (counted from the image of the last one
+  // with a plane): the grid point, and the sign of the field in a mirror image
+  static int unfold(int u,
+                    int n,
+                    fdtdSymmetryType sym,
+                    float image,
+                    float& sign)
+  {
+    sign = 1.0f;
+    if (sym == fdtdSymmetryType::NoSymmetry)
+      return u;
+    if (u >= n - 1)
+      return u - (n - 1);
+    sign = image;
+    return n - 1 - u;
+  }
+
+  // sign of a field in the mirror image across a plane normal to an axis: that of Ez (-1 for an
+  // odd plane), flipped for the H component along the axis, 1 for the magnitudes
+  static float imageSign(fdtdSymmetryType sym,
+                         fdtdFieldType field,
+                         bool alongX)
+  {
+    const float ez = (sym == fdtdSymmetryType::OddSymmetry ? -1.0f : 1.0f);
+    switch (field) {
+    case fdtdFieldType::Ez: return ez;
+    case fdtdFieldType::Hx: return (alongX ? ez : -ez);
+    case fdtdFieldType::Hy: return (alongX ? -ez : ez);
+    default: return 1.0f;
+    }
+  }
+
+  // the grid row above r0 blended with weight t into line[c0 .. c1]
+  void blendRows(const T* r0,
+                 const T* r1,
+                 T t)
+  {
+    const typename V::type vt = V::set1(t);
+    int ix = c0;
+    for (; ix + V::width <= c1 + 1; ix += V::width) {
+      const typename V::type a = V::load(r0 + ix);
+      V::store(line + ix, V::add(a, V::mul(vt, V::sub(V::load(r1 + ix), a))));
+    }
+    for (; ix <= c1; ix++)
+      line[ix] = r0[ix] + t * (r1[ix] - r0[ix]);
+  }
+
+  // grid interval k (of n points, spacing apart on a uniform mesh: a pyramid level) holding v, and
+  // the fraction eta of it; v is first reflected across a symmetry plane at the first point (and the
+  // sign set to image)
+  static int locate(const fdtdSolver<T>& s,
+                    bool alongX,
+                    double v,
+                    float image,
+                    int n,
+                    double spacing,
+                    double& eta,
+                    float& sign)
+  {
+    const double g0 = (alongX ? s.getXmin() : s.getYmin());
+    const fdtdSymmetryType sym = (alongX ? s.getSymmetryX() : s.getSymmetryY());
+    sign = 1.0f;
+    if (sym != fdtdSymmetryType::NoSymmetry && v < g0) {
+      v = 2.0 * g0 - v;
+      sign = image;
+    }
+    int k;
+    if (s.isGraded()) {
+      int lo = 0;
+      int hi = n - 1;
+      while (hi - lo > 1) {
+        const int mid = (lo + hi) / 2;
+        if ((alongX ? s.getX(mid) : s.getY(mid)) <= v) lo = mid; else hi = mid;
+      }
+      k = lo;
+      const double a = (alongX ? s.getX(k) : s.getY(k));
+      const double b = (alongX ? s.getX(k + 1) : s.getY(k + 1));
+      eta = (v - a) / (b - a);
+    } else {
+      const double u = (v - g0) / spacing;
+      k = static_cast<int>(u);
+      k = (u < 0.0 ? 0 : (k > n - 2 ? n - 2 : k));
+      eta = u - k;
+    }
+    eta = (eta < 0.0 ? 0.0 : (eta > 1.0 ? 1.0 : eta));
+    return k;
+  }
+
+  // (the arena holds the same tables whichever field is drawn)
+  bool prepare(const fdtdSolver<T>& s,
+               fdtdFieldType field,
+               int w,
+               int h,
+               double xmin,
+               double xmax,
+               double ymin,
+               double ymax,
+               int step)
+  {
+    if (w == W && h == H && xmin == X0 && xmax == X1 && ymin == Y0 && ymax == Y1 && step == nodeStep && field == view &&
+        s.getNX() == NX && s.getNY() == NY && s.getXmin() == gx0 && s.getXmax() == gx1 && s.getYmin() == gy0 && s.getYmax() == gy1 &&
+        s.isGraded() == graded && s.isPeriodicX() == periodicX && s.isPeriodicY() == periodicY &&
+        s.getSymmetryX() == symX && s.getSymmetryY() == symY)
+      return true;
+
+    W = 0;
+    const int nx = s.getNX();
+    const size_t bytes = 3 * fdtdArena::footprint<float>(w) + 2 * fdtdArena::footprint<int>(w) +
+                         fdtdArena::footprint<int>(h) + fdtdArena::footprint<T>(h) + fdtdArena::footprint<float>(h) +
+                         5 * fdtdArena::footprint<T>(nx) + 2 * fdtdArena::footprint<int>(nx);
+    if (!arena.reserve(bytes))
+      return false;
+    colIndex = arena.allocate<int>(w);
+    colWeight0 = arena.allocate<float>(w);
+    colWeight1 = arena.allocate<float>(w);
+    value = arena.allocate<float>(w);
+    index = arena.allocate<int>(w);
+    rowIndex = arena.allocate<int>(h);
+    rowWeight = arena.allocate<T>(h);
+    rowSign = arena.allocate<float>(h);
+    line = arena.allocate<T>(nx);
+    rows[0] = arena.allocate<T>(nx);
+    rows[1] = arena.allocate<T>(nx);
+    hyIndex0 = arena.allocate<int>(nx);
+    hyIndex1 = arena.allocate<int>(nx);
+    hyWeight0 = arena.allocate<T>(nx);
+    hyWeight1 = arena.allocate<T>(nx);
+    for (int ix = 0; ix < nx; ix++)
+      stagger(s, true, ix, hyIndex0[ix], hyWeight0[ix], hyIndex1[ix], hyWeight1[ix]);
+
+    level = 0;
+    const float imageX = imageSign(s.getSymmetryX(), field, true);
+    const float imageY = imageSign(s.getSymmetryY(), field, false);
+    if (step > 0) {
+      const int nyi = (s.getSymmetryY() == fdtdSymmetryType::NoSymmetry ? s.getNY() : 2 * s.getNY() - 1);
+      c0 = nx - 1;
+      c1 = 0;
+      for (int i = 0; i < w; i++) {
+        float sign;
+        const int k = unfold(i * step, nx, s.getSymmetryX(), imageX, sign);
+        colIndex[i] = k;
+        colWeight0[i] = sign;
+        colWeight1[i] = 0.0f;
+        if (k < c0) c0 = k;
+        if (k > c1) c1 = k;
+      }
+      for (int j = 0; j < h; j++) {
+        float sign;
+        rowIndex[j] = unfold(nyi - 1 - j * step, s.getNY(), s.getSymmetryY(), imageY, sign);
+        rowWeight[j] = 0;
+        rowSign[j] = sign;
+      }
+    } else {
+      pyramidFor(s, field, w, h, xmin, xmax, ymin, ymax);
+      tabulate(s, w, h, xmin, xmax, ymin, ymax, imageX, imageY);
+    }
+
+    W = w;
+    H = h;
+    X0 = xmin;
+    X1 = xmax;
+    Y0 = ymin;
+    Y1 = ymax;
+    NX = s.getNX();
+    NY = s.getNY();
+    gx0 = s.getXmin();
+    gx1 = s.getXmax();
+    gy0 = s.getYmin();
+    gy1 = s.getYmax();
+    graded = s.isGraded();
+    periodicX = s.isPeriodicX();
+    periodicY = s.isPeriodicY();
+    symX = s.getSymmetryX();
+    symY = s.getSymmetryY();
+    view = field;
+    nodeStep = step;
+    return true;
+  }
+
+  // the window tables of renderField()
+  void tabulate(const fdtdSolver<T>& s,
+                int w,
+                int h,
+                double xmin,
+                double xmax,
+                double ymin,
+                double ymax,
+                float imageX,
+                float imageY)
+  {
+    const double xupp = (xmax - xmin) / w; // x units per pixel
+    const double yupp = (ymax - ymin) / h; // y units per pixel
+    const int nx = (level > 0 ? levelNX[level] : s.getNX());
+    const int ny = (level > 0 ? levelNY[level] : s.getNY());
+    const double spacing = s.getDelta() * (1 << level);
+    c0 = nx - 2;
+    c1 = 1;
+    for (int i = 0; i < w; i++) {
+      double eta;
+      float sign;
+      const int k = locate(s, true, xmin + i * xupp, imageX, nx, spacing, eta, sign);
+      colIndex[i] = k;
+      colWeight0[i] = sign * static_cast<float>(1.0 - eta);
+      colWeight1[i] = sign * static_cast<float>(eta);
+      if (k < c0) c0 = k;
+      if (k + 1 > c1) c1 = k + 1;
+    }
+    for (int j = 0; j < h; j++) {
+      double eta;
+      float sign;
+      rowIndex[j] = locate(s, false, ymax - j * yupp, imageY, ny, spacing, eta, sign);
+      rowWeight[j] = static_cast<T>(eta);
+      rowSign[j] = sign;
+    }
+  }
+};
+
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+// Minimal SIMD vector wrapper for the field update kernels.
+// The instruction set is picked at compile time (define FDTD_NO_SIMD to force scalar code):
+//   wasm: -msimd128 (2 doubles / 4 floats), native: AVX (4 / 8) or SSE2 (2 / 4).
+// Only plain mul/add/sub are used (no FMA) so the vector kernels round exactly like the scalar ones;
+// min/max are only used for the diagnostics reductions and the rasterizer (their NaN handling differs
+// per instruction set); storeIndex() truncates floats to int (the rasterizer's colormap indices), and
+// logBits() reads the bits of a float as an int: 2^23 (log2(a) + 127) to within 0.09 (for a > 0;
+// the rasterizer's log scale).
+
+#if !defined(FDTD_NO_SIMD) && defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define FDTD_SIMD_WASM128
+#elif !defined(FDTD_NO_SIMD) && defined(__AVX__)
+#include <immintrin.h>
+#define FDTD_SIMD_AVX
+#elif !defined(FDTD_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define FDTD_SIMD_SSE2
+#endif
+
+template <typename T>
+struct fdtdVec;
+
+template <>
+struct fdtdVec<double>
+{
+#if defined(FDTD_SIMD_WASM128)
+  typedef v128_t type;
+  static const int width = 2;
+  static type load(const double* p) { return wasm_v128_load(p); }
+  static void store(double* p, type a) { wasm_v128_store(p, a); }
+  static type set1(double a) { return wasm_f64x2_splat(a); }
+  static type add(type a, type b) { return wasm_f64x2_add(a, b); }
+  static type sub(type a, type b) { return wasm_f64x2_sub(a, b); }
+  static type mul(type a, type b) { return wasm_f64x2_mul(a, b); }
+  static type min(type a, type b) { return wasm_f64x2_pmin(a, b); }
+  static type max(type a, type b) { return wasm_f64x2_pmax(a, b); }
+#elif defined(FDTD_SIMD_AVX)
+  typedef __m256d type;
+  static const int width = 4;
+  static type load(const double* p) { return _mm256_loadu_pd(p); }
+  static void store(double* p, type a) { _mm256_storeu_pd(p, a); }
+  static type set1(double a) { return _mm256_set1_pd(a); }
+  static type add(type a, type b) { return _mm256_add_pd(a, b); }
+  static type sub(type a, type b) { return _mm256_sub_pd(a, b); }
+  static type mul(type a, type b) { return _mm256_mul_pd(a, b); }
+  static type min(type a, type b) { return _mm256_min_pd(a, b); }
+  static type max(type a, type b) { return _mm256_max_pd(a, b); }
+#elif defined(FDTD_SIMD_SSE2)
+  typedef __m128d type;
+  static const int width = 2;
+  static type load(const double* p) { return _mm_loadu_pd(p); }
+  static void store(double* p, type a) { _mm_storeu_pd(p, a); }
+  static type set1(double a) { return _mm_set1_pd(a); }
+  static type add(type a, type b) { return _mm_add_pd(a, b); }
+  static type sub(type a, type b) { return _mm_sub_pd(a, b); }
+  static type mul(type a, type b) { return _mm_mul_pd(a, b); }
+  static type min(type a, type b) { return _mm_min_pd(a, b); }
+  static type max(type a, type b) { return _mm_max_pd(a, b); }
+#else
+  typedef double type;
+  static const int width = 1;
+  static type load(const double* p) { return *p; }
+  static void store(double* p, type a) { *p = a; }
+  static type set1(double a) { return a; }
+  static type add(type a, type b) { return a + b; }
+  static type sub(type a, type b) { return a - b; }
+  static type mul(type a, type b) { return a * b; }
+  static type min(type a, type b) { return (b < a ? b : a); }
+  static type max(type a, type b) { return (a < b ? b : a); }
+#endif
+};
+
+template <>
+struct fdtdVec<float>
+{
+#if defined(FDTD_SIMD_WASM128)
+  typedef v128_t type;
+  static const int width = 4;
+  static type load(const float* p) { return wasm_v128_load(p); }
+  static void store(float* p, type a) { wasm_v128_store(p, a); }
+  static type set1(float a) { return wasm_f32x4_splat(a); }
+  static type add(type a, type b) { return wasm_f32x4_add(a, b); }
+  static type sub(type a, type b) { return wasm_f32x4_sub(a, b); }
+  static type mul(type a, type b) { return wasm_f32x4_mul(a, b); }
+  static type min(type a, type b) { return wasm_f32x4_pmin(a, b); }
+  static type max(type a, type b) { return wasm_f32x4_pmax(a, b); }
+  static void storeIndex(int* p, type a) { wasm_v128_store(p, wasm_i32x4_trunc_sat_f32x4(a)); }
+  static type logBits(type a) { return wasm_f32x4_convert_i32x4(a); }
+#elif defined(FDTD_SIMD_AVX)
+  typedef __m256 type;
+  static const int width = 8;
+  static type load(const float* p) { return _mm256_loadu_ps(p); }
+  static void store(float* p, type a) { _mm256_storeu_ps(p, a); }
+  static type set1(float a) { return _mm256_set1_ps(a); }
+  static type add(type a, type b) { return _mm256_add_ps(a, b); }
+  static type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+  static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+  static type min(type a, type b) { return _mm256_min_ps(a, b); }
+  static type max(type a, type b) { return _mm256_max_ps(a, b); }
+  static void storeIndex(int* p, type a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm256_cvttps_epi32(a)); }
+  static type logBits(type a) { return _mm256_cvtepi32_ps(_mm256_castps_si256(a)); }
+#elif defined(FDTD_SIMD_SSE2)
+  typedef __m128 type;
+  static const int width = 4;
+  static type load(const float* p) { return _mm_loadu_ps(p); }
+  static void store(float* p, type a) { _mm_storeu_ps(p, a); }
+  static type set1(float a) { return _mm_set1_ps(a); }
+  static type add(type a, type b) { return _mm_add_ps(a, b); }
+  static type sub(type a, type b) { return _mm_sub_ps(a, b); }
+  static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+  static type min(type a, type b) { return _mm_min_ps(a, b); }
+  static type max(type a, type b) { return _mm_max_ps(a, b); }
+  static void storeIndex(int* p, type a) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_cvttps_epi32(a)); }
+  static type logBits(type a) { return _mm_cvtepi32_ps(_mm_castps_si128(a)); }
+#else
+  typedef float type;
+  static const int width = 1;
+  static type load(const float* p) { return *p; }
+  static void store(float* p, type a) { *p = a; }
+  static type set1(float a) { return a; }
+  static type add(type a, type b) { return a + b; }
+  static type sub(type a, type b) { return a - b; }
+  static type mul(type a, type b) { return a * b; }
+  static type min(type a, type b) { return (b < a ? b : a); }
+  static type max(type a, type b) { return (a < b ? b : a); }
+  static void storeIndex(int* p, type a) { *p = (a == a ? static_cast<int>(a) : 0); }
+  static type logBits(type a) { int i; __builtin_memcpy(&i, &a, sizeof(i)); return static_cast<float>(i); }
+#endif
+};
+
+inline const char* fdtdSimdName() {
+#if defined(FDTD_SIMD_WASM128)
+  return "wasm-simd128";
+#elif defined(FDTD_SIMD_AVX)
+  return "avx";
+#elif defined(FDTD_SIMD_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
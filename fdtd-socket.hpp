@@ -0,0 +1,119 @@
+#pragma once
+
+// fdtdTransport over local stream sockets (POSIX; needs <unistd.h>, <sys/socket.h>).
+// For ranks on one machine: processes forked after connectLocal() (or threads) each
+// build their transport from the shared table of socket pairs.
+// A send blocks while the receiver's socket buffer is full, which is harmless for
+// halo rows (a few kB to a few hundred kB) since every rank posts its sends first.
+class fdtdSocketTransport : public fdtdTransport
+{
+public:
+  static const int maxRanks = 64;
+
+  // fds[(i * size + j) * 2 + 0 / 1] are the send / receive descriptors of rank i towards rank j
+  static bool connectLocal(int size,
+                           int* fds)
+  {
+    if (size < 1 || size > maxRanks)
+      return false;
+    for (int i = 0; i < size; i++) {
+      for (int j = i; j < size; j++) {
+        int sv[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+          return false;
+        if (i == j) {
+          fds[(i * size + i) * 2 + 0] = sv[0];
+          fds[(i * size + i) * 2 + 1] = sv[1];
+        } else {
+          fds[(i * size + j) * 2 + 0] = fds[(i * size + j) * 2 + 1] = sv[0];
+          fds[(j * size + i) * 2 + 0] = fds[(j * size + i) * 2 + 1] = sv[1];
+        }
+      }
+    }
+    return true;
+  }
+
+  static void closeLocal(int size,
+                         int* fds)
+  {
+    for (int i = 0; i < size; i++) {
+      for (int j = i; j < size; j++) {
+        ::close(fds[(i * size + j) * 2 + 0]);
+        if (i == j) ::close(fds[(i * size + j) * 2 + 1]);
+      }
+    }
+  }
+
+  fdtdSocketTransport(int rank,
+                      int size,
+                      const int* fds) :
+    myRank(rank),
+    mySize(size)
+  {
+    for (int j = 0; j < size; j++) {
+      sendFd[j] = fds[(rank * size + j) * 2 + 0];
+      recvFd[j] = fds[(rank * size + j) * 2 + 1];
+    }
+  }
+
+  int rank() const { return myRank; }
+  int size() const { return mySize; }
+
+  bool send(int dst,
+            int tag,
+            const void* data,
+            size_t bytes)
+  {
+    const uint64_t header[2] = { static_cast<uint64_t>(tag), static_cast<uint64_t>(bytes) };
+    return writeAll(sendFd[dst], header, sizeof(header)) && writeAll(sendFd[dst], data, bytes);
+  }
+
+  bool recv(int src,
+            int tag,
+            void* data,
+            size_t bytes)
+  {
+    uint64_t header[2];
+    if (!readAll(recvFd[src], header, sizeof(header)))
+      return false;
+    if (header[0] != static_cast<uint64_t>(tag) || header[1] != static_cast<uint64_t>(bytes))
+      return false;
+    return readAll(recvFd[src], data, bytes);
+  }
+
+private:
+  int myRank;
+  int mySize;
+  int sendFd[maxRanks];
+  int recvFd[maxRanks];
+
+  static bool writeAll(int fd,
+                       const void* data,
+                       size_t bytes)
+  {
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+      const ssize_t n = ::write(fd, p, bytes);
+      if (n <= 0)
+        return false;
+      p += n;
+      bytes -= n;
+    }
+    return true;
+  }
+
+  static bool readAll(int fd,
+                      void* data,
+                      size_t bytes)
+  {
+    char* p = static_cast<char*>(data);
+    while (bytes > 0) {
+      const ssize_t n = ::read(fd, p, bytes);
+      if (n <= 0)
+        return false;
+      p += n;
+      bytes -= n;
+    }
+    return true;
+  }
+};
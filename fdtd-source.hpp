@@ -21,6 +21,7 @@ struct fdtdSource
   double theta;
   double radiansPerTimestep;
   bool thetaWraparound;
+  double courant; // timestep in units of delta / c (the solver's; see setCourant())
 
   void initDefault() {
     type = fdtdSourceType::Monochromatic;
@@ -30,47 +31,48 @@ struct fdtdSource
     amp = 1.0;
     delayMultiplier = 2.0;
     thetaWraparound = true;
+    courant = courant_factor;
     resetTheta();
     setPPW(30.0);
   }
 
   double sinusoidal(double q) const {
-    return amp * std::sin(2.0 * M_PI * courant_factor * q / ppw);
+    return amp * std::sin(2.0 * M_PI * courant * q / ppw);
   }
 
   double sinusoidal() const {
     return amp * std::sin(theta);
   }
 
-  double ricker(int q) const {
-    const int qd = static_cast<int>(delayMultiplier * ppw / courant_factor);
-    const int qeff = q % (2 * qd);
-    const double eta = M_PI * courant_factor * (qeff - qd) / ppw;
+  double ricker(double q) const {
+    const int qd = static_cast<int>(delayMultiplier * ppw / courant);
+    const double qeff = std::fmod(q, 2.0 * qd);
+    const double eta = M_PI * courant * (qeff - qd) / ppw;
     return amp * std::exp(-1.0 * eta * eta) * (1.0 - 2.0 * eta * eta);
   }
 
   double sawtooth(int q) const {
-    const int Q = static_cast<int>(this->ppw / courant_factor);
+    const int Q = static_cast<int>(this->ppw / courant);
     return (-1 + 2.0 * static_cast<double>(q % Q) / Q) * (this->amp);
   }
 
-  double truncated_sawtooth() const {
+  double truncated_sawtooth(double phase) const {
     // (sin(x) - 1/2 sin(2 x) + 1/3 sin(3 x) - 1/4 sin(4 x) + 1/5 sin(5 x)) * (2 / pi)
     const double multiplier = (2.0 / M_PI) * amp;
-    double s = std::sin(theta);
-    s -= std::sin(2.0 * theta) / 2.0;
-    s += std::sin(3.0 * theta) / 3.0;
-    s -= std::sin(4.0 * theta) / 4.0;
-    s += std::sin(5.0 * theta) / 5.0;
+    double s = std::sin(phase);
+    s -= std::sin(2.0 * phase) / 2.0;
+    s += std::sin(3.0 * phase) / 3.0;
+    s -= std::sin(4.0 * phase) / 4.0;
+    s += std::sin(5.0 * phase) / 5.0;
     return s * multiplier;
   }
 
-  double truncated_squarewave() const {
+  double truncated_squarewave(double phase) const {
     const double multiplier = (4.0 / M_PI) * amp;
-    double s = std::sin(theta);
-    s += std::sin(3.0 * theta) / 3.0;
-    s += std::sin(5.0 * theta) / 5.0;
-    s += std::sin(7.0 * theta) / 7.0;
+    double s = std::sin(phase);
+    s += std::sin(3.0 * phase) / 3.0;
+    s += std::sin(5.0 * phase) / 5.0;
+    s += std::sin(7.0 * phase) / 7.0;
     return s * multiplier;
   }
 
@@ -81,7 +83,13 @@ struct fdtdSource
 
   void setPPW(int ppw) {
     this->ppw = ppw;
-    this->radiansPerTimestep = two_pi * courant_factor / this->ppw;
+    this->radiansPerTimestep = two_pi * courant / this->ppw;
+  }
+
+  // the waveforms are sampled per timestep, so they follow the solver's Courant number
+  void setCourant(double c) {
+    courant = c;
+    radiansPerTimestep = two_pi * courant / ppw;
   }
 
   void updateTheta() {
@@ -105,29 +113,33 @@ struct fdtdSource
     return 1.0 / recip;
   }
 
-  double get(int counter) const {
+  // value for step counter (whose phase is theta), or a fraction of a step later
+  double get(int counter, 
+             double fraction = 0.0) const 
+  {
     double Sxy = 0.0;
+    const double phase = theta + fraction * radiansPerTimestep;
 
     switch (this->type)
     {
     case fdtdSourceType::Monochromatic:
       //Sxy = sinusoidal(static_cast<double>(counter));
-      Sxy = sinusoidal();
+      Sxy = amp * std::sin(phase);
       break;
 
     case fdtdSourceType::RickerPulse:
-      Sxy = ricker(counter);
+      Sxy = ricker(counter + fraction);
       break;
 
     case fdtdSourceType::SquareWave:
       //Sxy = (sinusoidal(static_cast<double>(counter)) < 0.0 ? -this->amp : this->amp);
       //Sxy = (sinusoidal() < 0.0 ? -this->amp : this->amp);
-      Sxy = truncated_squarewave();
+      Sxy = truncated_squarewave(phase);
       break;
 
     case fdtdSourceType::Sawtooth:
       //Sxy = sawtooth(counter);
-      Sxy = truncated_sawtooth();
+      Sxy = truncated_sawtooth(phase);
       break;
 
     case fdtdSourceType::NoSource:
@@ -0,0 +1,742 @@
+#pragma once
+
+// Local refinement: a rectangular patch of an fdtdSolver grid (the coarse grid) is run on a grid
+// r = 2, 3 or 4 times finer, with r substeps per coarse step at the same Courant number.
+//
+// Coupling. The fine grid holds the Ez nodes strictly inside the outline of the patch. The coarse
+// nodes on the outline are shared: their dual cell is the coarse one outside the patch plus a
+// strip half a fine cell wide inside, and the fine outline nodes between them follow them linearly.
+// Every H edge enters the E update of its two nodes with the same weight (its dual length) as the
+// E difference enters its own update, the fine outline nodes passing their share on to the coarse
+// nodes they follow. So the composite grid conserves energy like the uniform Yee grid does, which
+// is what keeps the coupling stable (overwriting fine edges with interpolated coarse values, or
+// coarse cells with fine ones, is not, and blows up after some thousands of steps).
+//
+// Time. Local time stepping after Diaz & Grote (leapfrog, SIAM J. Sci. Comput. 31, 2009): within a
+// coarse step the fine nodes, the shared ones and the coarse nodes within band cells outside the
+// outline (and the H edges touching them) take r substeps in which the other coarse nodes are held
+// at time n, and the H of those edges advances by twice the mean of the substep values. Away from
+// the band this is the plain coarse step, and the scheme keeps a discrete energy. The coarse grid
+// runs at the Courant limit, where the substepped set needs to reach past the outline: without
+// the band the scheme is unstable, with one layer it still blows up after some 10^5 steps.
+// The fields of the patch exist at the coarse times; the coarse grid gets them at its own nodes
+// (and H edges) inside the outline, for display. Abrupt changes of a source inside a patch also
+// excite fine modes at the Nyquist rate of the coarse step (bounded, but not damped either).
+
+namespace TMz {
+
+template <typename T>
+class fdtdSubgrid
+{
+public:
+  static const int maxRatio = 4;
+  static const int band = 2; // coarse layers outside the outline that take the substeps
+
+  fdtdSubgrid() : coarse(nullptr), r(0) {}
+
+  fdtdSubgrid(const fdtdSubgrid&) = delete;
+  fdtdSubgrid& operator=(const fdtdSubgrid&) = delete;
+
+  // Patch over the coarse nodes [x0, x1] x [y0, y1] (the outline included) of a solver that
+  // outlives it; keep it band + 2 cells from the coarse edges and band cells clear of any CPML layer.
+  // The fine grid takes the coarse media and fields (interpolated), so a patch can be added to a
+  // running simulation. Initialize again after changing the coarse media, Courant number or fields
+  // other than by stepping (reset() for zero fields). The coarse grid must be uniform with the (2,2)
+  // stencil and the leapfrog integrator. Returns false
+  // for a bad ratio or patch, or if allocation fails.
+  bool initialize(fdtdSolver<T>* solver,
+                  int x0,
+                  int y0,
+                  int x1,
+                  int y1,
+                  int ratio)
+  {
+    coarse = solver;
+    r = 0;
+    if (ratio < 2 || ratio > maxRatio || solver->getStencil() != fdtdStencilType::SecondOrder || solver->isGraded() ||
+        solver->getIntegrator() != fdtdIntegratorType::Leapfrog)
+      return false;
+    if (x0 < 2 + band || y0 < 2 + band || x1 > solver->getNX() - 3 - band || y1 > solver->getNY() - 3 - band || x1 - x0 < 2 || y1 - y0 < 2)
+      return false;
+    r = ratio;
+    ix0 = x0;
+    iy0 = y0;
+    ix1 = x1;
+    iy1 = y1;
+    FX = r * (ix1 - ix0) + 1;
+    FY = r * (iy1 - iy0) + 1;
+    NR = (ix1 - ix0 + 1 + 2 * band) * (iy1 - iy0 + 1 + 2 * band) - (ix1 - ix0 - 1) * (iy1 - iy0 - 1);
+    NO = 2 * (FX - 1) + 2 * (FY - 1);
+    const double delta = solver->getDelta();
+    if (!fine.initialize(FX, FY, solver->getXmin() + ix0 * delta, solver->getYmin() + iy0 * delta, delta / r) ||
+        !fine.setCourant(solver->getCourant())) {
+      r = 0;
+      return false;
+    }
+    const size_t cells = static_cast<size_t>(FX) * FY;
+    const size_t bytes = 4 * fdtdArena::footprint<T>(cells) +
+                         7 * fdtdArena::footprint<double>(NR) +
+                         fdtdArena::footprint<int>(NR) +
+                         fdtdArena::footprint<int>(boxCells()) +
+                         fdtdArena::footprint<OutlineNode>(NO) +
+                         fdtdArena::footprint<Edge>(edgeCapacity());
+    if (!arena.reserve(bytes)) {
+      r = 0;
+      return false;
+    }
+    uE = arena.allocate<T>(cells);
+    vE = arena.allocate<T>(cells);
+    barHx = arena.allocate<T>(cells);
+    barHy = arena.allocate<T>(cells);
+    uR = arena.allocate<double>(NR);
+    vR = arena.allocate<double>(NR);
+    wR = arena.allocate<double>(NR);
+    fluxR = arena.allocate<double>(NR);
+    massR = arena.allocate<double>(NR);
+    ceeR = arena.allocate<double>(NR);
+    aehR = arena.allocate<double>(NR);
+    ringCell = arena.allocate<int>(NR);
+    ringOf = arena.allocate<int>(boxCells());
+    outline = arena.allocate<OutlineNode>(NO);
+    edges = arena.allocate<Edge>(edgeCapacity());
+
+    fine.setActivityTracking(false);
+    fine.setPECX();
+    fine.setPECY();
+    fine.sourceType(fdtdSourceType::NoSource);
+    layoutRing();
+    copyMedia();
+    prolong();
+    return true;
+  }
+
+  // zero fields in the patch (with a coarse reset())
+  void reset() {
+    const size_t bytes = sizeof(T) * FX * FY;
+    std::memset(uE, 0, bytes);
+    std::memset(vE, 0, bytes);
+    std::memset(barHx, 0, bytes);
+    std::memset(barHy, 0, bytes);
+    for (int k = 0; k < NR; k++) {
+      uR[k] = 0.0;
+      vR[k] = 0.0;
+    }
+  }
+
+  int ratio() const { return r; }
+
+  // the fine grid at node (fx, fy) is coarse node (x0 + fx / r, y0 + fy / r); it holds scratch
+  // values between steps, the patch fields are dataEz(), dataHx(), dataHy() (FX by FY, row-major)
+  const fdtdSolver<T>& grid() const { return fine; }
+  int getNX() const { return FX; }
+  int getNY() const { return FY; }
+  const T* dataEz() const { return uE; }
+  const T* dataHx() const { return barHx; }
+  const T* dataHy() const { return barHy; }
+
+  // Energy of the coarse grid with the part inside the outline from the patch (the dual cells
+  // on the outline split between the two); as the solver's, E and H are half a step apart
+  double energyE() const {
+    const int nx = coarse->getNX();
+    const T* ez = coarse->dataEz();
+    double sum = 0.0;
+    for (int iy = 0; iy < coarse->getNY(); iy++) {
+      for (int ix = 0; ix < nx; ix++) {
+        const double w = outsideArea(ix, iy);
+        if (w > 0.0) {
+          const double e = ez[nx * iy + ix];
+          sum += w * coarseMaterial(ix, iy).epr * e * e;
+        }
+      }
+    }
+    double fsum = 0.0;
+    for (int fy = 0; fy < FY; fy++) {
+      for (int fx = 0; fx < FX; fx++) {
+        const double w = inside(fx - 0.5, fx + 0.5, 0.0, FX - 1.0) * inside(fy - 0.5, fy + 0.5, 0.0, FY - 1.0);
+        const double e = uE[FX * fy + fx];
+        fsum += w * fine.getMaterialProperties(fine.getMaterial(fx, fy)).epr * e * e;
+      }
+    }
+    const double delta = coarse->getDelta();
+    return vacuum_permittivity * (sum + fsum / (r * r)) * delta * delta / 2.0;
+  }
+
+  double energyB() const {
+    const int nx = coarse->getNX();
+    double sum = 0.0;
+    for (int iy = 0; iy < coarse->getNY(); iy++) {
+      for (int ix = 0; ix < nx; ix++) {
+        const double hx = coarse->dataHx()[nx * iy + ix];
+        const double hy = coarse->dataHy()[nx * iy + ix];
+        // dual lengths outside the patch of the edges up and to the right
+        const double wx = (ix > ix0 && ix < ix1 && iy >= iy0 && iy < iy1 ? 0.0 : outside(ix - 0.5, ix + 0.5, ix0, ix1));
+        const double wy = (iy > iy0 && iy < iy1 && ix >= ix0 && ix < ix1 ? 0.0 : outside(iy - 0.5, iy + 0.5, iy0, iy1));
+        sum += coarseMaterial(ix, iy).mur * ((iy + 0.5 > iy0 && iy + 0.5 < iy1 ? wx : 1.0) * hx * hx +
+                                             (ix + 0.5 > ix0 && ix + 0.5 < ix1 ? wy : 1.0) * hy * hy);
+      }
+    }
+    double fsum = 0.0;
+    for (int fy = 0; fy < FY; fy++) {
+      for (int fx = 0; fx < FX; fx++) {
+        const double hx = (fy < FY - 1 ? barHx[FX * fy + fx] : 0.0);
+        const double hy = (fx < FX - 1 ? barHy[FX * fy + fx] : 0.0);
+        const double wx = inside(fx - 0.5, fx + 0.5, 0.0, FX - 1.0);
+        const double wy = inside(fy - 0.5, fy + 0.5, 0.0, FY - 1.0);
+        fsum += fine.getMaterialProperties(fine.getMaterial(fx, fy)).mur * (wx * hx * hx + wy * hy * hy);
+      }
+    }
+    const double delta = coarse->getDelta();
+    return vacuum_permeability * (sum + fsum / (r * r)) * delta * delta / 2.0;
+  }
+
+  // materials of the patch (finer features than the coarse grid can hold); media as
+  // fdtdSolver::defineMaterial(), the rectangle [fx0, fx1) x [fy0, fy1) in fine cells
+  int defineMaterial(double mur,
+                     double epr,
+                     double sigmam,
+                     double sigma)
+  {
+    const int id = fine.defineMaterial(mur, epr, 0.0, 0.0);
+    if (id >= 0)
+      setLosses(id, mur, epr, sigmam, sigma);
+    return id;
+  }
+
+  void paintMaterial(int id,
+                     int fx0,
+                     int fy0,
+                     int fx1,
+                     int fy1)
+  {
+    fine.paintMaterial(id, fx0, fy0, fx1, fy1);
+    prepareRing();
+  }
+
+  // One coarse step with the patch: beginStep(), the coarse step, then endStep(); drivers with
+  // several (disjoint) patches call beginStep() on all of them before the coarse step
+  void update() {
+    beginStep();
+    coarse->update();
+    endStep();
+  }
+
+  void advance(int nsteps) {
+    for (int n = 0; n < nsteps; n++) update();
+  }
+
+  // the substeps, from the coarse fields at n (so before the coarse step)
+  void beginStep() {
+    const T* ez = coarse->dataEz();
+    srcValue = coarse->sourceValue(0.0);
+    srcCell = coarse->sourceCell();
+
+    T* w = fine.rowEz(0);
+    T* hx = fine.rowHx(0);
+    T* hy = fine.rowHy(0);
+    const size_t cells = static_cast<size_t>(FX) * FY;
+    std::memcpy(w, uE, sizeof(T) * cells);
+    std::memset(hx, 0, sizeof(T) * cells);
+    std::memset(hy, 0, sizeof(T) * cells);
+    for (int k = 0; k < NR; k++) wR[k] = uR[k];
+    for (int e = 0; e < NE; e++) {
+      edges[e].h = 0.0;
+      edges[e].sum = 0.0;
+    }
+    if (lossyH) {
+      for (int i = 0; i < FX * FY; i++) {
+        const double c = chhF[fine.getMaterial(i % FX, i / FX)];
+        barHx[i] = static_cast<T>(c * barHx[i]);
+        barHy[i] = static_cast<T>(c * barHy[i]);
+      }
+    }
+
+    const double ce = vacuum_impedance * coarse->getCourant() / r;
+    for (int m = 0; m < r; m++) {
+      fine.updateHRows(0, FY);
+      for (int e = 0; e < NE; e++) {
+        Edge& E = edges[e];
+        const double ea = (E.a >= 0 ? wR[E.a] : static_cast<double>(ez[-1 - E.a]));
+        const double eb = (E.b >= 0 ? wR[E.b] : static_cast<double>(ez[-1 - E.b]));
+        E.h += E.sign * E.ch * (eb - ea);
+      }
+      if (m == 0) {
+        // the first substep is a half step: the edges start at rest
+        for (size_t i = 0; i < cells; i++) {
+          hx[i] = static_cast<T>(0.5) * hx[i];
+          hy[i] = static_cast<T>(0.5) * hy[i];
+        }
+        for (int e = 0; e < NE; e++) edges[e].h *= 0.5;
+      }
+      for (int e = 0; e < NE; e++) edges[e].sum += edges[e].h;
+      accumulateBar(hx, hy);
+
+      fine.updateERows(1, FY - 1);
+      ringFlux(hx, hy);
+      for (int k = 0; k < NR; k++) wR[k] += ce * fluxR[k] / massR[k];
+      driveOutline(w, wR);
+    }
+  }
+
+  // the coarse step has taken the other coarse nodes to n + 1 with H of the shared edges at the
+  // plain coarse value: swap in the substepped one, and finish the shared and fine nodes
+  void endStep() {
+    T* ez = coarse->rowEz(0);
+    for (int e = 0; e < NE; e++) {
+      Edge& E = edges[e];
+      const double h = E.chh * E.bar + E.ahe * (2.0 / r) * E.sum;
+      const double d = h - static_cast<double>(*E.field);
+      *E.field = static_cast<T>(h);
+      E.bar = h;
+      if (E.a < 0) ez[-1 - E.a] = static_cast<T>(ez[-1 - E.a] + E.cehA * E.sign * d);
+      if (E.b < 0) ez[-1 - E.b] = static_cast<T>(ez[-1 - E.b] - E.cehB * E.sign * d);
+    }
+
+    for (int k = 0; k < NR; k++) {
+      const double u = ceeR[k] * uR[k] + vR[k] + aehR[k] * 2.0 * (wR[k] - uR[k]);
+      vR[k] = u - ceeR[k] * uR[k];
+      uR[k] = u;
+      if (ringCell[k] == srcCell)
+        uR[k] = (coarse->sourceAdditive() ? uR[k] + srcValue : srcValue);
+      ez[ringCell[k]] = static_cast<T>(uR[k]);
+    }
+
+    const T* w = fine.dataEz();
+    for (int fy = 1; fy < FY - 1; fy++) {
+      for (int fx = 1; fx < FX - 1; fx++) {
+        const int i = FX * fy + fx;
+        const int id = fine.getMaterial(fx, fy);
+        const double u = ceeF[id] * uE[i] + vE[i] + aehF[id] * 2.0 * (w[i] - uE[i]);
+        vE[i] = static_cast<T>(u - ceeF[id] * uE[i]);
+        uE[i] = static_cast<T>(u);
+      }
+    }
+    driveOutline(uE, uR);
+    injectSource();
+    restrict();
+  }
+
+private:
+  // a fine node on the outline: the coarse nodes it follows, and the dual lengths (in fine cells)
+  // of its edges to the right, left, up and down (zero when the edge leaves the patch)
+  struct OutlineNode
+  {
+    int cell;
+    int c0;
+    int c1;
+    double s; // weight of c1
+    double lr, ll, lu, ld;
+    double area; // of its dual cell inside the patch (in fine cells)
+  };
+
+  // a coarse H edge at a shared node with (part of) its dual length outside the patch;
+  // a, b are its nodes (ring index, or -1 - coarse cell for the others)
+  struct Edge
+  {
+    T* field;
+    int a;
+    int b;
+    double sign;  // +1 for Hy (H += c (Eb - Ea)), -1 for Hx
+    double ch;    // lossless coefficient for one substep
+    double chh;   // lossy step coefficients
+    double ahe;
+    double cehA;  // E coefficients of the coarse node a or b, if it is not shared
+    double cehB;
+    double frac;  // dual length outside the patch (in coarse cells)
+    double h;     // substep value
+    double sum;
+    double bar;   // at n - 1/2
+  };
+
+  fdtdSolver<T>* coarse;
+  fdtdSolver<T> fine; // lossless media; the substep engine
+  int r;
+  int ix0; // coarse nodes [ix0, ix1] x [iy0, iy1]
+  int iy0;
+  int ix1;
+  int iy1;
+  int FX;
+  int FY;
+  int NR; // shared (coarse outline) nodes
+  int NO; // fine outline nodes
+  int NE; // edges
+
+  fdtdArena arena;
+  T* uE;    // fine Ez at n
+  T* vE;    // uE - cee * (uE at n - 1)
+  T* barHx; // fine H at n - 1/2
+  T* barHy;
+  double* uR; // shared nodes as uE, vE
+  double* vR;
+  double* wR; // and in the substeps
+  double* fluxR;
+  double* massR; // epr times dual area (coarse cells)
+  double* ceeR;
+  double* aehR;
+  int* ringCell;
+  int* ringOf; // coarse node of the patch -> ring index (-1 inside)
+  OutlineNode* outline;
+  Edge* edges;
+
+  // loss factors over a coarse step for the fine materials (the fine solver itself is lossless)
+  double ceeF[fdtdSolver<T>::maxMaterials];
+  double aehF[fdtdSolver<T>::maxMaterials];
+  double chhF[fdtdSolver<T>::maxMaterials];
+  double aheF[fdtdSolver<T>::maxMaterials];
+  bool lossyH;
+
+  int srcCell;
+  double srcValue;
+
+  // right and up of every shared node, left of the first column and down of the first row
+  int edgeCapacity() const { return 2 * NR + (ix1 - ix0 + 1 + 2 * band) + (iy1 - iy0 + 1 + 2 * band); }
+
+  int boxCells() const { return (ix1 - ix0 + 1 + 2 * band) * (iy1 - iy0 + 1 + 2 * band); }
+
+  int coarseCell(int ix, int iy) const { return coarse->getNX() * iy + ix; }
+
+  int ring(int ix,
+           int iy) const
+  {
+    if (ix < ix0 - band || ix > ix1 + band || iy < iy0 - band || iy > iy1 + band)
+      return -1;
+    return ringOf[(ix1 - ix0 + 1 + 2 * band) * (iy - iy0 + band) + (ix - ix0 + band)];
+  }
+
+  // length of [a, b] outside the open interval (lo, hi)
+  static double outside(double a,
+                        double b,
+                        double lo,
+                        double hi)
+  {
+    const double in0 = (a > lo ? a : lo);
+    const double in1 = (b < hi ? b : hi);
+    return (b - a) - (in1 > in0 ? in1 - in0 : 0.0);
+  }
+
+  // length of [a, b] within [lo, hi]
+  static double inside(double a,
+                       double b,
+                       double lo,
+                       double hi)
+  {
+    const double in0 = (a > lo ? a : lo);
+    const double in1 = (b < hi ? b : hi);
+    return (in1 > in0 ? in1 - in0 : 0.0);
+  }
+
+  void layoutRing() {
+    const int w = ix1 - ix0 + 1 + 2 * band;
+    for (int i = 0; i < boxCells(); i++) ringOf[i] = -1;
+    int k = 0;
+    for (int iy = iy0 - band; iy <= iy1 + band; iy++) {
+      for (int ix = ix0 - band; ix <= ix1 + band; ix++) {
+        if (ix <= ix0 || ix >= ix1 || iy <= iy0 || iy >= iy1) {
+          ringOf[w * (iy - iy0 + band) + (ix - ix0 + band)] = k;
+          ringCell[k++] = coarseCell(ix, iy);
+        }
+      }
+    }
+
+    // fine outline nodes
+    int n = 0;
+    for (int fy = 0; fy < FY; fy++) {
+      for (int fx = 0; fx < FX; fx++) {
+        if (fx != 0 && fx != FX - 1 && fy != 0 && fy != FY - 1)
+          continue;
+        OutlineNode& o = outline[n++];
+        o.cell = FX * fy + fx;
+        const int cx = ix0 + fx / r;
+        const int cy = iy0 + fy / r;
+        o.c0 = ring(cx, cy);
+        o.c1 = o.c0;
+        o.s = 0.0;
+        if (fx % r != 0) {
+          o.c1 = ring(cx + 1, cy);
+          o.s = static_cast<double>(fx % r) / r;
+        } else if (fy % r != 0) {
+          o.c1 = ring(cx, cy + 1);
+          o.s = static_cast<double>(fy % r) / r;
+        }
+        const double lx = inside(fx - 0.5, fx + 0.5, 0.0, FX - 1.0);
+        const double ly = inside(fy - 0.5, fy + 0.5, 0.0, FY - 1.0);
+        o.lr = (fx < FX - 1 ? ly : 0.0);
+        o.ll = (fx > 0 ? ly : 0.0);
+        o.lu = (fy < FY - 1 ? lx : 0.0);
+        o.ld = (fy > 0 ? lx : 0.0);
+        o.area = lx * ly;
+      }
+    }
+
+    // coarse edges at shared nodes with dual length outside the patch: to the right and up of
+    // every shared node, and to the left and down where that reaches a node that is not shared
+    NE = 0;
+    for (int k = 0; k < NR; k++) {
+      const int ix = ringCell[k] % coarse->getNX();
+      const int iy = ringCell[k] / coarse->getNX();
+      addEdge(ix, iy, ix + 1, iy);
+      addEdge(ix, iy, ix, iy + 1);
+      if (ring(ix - 1, iy) < 0) addEdge(ix - 1, iy, ix, iy);
+      if (ring(ix, iy - 1) < 0) addEdge(ix, iy - 1, ix, iy);
+    }
+  }
+
+  // the edge from node (ax, ay) to (bx, by), one cell to the right or up, if its dual segment
+  // (across it, through its midpoint) reaches outside the patch
+  void addEdge(int ax,
+               int ay,
+               int bx,
+               int by)
+  {
+    const bool alongX = (by == ay);
+    double f = 1.0;
+    if (alongX && ax + 0.5 > ix0 && ax + 0.5 < ix1) f = outside(ay - 0.5, ay + 0.5, iy0, iy1);
+    if (!alongX && ay + 0.5 > iy0 && ay + 0.5 < iy1) f = outside(ax - 0.5, ax + 0.5, ix0, ix1);
+    if (f <= 0.0)
+      return;
+    Edge& e = edges[NE++];
+    e.field = (alongX ? coarse->rowHy(ay) + ax : coarse->rowHx(ay) + ax);
+    const int ra = ring(ax, ay);
+    const int rb = ring(bx, by);
+    e.a = (ra >= 0 ? ra : -1 - coarseCell(ax, ay));
+    e.b = (rb >= 0 ? rb : -1 - coarseCell(bx, by));
+    e.sign = (alongX ? 1.0 : -1.0);
+    e.frac = f;
+    e.bar = static_cast<double>(*e.field);
+  }
+
+  void setLosses(int id,
+                 double mur,
+                 double epr,
+                 double sigmam,
+                 double sigma)
+  {
+    // loss factors depend on the timestep only, so the coarse ones apply
+    fdtdMaterial<T> m;
+    m.set(mur, epr, sigmam, sigma, coarse->getDelta(), coarse->getCourant());
+    ceeF[id] = m.cee;
+    aehF[id] = 0.5 * (1.0 + static_cast<double>(m.cee));
+    chhF[id] = m.chh;
+    aheF[id] = 0.5 * (1.0 + static_cast<double>(m.chh));
+    if (sigmam != 0.0) lossyH = true;
+  }
+
+  // the coarse materials (lossless on the fine grid), each fine cell taking that of the nearest coarse node
+  void copyMedia() {
+    lossyH = false;
+    const fdtdMaterial<T>& m0 = coarse->getMaterialProperties(0);
+    fine.setUniformMedium(m0.mur, m0.epr, 0.0, 0.0);
+    setLosses(0, m0.mur, m0.epr, m0.sigmam, m0.sigma);
+    for (int id = 1; id < coarse->getMaterialCount(); id++) {
+      const fdtdMaterial<T>& m = coarse->getMaterialProperties(id);
+      defineMaterial(m.mur, m.epr, m.sigmam, m.sigma);
+    }
+    for (int iy = iy0; iy <= iy1; iy++) {
+      for (int ix = ix0; ix <= ix1; ix++) {
+        const int id = coarse->getMaterial(ix, iy);
+        const int fx = r * (ix - ix0) - r / 2;
+        const int fy = r * (iy - iy0) - r / 2;
+        if (id != 0)
+          fine.paintMaterial(id, fx, fy, fx + r, fy + r);
+      }
+    }
+    prepareRing();
+  }
+
+  // masses and coefficients of the shared nodes and edges
+  void prepareRing() {
+    const double courant = coarse->getCourant();
+    for (int k = 0; k < NR; k++) {
+      const int ix = ringCell[k] % coarse->getNX();
+      const int iy = ringCell[k] / coarse->getNX();
+      const fdtdMaterial<T>& m = coarse->getMaterialProperties(coarse->getMaterial(ix, iy));
+      massR[k] = m.epr * outsideArea(ix, iy);
+      ceeR[k] = m.cee;
+      aehR[k] = 0.5 * (1.0 + static_cast<double>(m.cee));
+    }
+    for (int n = 0; n < NO; n++) {
+      const OutlineNode& o = outline[n];
+      const double epr = fine.getMaterialProperties(fine.getMaterial(o.cell % FX, o.cell / FX)).epr;
+      const double a = epr * o.area / (r * r);
+      massR[o.c0] += (1.0 - o.s) * a;
+      if (o.s > 0.0) massR[o.c1] += o.s * a;
+    }
+    for (int e = 0; e < NE; e++) {
+      Edge& E = edges[e];
+      const int cell = static_cast<int>(E.field - (E.sign > 0 ? coarse->dataHy() : coarse->dataHx()));
+      const fdtdMaterial<T>& m = coarse->getMaterialProperties(coarse->getMaterial(cell % coarse->getNX(), cell / coarse->getNX()));
+      E.ch = courant / (m.mur * vacuum_impedance) / r;
+      E.chh = m.chh;
+      E.ahe = 0.5 * (1.0 + static_cast<double>(m.chh));
+      E.cehA = (E.a < 0 ? static_cast<double>(materialAt(-1 - E.a).ceh) : 0.0);
+      E.cehB = (E.b < 0 ? static_cast<double>(materialAt(-1 - E.b).ceh) : 0.0);
+    }
+  }
+
+  const fdtdMaterial<T>& coarseMaterial(int ix, int iy) const {
+    return coarse->getMaterialProperties(coarse->getMaterial(ix, iy));
+  }
+
+  // area of the dual cell of a coarse node outside the patch (in coarse cells)
+  double outsideArea(int ix,
+                     int iy) const
+  {
+    return 1.0 - inside(ix - 0.5, ix + 0.5, ix0, ix1) * inside(iy - 0.5, iy + 0.5, iy0, iy1);
+  }
+
+  const fdtdMaterial<T>& materialAt(int cell) const {
+    return coarse->getMaterialProperties(coarse->getMaterial(cell % coarse->getNX(), cell / coarse->getNX()));
+  }
+
+  // net H circulation into each shared node, in coarse cell units: its coarse edges outside the
+  // patch, and the fine edges of the outline nodes that follow it
+  void ringFlux(const T* hx,
+                const T* hy)
+  {
+    for (int k = 0; k < NR; k++) fluxR[k] = 0.0;
+    for (int e = 0; e < NE; e++) {
+      const Edge& E = edges[e];
+      const double q = E.sign * E.frac * E.h;
+      if (E.a >= 0) fluxR[E.a] += q;
+      if (E.b >= 0) fluxR[E.b] -= q;
+    }
+    for (int n = 0; n < NO; n++) {
+      const OutlineNode& o = outline[n];
+      const int i = o.cell;
+      double q = 0.0;
+      if (o.lr > 0.0) q += o.lr * hy[i];
+      if (o.ll > 0.0) q -= o.ll * hy[i - 1];
+      if (o.lu > 0.0) q -= o.lu * hx[i];
+      if (o.ld > 0.0) q += o.ld * hx[i - FX];
+      q /= r;
+      fluxR[o.c0] += (1.0 - o.s) * q;
+      if (o.s > 0.0) fluxR[o.c1] += o.s * q;
+    }
+  }
+
+  template <typename V>
+  void driveOutline(T* ez,
+                    const V* ring) const
+  {
+    for (int n = 0; n < NO; n++) {
+      const OutlineNode& o = outline[n];
+      ez[o.cell] = static_cast<T>((1.0 - o.s) * ring[o.c0] + o.s * ring[o.c1]);
+    }
+  }
+
+  // fine H at n + 1/2 as the coarse edges: twice the substep mean
+  void accumulateBar(const T* hx,
+                     const T* hy)
+  {
+    const int cells = FX * FY;
+    if (!lossyH) {
+      const T c = static_cast<T>(2.0 / r);
+      for (int i = 0; i < cells; i++) {
+        barHx[i] += c * hx[i];
+        barHy[i] += c * hy[i];
+      }
+      return;
+    }
+    for (int i = 0; i < cells; i++) {
+      const T c = static_cast<T>(aheF[fine.getMaterial(i % FX, i / FX)] * 2.0 / r);
+      barHx[i] += c * hx[i];
+      barHy[i] += c * hy[i];
+    }
+  }
+
+  // a coarse source strictly inside the outline goes to the fine nodes around the same place,
+  // spread as the coarse cell interpolates (injected at a single fine node, it excites fine modes
+  // that the coarse step cannot follow); an additive source adds the same total
+  void injectSource() {
+    const int nx = coarse->getNX();
+    if (srcCell < 0)
+      return;
+    const int sx = srcCell % nx;
+    const int sy = srcCell / nx;
+    if (sx <= ix0 || sx >= ix1 || sy <= iy0 || sy >= iy1)
+      return;
+    const bool additive = coarse->sourceAdditive();
+    const int cx = r * (sx - ix0);
+    const int cy = r * (sy - iy0);
+    for (int dy = 1 - r; dy < r; dy++) {
+      for (int dx = 1 - r; dx < r; dx++) {
+        const double w = (1.0 - std::fabs(dx) / r) * (1.0 - std::fabs(dy) / r);
+        T& e = uE[FX * (cy + dy) + cx + dx];
+        e = static_cast<T>(additive ? e + w * srcValue : e + w * (srcValue - e));
+      }
+    }
+  }
+
+  // the coarse fields strictly inside the outline from the fine ones at the same place (H for
+  // even r: the mean of the two nearest fine rows or columns)
+  void restrict() {
+    const int lo = (r - 1) / 2;
+    const int hi = r / 2;
+    for (int iy = iy0; iy < iy1; iy++) {
+      T* ez = coarse->rowEz(iy);
+      T* hx = coarse->rowHx(iy);
+      T* hy = coarse->rowHy(iy);
+      const int fy = r * (iy - iy0);
+      for (int ix = ix0 + 1; ix < ix1; ix++) {
+        const int fx = r * (ix - ix0);
+        if (iy > iy0) ez[ix] = uE[FX * fy + fx];
+        hx[ix] = static_cast<T>(0.5 * (barHx[FX * (fy + lo) + fx] + barHx[FX * (fy + hi) + fx]));
+      }
+      if (iy > iy0) {
+        for (int ix = ix0; ix < ix1; ix++) {
+          const int fx = r * (ix - ix0);
+          hy[ix] = static_cast<T>(0.5 * (barHy[FX * fy + fx + lo] + barHy[FX * fy + fx + hi]));
+        }
+      }
+    }
+  }
+
+  // fine fields interpolated from the coarse ones (which are at the same times), and vE to match
+  void prolong() {
+    const double ce = vacuum_impedance * coarse->getCourant();
+    for (int fy = 0; fy < FY; fy++) {
+      const double y = iy0 + static_cast<double>(fy) / r;
+      for (int fx = 0; fx < FX; fx++) {
+        const double x = ix0 + static_cast<double>(fx) / r;
+        const int i = FX * fy + fx;
+        uE[i] = sample(coarse->dataEz(), x, y);
+        barHx[i] = sample(coarse->dataHx(), x, y + 0.5 / r - 0.5);
+        barHy[i] = sample(coarse->dataHy(), x + 0.5 / r - 0.5, y);
+      }
+    }
+    for (int k = 0; k < NR; k++) uR[k] = coarse->dataEz()[ringCell[k]];
+    driveOutline(uE, uR);
+
+    // vE = aeh * (the coarse-step E change from H at n - 1/2): r lossless substeps' worth
+    T* w = fine.rowEz(0);
+    T* hx = fine.rowHx(0);
+    T* hy = fine.rowHy(0);
+    const size_t cells = static_cast<size_t>(FX) * FY;
+    std::memset(w, 0, sizeof(T) * cells);
+    std::memcpy(hx, barHx, sizeof(T) * cells);
+    std::memcpy(hy, barHy, sizeof(T) * cells);
+    fine.updateERows(1, FY - 1);
+    for (size_t i = 0; i < cells; i++) {
+      const int id = fine.getMaterial(static_cast<int>(i % FX), static_cast<int>(i / FX));
+      vE[i] = static_cast<T>(aehF[id] * r * w[i]);
+    }
+    for (int e = 0; e < NE; e++) edges[e].h = edges[e].bar;
+    ringFlux(hx, hy);
+    for (int k = 0; k < NR; k++) vR[k] = aehR[k] * ce * fluxR[k] / massR[k];
+  }
+
+  // bilinear in a coarse array at (fractional) indices x, y
+  T sample(const T* f,
+           double x,
+           double y) const
+  {
+    const int nx = coarse->getNX();
+    const int i = static_cast<int>(std::floor(x));
+    const int j = static_cast<int>(std::floor(y));
+    const double tx = x - i;
+    const double ty = y - j;
+    const T* p = f + nx * j + i;
+    return static_cast<T>((1.0 - ty) * ((1.0 - tx) * p[0] + tx * p[1]) + ty * ((1.0 - tx) * p[nx] + tx * p[nx + 1]));
+  }
+};
+
+}
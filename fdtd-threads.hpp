@@ -0,0 +1,137 @@
+#pragma once
+
+// Fixed pool of worker threads that run one job on all threads at once (the caller is thread 0),
+// with a barrier for the phases inside the job. Define FDTD_THREADS (and include <thread>, <mutex>,
+// <condition_variable>, <atomic>) to enable it; otherwise the pool is always a single thread.
+// The browser app leaves it undefined (a standalone wasm build, without workers): one thread.
+class fdtdThreadPool
+{
+public:
+  static const int maxThreads = 64;
+
+  fdtdThreadPool() : count(1) {}
+  ~fdtdThreadPool() { stop(); }
+
+  fdtdThreadPool(const fdtdThreadPool&) = delete;
+  fdtdThreadPool& operator=(const fdtdThreadPool&) = delete;
+
+  // (re)start with n threads in total (clamped to [1, maxThreads]); returns the actual count
+  int start(int n) {
+    stop();
+    n = (n < 1 ? 1 : (n > maxThreads ? maxThreads : n));
+#ifdef FDTD_THREADS
+    job = nullptr;
+    generation = 0;
+    pending = 0;
+    quit = false;
+    arrived.store(0);
+    sense.store(0);
+    count = n;
+    for (int t = 1; t < count; t++)
+      workers[t] = std::thread(&fdtdThreadPool::workerLoop, this, t);
+#endif
+    return count;
+  }
+
+  void stop() {
+#ifdef FDTD_THREADS
+    if (count > 1) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+      }
+      wake.notify_all();
+      for (int t = 1; t < count; t++)
+        workers[t].join();
+    }
+#endif
+    count = 1;
+  }
+
+  int size() const { return count; }
+
+  // calls f(t) for t = 0 .. size() - 1 concurrently; returns when all calls have returned
+  template <typename F>
+  void run(F& f) {
+    if (count == 1) {
+      f(0);
+      return;
+    }
+#ifdef FDTD_THREADS
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job = &thunk<F>;
+      context = &f;
+      pending = count - 1;
+      generation++;
+    }
+    wake.notify_all();
+    f(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+#endif
+  }
+
+  // to be called by all size() threads inside a job; none returns before all have arrived
+  void barrier() {
+#ifdef FDTD_THREADS
+    if (count == 1)
+      return;
+    const int s = sense.load(std::memory_order_relaxed);
+    if (arrived.fetch_add(1, std::memory_order_acq_rel) == count - 1) {
+      arrived.store(0, std::memory_order_relaxed);
+      sense.store(s ^ 1, std::memory_order_release);
+      return;
+    }
+    int spins = 0;
+    while (sense.load(std::memory_order_acquire) == s) {
+      if (++spins > 4096) std::this_thread::yield();
+    }
+#endif
+  }
+
+private:
+  int count;
+
+#ifdef FDTD_THREADS
+  std::thread workers[maxThreads];
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  void (*job)(void*, int);
+  void* context;
+  unsigned generation;
+  int pending;
+  bool quit;
+
+  // sense-reversing spin barrier (phases are short, so do not sleep right away)
+  std::atomic<int> arrived;
+  std::atomic<int> sense;
+
+  template <typename F>
+  static void thunk(void* f, int t) { (*static_cast<F*>(f))(t); }
+
+  void workerLoop(int t) {
+    unsigned seen = 0;
+    for (;;) {
+      void (*fn)(void*, int);
+      void* ctx;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this, seen] { return quit || generation != seen; });
+        if (quit)
+          return;
+        seen = generation;
+        fn = job;
+        ctx = context;
+      }
+      fn(ctx, t);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0)
+          done.notify_one();
+      }
+    }
+  }
+#endif
+};
@@ -2,53 +2,105 @@
 
 namespace TMz {
 
-template <int NX, int NY>
+enum fdtdKernelType {
+  Reference, // original column-ordered loops (one pass for H, one for E)
+  Tiled      // unit-stride rows, fused H-then-E sweep over column strips
+};
+
+// Specializations of the row kernels, picked at run time from the current medium
+enum fdtdMediumType {
+  PerCellMedium,  // coefficients looked up through the material map
+  UniformMedium,  // one material everywhere: coefficients held in registers
+  LosslessMedium  // uniform and lossless: the field multiply (chh = cee = 1) is dropped
+};
+
+enum fdtdStencilType {
+  SecondOrder, // Yee: one-cell differences
+  FourthOrder  // FDTD(2,4): (9/8) one-cell minus (1/24) three-cell differences, Yee next to the edges
+};
+
+enum fdtdIntegratorType {
+  Leapfrog,         // second order in time
+  FourthOrderInTime // leapfrog on fields corrected by the modified equation: fourth order, Courant number up to 2.013
+};
+
+// mirror plane at the left (bottom) edge of the grid, through its Ez nodes
+enum fdtdSymmetryType {
+  NoSymmetry,
+  OddSymmetry, // PEC plane: Ez odd across it (zero on it)
+  EvenSymmetry // PMC plane: Ez even across it, the H parallel to it odd (zero on it)
+};
+
+// Second order Mur absorbing boundary. The history of the three cells nearest each edge at the
+// two previous steps is kept planar: one contiguous run per (plane, distance from the edge),
+// indexed by row (left, right) or column (top, bottom). The two planes swap roles with the step
+// parity: the plane holding two-steps-back values is read and then overwritten with the new
+// values in the same loop, so recording is a store and not a copy. The parity of the step being
+// computed is passed in, which lets partial updates (column ranges, single rows) interleave freely.
+template <typename T>
 struct fdtdAbsorbingBoundary
 {
-  double ezLeft[6 * NY];
-  double ezRight[6 * NY];
-  double ezTop[6 * NX];
-  double ezBottom[6 * NX];
-
-  double coef0, coef1, coef2;
-  int bskip;
+  typedef fdtdVec<T> V;
 
-  int indexLR(int m, int q, int n) const {
-    return n * 6 + q * 3 + m;
-  }
+  int NX;
+  int NY;
 
-  double EzLeft(int m, int q, int n) const {
-    return ezLeft[indexLR(m, q, n)];
-  }
+  T* left[2][3];   // [plane][distance] NY each
+  T* right[2][3];  // NY each
+  T* top[2][3];    // NX each
+  T* bottom[2][3]; // NX each
 
-  double EzRight(int m, int q, int n) const {
-    return ezRight[indexLR(m, q, n)];
-  }
+  enum { Left, Right, Bottom, Top };
 
-  int indexTB(int n, int q, int m) const {
-    return m * 6 + q * 3 + n;
-  }
+  T coef[4][3]; // per edge: on a graded mesh each edge has its own Courant number
+  int bskip;
+  int rowSkip; // first row of the x edges and first column of the y edges: bskip, but 0 where
+  int colSkip; // the edge meets an even symmetry plane (there the end is no corner)
 
-  double EzTop(int n, int q, int m) const {
-    return ezTop[indexTB(n, q, m)];
+  int index(int ix, int iy) const {
+    return NX * iy + ix;
   }
 
-  double EzBottom(int n, int q, int m) const {
-    return ezBottom[indexTB(n, q, m)];
+  static size_t footprint(int nx, int ny) {
+    return 12 * fdtdArena::footprint<T>(ny) + 
+           12 * fdtdArena::footprint<T>(nx);
   }
 
-  int index(int ix, int iy) const {
-    return NX * iy + ix;
+  bool allocate(fdtdArena& arena, 
+                int nx, 
+                int ny)
+  {
+    NX = nx;
+    NY = ny;
+    bool ok = true;
+    for (int p = 0; p < 2; p++) {
+      for (int w = 0; w < 3; w++) {
+        left[p][w] = arena.allocate<T>(NY);
+        right[p][w] = arena.allocate<T>(NY);
+        top[p][w] = arena.allocate<T>(NX);
+        bottom[p][w] = arena.allocate<T>(NX);
+        ok = ok && left[p][w] != nullptr && right[p][w] != nullptr && top[p][w] != nullptr && bottom[p][w] != nullptr;
+      }
+    }
+    return ok;
   }
 
   void zeroX() {
-    std::memset(ezLeft, 0 , sizeof(double) * 6 * NY);
-    std::memset(ezRight, 0 , sizeof(double) * 6 * NY);
+    for (int p = 0; p < 2; p++) {
+      for (int w = 0; w < 3; w++) {
+        std::memset(left[p][w], 0, sizeof(T) * NY);
+        std::memset(right[p][w], 0, sizeof(T) * NY);
+      }
+    }
   }
 
   void zeroY() {
-    std::memset(ezTop, 0 , sizeof(double) * 6 * NX);
-    std::memset(ezBottom, 0 , sizeof(double) * 6 * NX);
+    for (int p = 0; p < 2; p++) {
+      for (int w = 0; w < 3; w++) {
+        std::memset(top[p][w], 0, sizeof(T) * NX);
+        std::memset(bottom[p][w], 0, sizeof(T) * NX);
+      }
+    }
   }
 
   void zero() {
@@ -56,99 +108,374 @@ struct fdtdAbsorbingBoundary
     zeroY();
   }
 
-  void cornerExclude() { bskip = 1; }
-  void cornerInclude() { bskip = 0; }
+  void cornerExclude() { bskip = rowSkip = colSkip = 1; }
+  void cornerInclude() { bskip = rowSkip = colSkip = 0; }
+
+  void mirrorCorners(bool evenX,
+                     bool evenY)
+  {
+    colSkip = (evenX ? 0 : bskip);
+    rowSkip = (evenY ? 0 : bskip);
+  }
 
   void initialize(double cezh0, 
                   double chye0) 
   {
     const double temp1 = std::sqrt(cezh0 * chye0);
-    const double temp2 = 1.0 / temp1 + 2.0 + temp1;
-    coef0 = -(1.0 / temp1 - 2.0 + temp1) / temp2;
-    coef1 = -2.0 * (temp1 - 1.0 / temp1) / temp2;
-    coef2 = 4.0 * (temp1 + 1.0 / temp1) / temp2;
+    for (int side = 0; side < 4; side++)
+      setCourant(side, temp1);
     cornerExclude(); // NOTE: if this is 0; problems appear ** in combination ** with periodic boundaries
     zero();
   }
 
-  void applyLeft(double* Ez,
-                 bool apply = true,
-                 bool record = true)
+  // coefficients of one edge for the Courant number temp1 of the cells next to it
+  void setCourant(int side,
+                  double temp1)
   {
-    for (int iy = bskip; iy < NY - bskip; iy++) {
-      if (apply)
-        Ez[index(0, iy)] = coef0 * (Ez[index(2, iy)] + EzLeft(0, 1, iy)) + 
-                           coef1 * (EzLeft(0, 0, iy) + EzLeft(2, 0, iy) - Ez[index(1, iy)] - EzLeft(1, 1, iy)) +
-                           coef2 * EzLeft(1, 0, iy) - EzLeft(2, 1, iy);
-      if (record)
-        for (int w = 0; w < 3; w++) {
-          ezLeft[indexLR(w, 1, iy)] = EzLeft(w, 0, iy);
-          ezLeft[indexLR(w, 0, iy)] = Ez[index(w, iy)];
-        }
-    }
+    const double temp2 = 1.0 / temp1 + 2.0 + temp1;
+    coef[side][0] = static_cast<T>(-(1.0 / temp1 - 2.0 + temp1) / temp2);
+    coef[side][1] = static_cast<T>(-2.0 * (temp1 - 1.0 / temp1) / temp2);
+    coef[side][2] = static_cast<T>(4.0 * (temp1 + 1.0 / temp1) / temp2);
+  }
+
+  // new edge value from the cells at distance 1, 2 (e1, e2) and the history (r: one step back, o: two steps back)
+  static T edge(const T* c, T e1, T e2, T r0, T r1, T r2, T o0, T o1, T o2) {
+    return c[0] * (e2 + o0) + c[1] * (r0 + r2 - e1 - o1) + c[2] * r1 - o2;
   }
 
-  void applyRight(double* Ez,
-                  bool apply = true,
-                  bool record = true)
+  void applyLeft(T* Ez,
+                 int parity)
   {
-    for (int iy = bskip; iy < NY - bskip; iy++) {
-      if (apply)
-        Ez[index(NX - 1, iy)] = coef0 * (Ez[index(NX - 3, iy)] + EzRight(0, 1, iy)) +
-                                coef1 * (EzRight(0, 0, iy) + EzRight(2, 0, iy) - Ez[index(NX - 2, iy)] - EzRight(1, 1, iy)) +
-                                coef2 * EzRight(1, 0, iy) - EzRight(2, 1, iy);
-      if (record)
-        for (int w = 0; w < 3; w++) {
-          ezRight[indexLR(w, 1, iy)] = EzRight(w, 0, iy);
-          ezRight[indexLR(w, 0, iy)] = Ez[index(NX - 1 - w, iy)];
-        }
-    }
+    for (int iy = rowSkip; iy < NY - bskip; iy++)
+      applyLeftRow(Ez, iy, parity);
   }
 
-  void applyTop(double* Ez,
-                bool apply = true,
-                bool record = true)
+  void applyLeftRow(T* Ez,
+                    int iy,
+                    int parity)
   {
-    for (int ix = bskip; ix < NX - bskip; ix++) {
-      if (apply)
-        Ez[index(ix, NY - 1)] = coef0 * (Ez[index(ix, NY - 3)] + EzTop(0, 1, ix)) + 
-                                coef1 * (EzTop(0, 0, ix) + EzTop(2, 0, ix) - Ez[index(ix, NY - 2)] - EzTop(1, 1, ix)) + 
-                                coef2 * EzTop(1, 0, ix) - EzTop(2, 1, ix);
-      if (record)
-        for (int w = 0; w < 3; w++) {
-          ezTop[indexTB(w, 1, ix)] = EzTop(w, 0, ix);
-          ezTop[indexTB(w, 0, ix)] = Ez[index(ix, NY - 1 - w)];
-        }
+    T* const* r = left[parity];
+    T* const* o = left[parity ^ 1];
+    T* e = Ez + index(0, iy);
+    e[0] = edge(coef[Left], e[1], e[2], r[0][iy], r[1][iy], r[2][iy], o[0][iy], o[1][iy], o[2][iy]);
+    o[0][iy] = e[0];
+    o[1][iy] = e[1];
+    o[2][iy] = e[2];
+  }
+
+  void applyRight(T* Ez,
+                  int parity)
+  {
+    for (int iy = rowSkip; iy < NY - bskip; iy++)
+      applyRightRow(Ez, iy, parity);
+  }
+
+  void applyRightRow(T* Ez,
+                     int iy,
+                     int parity)
+  {
+    T* const* r = right[parity];
+    T* const* o = right[parity ^ 1];
+    T* e = Ez + index(NX - 1, iy);
+    e[0] = edge(coef[Right], e[-1], e[-2], r[0][iy], r[1][iy], r[2][iy], o[0][iy], o[1][iy], o[2][iy]);
+    o[0][iy] = e[0];
+    o[1][iy] = e[-1];
+    o[2][iy] = e[-2];
+  }
+
+  void applyTop(T* Ez,
+                int parity)
+  {
+    applyTop(Ez, colSkip, NX - bskip, parity);
+  }
+
+  // only the columns in [ix0, ix1) (clipped to the active part of the edge)
+  void applyTop(T* Ez,
+                int ix0,
+                int ix1,
+                int parity)
+  {
+    applyRows(Ez + index(0, NY - 1), Ez + index(0, NY - 2), Ez + index(0, NY - 3), top[parity], top[parity ^ 1], coef[Top], ix0, ix1);
+  }
+
+  void applyBottom(T* Ez,
+                   int parity)
+  {
+    applyBottom(Ez, colSkip, NX - bskip, parity);
+  }
+
+  void applyBottom(T* Ez,
+                   int ix0,
+                   int ix1,
+                   int parity)
+  {
+    applyRows(Ez + index(0, 0), Ez + index(0, 1), Ez + index(0, 2), bottom[parity], bottom[parity ^ 1], coef[Bottom], ix0, ix1);
+  }
+
+  // the top and bottom edges: unit stride in the field rows and in the history, in SIMD batches
+  void applyRows(T* e0,
+                 const T* e1,
+                 const T* e2,
+                 T* const* r,
+                 T* const* o,
+                 const T* c,
+                 int ix0,
+                 int ix1)
+  {
+    if (ix0 < colSkip) ix0 = colSkip;
+    if (ix1 > NX - bskip) ix1 = NX - bskip;
+    const typename V::type c0 = V::set1(c[0]);
+    const typename V::type c1 = V::set1(c[1]);
+    const typename V::type c2 = V::set1(c[2]);
+    int ix = ix0;
+    for (; ix + V::width <= ix1; ix += V::width) {
+      const typename V::type v1 = V::load(e1 + ix);
+      const typename V::type v2 = V::load(e2 + ix);
+      const typename V::type b = V::sub(V::sub(V::add(V::load(r[0] + ix), V::load(r[2] + ix)), v1), V::load(o[1] + ix));
+      const typename V::type a = V::add(V::add(V::mul(c0, V::add(v2, V::load(o[0] + ix))), V::mul(c1, b)), V::mul(c2, V::load(r[1] + ix)));
+      const typename V::type v0 = V::sub(a, V::load(o[2] + ix));
+      V::store(e0 + ix, v0);
+      V::store(o[0] + ix, v0);
+      V::store(o[1] + ix, v1);
+      V::store(o[2] + ix, v2);
+    }
+    for (; ix < ix1; ix++) {
+      e0[ix] = edge(c, e1[ix], e2[ix], r[0][ix], r[1][ix], r[2][ix], o[0][ix], o[1][ix], o[2][ix]);
+      o[0][ix] = e0[ix];
+      o[1][ix] = e1[ix];
+      o[2][ix] = e2[ix];
     }
   }
 
-  void applyBottom(double* Ez,
-                   bool apply = true,
-                   bool record = true)
+};
+
+// Convolutional PML (Roden & Gedney, with kappa = 1): a graded lossy layer of d cells inside
+// each edge, backed by PEC. Only the strips carry state: psi is the recursive convolution of
+// the field difference across the layer and enters the regular update as an extra curl term.
+// Cell k of a strip counts from the wall (k = 0 is the PEC wall for Ez), the same on both sides.
+template <typename T>
+struct fdtdConvolutionalPML
+{
+  static const int grading = 3;   // polynomial order of the conductivity profile
+  static const int maxThickness = 64;
+
+  int NX;
+  int NY;
+  int d;
+
+  // x strips: d * NY each, indexed iy * d + k
+  T* psiEzxLeft;
+  T* psiEzxRight;
+  T* psiHyxLeft;
+  T* psiHyxRight;
+
+  // y strips: d * NX each, indexed k * NX + ix
+  T* psiEzyBottom;
+  T* psiEzyTop;
+  T* psiHxyBottom;
+  T* psiHxyTop;
+
+  // recursion coefficients per strip cell (E at the cell, H half a cell further in)
+  T* aE;
+  T* bE;
+  T* aH;
+  T* bH;
+
+  fdtdArena arena;
+
+  fdtdConvolutionalPML() : NX(0), NY(0), d(0) {}
+
+  // (re)allocate for thickness d and grade the layer for a background medium epr, mur;
+  // delta * courant * vacuum_impedance is sigma * deltat / epsilon0 per unit sigma
+  bool initialize(int nx, 
+                  int ny,
+                  int thickness,
+                  double epr,
+                  double mur,
+                  double delta,
+                  double courant)
   {
-    for (int ix = bskip; ix < NX - bskip; ix++) {
-      if (apply)
-        Ez[index(ix, 0)] = coef0 * (Ez[index(ix, 2)] + EzBottom(0, 1, ix)) + 
-                           coef1 * (EzBottom(0, 0, ix) + EzBottom(2, 0, ix) - Ez[index(ix, 1)] - EzBottom(1, 1, ix)) + 
-                           coef2 * EzBottom(1, 0, ix) - EzBottom(2, 1, ix);
-      if (record)
-        for (int w = 0; w < 3; w++) {
-          ezBottom[indexTB(w, 1, ix)] = EzBottom(w, 0, ix);
-          ezBottom[indexTB(w, 0, ix)] = Ez[index(ix, w)];
-        }
+    const size_t strips = 4 * fdtdArena::footprint<T>(thickness * ny) + 
+                          4 * fdtdArena::footprint<T>(thickness * nx) + 
+                          4 * fdtdArena::footprint<T>(thickness);
+    if (!arena.reserve(strips))
+      return false;
+    NX = nx;
+    NY = ny;
+    d = thickness;
+    psiEzxLeft = arena.allocate<T>(d * NY);
+    psiEzxRight = arena.allocate<T>(d * NY);
+    psiHyxLeft = arena.allocate<T>(d * NY);
+    psiHyxRight = arena.allocate<T>(d * NY);
+    psiEzyBottom = arena.allocate<T>(d * NX);
+    psiEzyTop = arena.allocate<T>(d * NX);
+    psiHxyBottom = arena.allocate<T>(d * NX);
+    psiHxyTop = arena.allocate<T>(d * NX);
+    aE = arena.allocate<T>(d);
+    bE = arena.allocate<T>(d);
+    aH = arena.allocate<T>(d);
+    bH = arena.allocate<T>(d);
+
+    // optimal peak conductivity 0.8 (m + 1) / (eta delta), and a small alpha (0.05 S/m) for low frequencies
+    const double sigmaMax = 0.8 * (grading + 1) * courant / std::sqrt(epr * mur);
+    const double alphaMax = 0.05 * delta * courant * vacuum_impedance / epr;
+    for (int k = 0; k < d; k++) {
+      grade(static_cast<double>(d - k) / d, sigmaMax, alphaMax, aE[k], bE[k]);
+      grade((d - k - 0.5) / d, sigmaMax, alphaMax, aH[k], bH[k]);
     }
+    zero();
+    return true;
+  }
+
+  static void grade(double rho, 
+                    double sigmaMax,
+                    double alphaMax,
+                    T& a,
+                    T& b)
+  {
+    const double sigma = sigmaMax * std::pow(rho, grading);
+    const double alpha = alphaMax * (1.0 - rho);
+    const double bk = std::exp(-(sigma + alpha));
+    b = static_cast<T>(bk);
+    a = static_cast<T>(sigma + alpha > 0.0 ? sigma / (sigma + alpha) * (bk - 1.0) : 0.0);
+  }
+
+  void zeroX() {
+    if (d == 0) return;
+    std::memset(psiEzxLeft, 0, sizeof(T) * d * NY);
+    std::memset(psiEzxRight, 0, sizeof(T) * d * NY);
+    std::memset(psiHyxLeft, 0, sizeof(T) * d * NY);
+    std::memset(psiHyxRight, 0, sizeof(T) * d * NY);
+  }
+
+  void zeroY() {
+    if (d == 0) return;
+    std::memset(psiEzyBottom, 0, sizeof(T) * d * NX);
+    std::memset(psiEzyTop, 0, sizeof(T) * d * NX);
+    std::memset(psiHxyBottom, 0, sizeof(T) * d * NX);
+    std::memset(psiHxyTop, 0, sizeof(T) * d * NX);
+  }
+
+  void zero() {
+    zeroX();
+    zeroY();
+  }
+};
+
+// Update coefficients of one (isotropic) medium, shared by all cells with the same material index
+template <typename T>
+struct fdtdMaterial
+{
+  T chh; // H update: multiplies H
+  T che; // H update: multiplies the difference of E
+  T cee; // E update: multiplies E
+  T ceh; // E update: multiplies the curl of H
+
+  T wE; // energy density weights (epr, mur) in field precision, for the diagnostics
+  T wH;
+
+  double mur;    // relative permeability
+  double epr;    // relative permittivity
+  double sigmam; // magnetic conductivity
+  double sigma;  // electric conductivity
+
+  // courant is the timestep in units of delta / c
+  void set(double mur, 
+           double epr,
+           double sigmam,
+           double sigma,
+           double delta,
+           double courant)
+  {
+    this->mur = mur;
+    this->epr = epr;
+    this->sigmam = sigmam;
+    this->sigma = sigma;
+
+    const double CH = courant / (mur * vacuum_impedance);
+    const double CE = vacuum_impedance * courant / epr;
+
+    const double SH = (sigmam * delta / 2.0) * CH;
+    const double AHh = (1.0 - SH) / (1.0 + SH);
+    const double AHe = 1.0 / (1.0 + SH);
+
+    const double SE = (sigma * delta / 2.0) * CE;
+    const double AEh = 1.0 / (1.0 + SE);
+    const double AEe = (1.0 - SE) / (1.0 + SE);
+
+    chh = static_cast<T>(AHh);
+    che = static_cast<T>(AHe * CH);
+    ceh = static_cast<T>(AEh * CE);
+    cee = static_cast<T>(AEe);
+
+    wE = static_cast<T>(epr);
+    wH = static_cast<T>(mur);
+  }
+
+  bool isVacuum() const {
+    return mur == 1.0 && epr == 1.0 && sigmam == 0.0 && sigma == 0.0;
   }
+};
 
+// Grid reductions gathered by the update sweep when diagnostics are on (fdtdSolver::setDiagnostics()).
+// They describe time level n, the one a step starts from: Ez at n and the H energy from the
+// product of H at n - 1/2 and n + 1/2, which is the discrete energy the lossless scheme conserves
+// (so unlike energyE() + energyB() the total does not oscillate).
+struct fdtdDiagnostics
+{
+  int step;         // n (-1: nothing gathered yet)
+  double energyE;   // [J / m]
+  double energyH;   // [J / m]
+  double minimumEz;
+  double maximumEz;
+  double normEz;    // sqrt of the sum of Ez^2 over the grid
 };
 
-template <int NX, int NY>
+// T is the scalar type of the fields and update coefficients (double or float);
+// grid coordinates, medium parameters and reductions are always double
+template <typename T = double>
 class fdtdSolver
 {
 public:
-  void initialize(double xmin, 
+  static const int minimumGridSize = 16;
+
+  static const int cacheBytesL1 = 32 * 1024;
+  static const int maxTemporalDepth = 32;
+  static const int wavefrontLag = 3; // rows between consecutive steps in a temporal block
+  static const int maxMaterials = 256; // material indices are uint8_t
+  static const int activityTileSize = 32; // nominal; the tiles of a grid are 32 to 63 cells wide
+
+  fdtdSolver() : 
+    NX(0), 
+    NY(0), 
+    materialCount(0),
+    uniformMap(true),
+    medium(PerCellMedium),
+    kernel(fdtdKernelType::Tiled), 
+    stencil(fdtdStencilType::SecondOrder),
+    integrator(fdtdIntegratorType::Leapfrog),
+    courant(courant_factor),
+    tileWidth(defaultTileWidth()),
+    temporalDepth(8),
+    symmetryX(fdtdSymmetryType::NoSymmetry),
+    symmetryY(fdtdSymmetryType::NoSymmetry),
+    cpmlX(false),
+    cpmlY(false),
+    cpmlThickness(12),
+    diagnosticsOn(false),
+    trackActivity(true) {}
+
+  // (re)allocate storage for an nx-by-ny grid and set the default state;
+  // returns false if the dimensions are invalid or the allocation failed
+  bool initialize(int nx, 
+                  int ny,
+                  double xmin, 
                   double ymin, 
                   double delta)
   {
+    if (!allocate(nx, ny))
+      return false;
+
     hbf.init();
 
     for (int ix = 0; ix < NX; ix++) {
@@ -159,30 +486,46 @@ public:
       ygrid[iy] = ymin + iy * delta;
     }
 
+    this->delta = xgrid[1] - xgrid[0];
+    graded = false;
+    prepareSpacing();
+
     setPeriodicX();
     setPeriodicY();
 
     setUniformMedium(1.0, 1.0, 0.0, 0.0);
-    abc.initialize(cezh[0], chye[0]);
+    abc.initialize(materials[0].ceh, materials[0].che);
+    cpmlX = false;
+    cpmlY = false;
+    pml.d = 0;
 
     reset();
 
     source.initDefault();
+    source.setCourant(courant);
+    return true;
   }
 
   void reset() {
     zeroField();
     abc.zero();
+    pml.zero();
     resetUpdateCount();
     source.resetTheta();
+    diagnostics.step = -1;
+    std::memset(activeTile, 0, TX * TY);
+    activeCount = 0;
   }
 
   int getNX() const { return NX; }
   int getNY() const { return NY; }
   int size() const { return NX * NY; }
+  size_t bytesize() const { return arena.bytesize(); }
 
-  double getDelta() const { return xgrid[1] - xgrid[0]; }
-  double getTimestep() const { return (getDelta() * courant_factor / vacuum_velocity); }
+  // the smallest grid spacing (the spacing of a uniform grid); the timestep is set by it
+  double getDelta() const { return delta; }
+  double getTimestep() const { return (getDelta() * courant / vacuum_velocity); }
+  double getCourant() const { return courant; }
   int getUpdateCount() const { return updateCounter; }
   double getUpdateTime() const { return getUpdateCount() * getTimestep(); }
   void resetUpdateCount() { updateCounter = 0; }
@@ -191,63 +534,78 @@ public:
   double getXmax() const { return xgrid[NX - 1]; }
   double getYmin() const { return ygrid[0]; }
   double getYmax() const { return ygrid[NY - 1]; }
+  double getX(int ix) const { return xgrid[ix]; }
+  double getY(int iy) const { return ygrid[iy]; }
+
+  // Graded (rectilinear) mesh: the Ez points are moved to x[0..NX-1], y[0..NY-1], which must be
+  // strictly increasing. Each difference is scaled by getDelta(), the smallest spacing in either
+  // direction, over its own spacing, so the material table is unchanged and the timestep (and the
+  // Courant number) is that of the smallest cell. The Mur edges are tuned for the spacing next to
+  // them. Only the Yee stencil: returns false with the (2,4) one (and setStencil() then keeps Yee).
+  // The coefficients are rescaled and the fields are kept; a uniform x and y turn grading off.
+  bool setGrid(const double* x,
+               const double* y)
+  {
+    if (stencil != fdtdStencilType::SecondOrder)
+      return false;
+    double smallest = x[1] - x[0];
+    for (int ix = 0; ix < NX - 1; ix++) {
+      if (!(x[ix + 1] > x[ix])) return false;
+      if (x[ix + 1] - x[ix] < smallest) smallest = x[ix + 1] - x[ix];
+    }
+    for (int iy = 0; iy < NY - 1; iy++) {
+      if (!(y[iy + 1] > y[iy])) return false;
+      if (y[iy + 1] - y[iy] < smallest) smallest = y[iy + 1] - y[iy];
+    }
+    bool uniform = true;
+    for (int ix = 0; ix < NX - 1; ix++)
+      uniform = uniform && std::fabs(x[ix + 1] - x[ix] - smallest) <= 1.0e-9 * smallest;
+    for (int iy = 0; iy < NY - 1; iy++)
+      uniform = uniform && std::fabs(y[iy + 1] - y[iy] - smallest) <= 1.0e-9 * smallest;
+    std::memcpy(xgrid, x, NX * sizeof(double));
+    std::memcpy(ygrid, y, NY * sizeof(double));
+    graded = !uniform;
+    delta = (graded ? smallest : xgrid[1] - xgrid[0]);
+    prepareSpacing();
+    rescale();
+    setAllActive();
+    return true;
+  }
+
+  bool isGraded() const { return graded; }
 
   bool isPeriodicX() const { return periodicAlongX; }
   bool isPeriodicY() const { return periodicAlongY; }
-  bool isAbsorbingX() const { return absorbingLeft && absorbingRight && !periodicAlongX; }
-  bool isAbsorbingY() const { return absorbingTop && absorbingBottom && !periodicAlongY; }
-  bool isMixedX() const { return (absorbingLeft ^ absorbingRight) && !periodicAlongX;  }
-  bool isMixedY() const { return (absorbingTop ^ absorbingBottom) && !periodicAlongY;  }
+  bool isAbsorbingX() const { return (absorbingLeft || symmetryX != fdtdSymmetryType::NoSymmetry) && absorbingRight && !periodicAlongX; }
+  bool isAbsorbingY() const { return (absorbingBottom || symmetryY != fdtdSymmetryType::NoSymmetry) && absorbingTop && !periodicAlongY; }
+  bool isMixedX() const { return (absorbingLeft ^ absorbingRight) && symmetryX == fdtdSymmetryType::NoSymmetry && !periodicAlongX;  }
+  bool isMixedY() const { return (absorbingTop ^ absorbingBottom) && symmetryY == fdtdSymmetryType::NoSymmetry && !periodicAlongY;  }
 
   void zeroField() {
-    std::memset(Hx, 0, NX * NY * sizeof(double));
-    std::memset(Hy, 0, NX * NY * sizeof(double));
-    std::memset(Ez, 0, NX * NY * sizeof(double));
+    std::memset(Hx, 0, NX * NY * sizeof(T));
+    std::memset(Hy, 0, NX * NY * sizeof(T));
+    std::memset(Ez, 0, NX * NY * sizeof(T));
   }
 
+  // one medium everywhere: material 0 only
   void setUniformMedium(double mur, 
                         double epr,
                         double sigmam,
                         double sigma)
   {
-    relativePermeability = mur; // stash these for energy accounting (TBD)
-    relativePermittivity = epr;
-    magneticConductivity = sigmam;
-    electricConductivity = sigma;
-
-    const double CH = courant_factor / (mur * vacuum_impedance);
-    const double CE = vacuum_impedance * courant_factor / epr;
-
-    const double SH = (sigmam * getDelta() / 2.0) * CH;
-    const double AHh = (1.0 - SH) / (1.0 + SH);
-    const double AHe = 1.0 / (1.0 + SH);
-
-    const double SE = (sigma * getDelta() / 2.0) * CE;
-    const double AEh = 1.0 / (1.0 + SE);
-    const double AEe = (1.0 - SE) / (1.0 + SE);
-
-    for (int ix = 0; ix < NX; ix++) {
-      for (int iy = 0; iy < NY; iy++) {
-        const int idx = index(ix, iy);
-
-        chxh[idx] = AHh;
-        chxe[idx] = AHe * CH;
-
-        chyh[idx] = AHh;
-        chye[idx] = AHe * CH;
-
-        cezh[idx] = AEh * CE;
-        ceze[idx] = AEe;
-      }
-    }
+    materials[0].set(mur, epr, sigmam, sigma, getDelta(), courant);
+    materialCount = 1;
+    std::memset(material, 0, NX * NY * sizeof(uint8_t));
+    uniformMap = true;
+    updateMediumType();
   }
 
+  // damping applies to the background medium (material 0); painted materials are kept
   void setDamping(double lhat) {
-    const double sigma_delta = source.sigmaDelta(lhat, relativePermeability);
-    setUniformMedium(relativePermeability,
-                     relativePermittivity,
-                     magneticConductivity,
-                     sigma_delta / getDelta());
+    fdtdMaterial<T>& m = materials[0];
+    const double sigma_delta = source.sigmaDelta(lhat, m.mur);
+    m.set(m.mur, m.epr, m.sigmam, sigma_delta / getDelta(), getDelta(), courant);
+    updateMediumType();
   }
 
   void setVacuum() {
@@ -255,12 +613,50 @@ public:
   }
 
   bool isVacuum() const {
-    return relativePermeability == 1.0 && 
-           relativePermittivity == 1.0 &&
-           magneticConductivity == 0.0 &&
-           electricConductivity == 0.0;
+    return materialCount == 1 && materials[0].isVacuum();
+  }
+
+  // Add a medium to the coefficient table; returns its index or -1 if the table is full
+  int defineMaterial(double mur, 
+                     double epr,
+                     double sigmam,
+                     double sigma)
+  {
+    if (materialCount >= maxMaterials)
+      return -1;
+    materials[materialCount].set(mur, epr, sigmam, sigma, getDelta(), courant);
+    return materialCount++;
+  }
+
+  // Assign material id to the cells of the rectangle [ix0, ix1) x [iy0, iy1) (clipped to the grid)
+  void paintMaterial(int id,
+                     int ix0, 
+                     int iy0,
+                     int ix1, 
+                     int iy1)
+  {
+    if (id < 0 || id >= materialCount)
+      return;
+    if (ix0 < 0) ix0 = 0;
+    if (iy0 < 0) iy0 = 0;
+    if (ix1 > NX) ix1 = NX;
+    if (iy1 > NY) iy1 = NY;
+    for (int iy = iy0; iy < iy1; iy++) {
+      for (int ix = ix0; ix < ix1; ix++) {
+        material[index(ix, iy)] = static_cast<uint8_t>(id);
+      }
+    }
+    if (id != 0 && ix0 < ix1 && iy0 < iy1) {
+      uniformMap = false;
+      updateMediumType();
+    }
   }
 
+  int getMaterialCount() const { return materialCount; }
+  const fdtdMaterial<T>& getMaterialProperties(int id) const { return materials[id]; }
+  int getMaterial(int ix, int iy) const { return material[index(ix, iy)]; }
+  fdtdMediumType getMediumType() const { return medium; }
+
   // add Gaussian centered at (xc, yc) onto the Ez field (units are points)
   void superimposeGaussian(double xc, 
                            double yc, 
@@ -272,59 +668,323 @@ public:
         const int idx = index(ix, iy);
         const double xhat = ((double) ix - xc) / sigmax;
         const double yhat = ((double) iy - yc) / sigmay;
-        Ez[idx] += std::exp(-0.5 * (xhat * xhat + yhat * yhat));
+        Ez[idx] += static_cast<T>(std::exp(-0.5 * (xhat * xhat + yhat * yhat)));
       }
     }
+    setAllActive();
   }
 
   double energyE() const {
+    if (graded)
+      return energyGraded(Ez, 0, 0);
     double sum = 0.0;
-    for (int i = 0; i < size(); i++) {
-      const double Ezi = Ez[i];
-      sum += Ezi * Ezi;
+    if (materialCount == 1) {
+      for (int i = 0; i < size(); i++) {
+        const double Ezi = Ez[i];
+        sum += Ezi * Ezi;
+      }
+      sum *= materials[0].epr;
+    } else {
+      for (int i = 0; i < size(); i++) {
+        const double Ezi = Ez[i];
+        sum += materials[material[i]].epr * Ezi * Ezi;
+      }
     }
     const double delta = getDelta();
-    return relativePermittivity * vacuum_permittivity * (sum * delta * delta / 2.0);
+    return vacuum_permittivity * (sum * delta * delta / 2.0);
   }
 
   // NOTE: not actually synchronized in time with the E-field energy calc above
+  // (H is half a step behind; getDiagnostics() has the synchronized energy)
   double energyB() const {
+    if (graded)
+      return energyGraded(Hx, 0, 1) + energyGraded(Hy, 1, 0);
     double sum = 0.0;
     for (int i = 0; i < size(); i++) {
       const double Hxi = Hx[i];
       const double Hyi = Hy[i];
-      sum += Hxi * Hxi + Hyi * Hyi;
+      sum += (Hxi * Hxi + Hyi * Hyi) * (materialCount == 1 ? 1.0 : materials[material[i]].mur);
     }
     const double delta = getDelta();
-    return relativePermeability * vacuum_permeability * (sum * delta * delta / 2.0);
+    return (materialCount == 1 ? materials[0].mur : 1.0) * vacuum_permeability * (sum * delta * delta / 2.0);
   }
   
   void update()  /* full single timestep state update */
   {
-    updateHxHy();
-    updateEz();
+    if (integrator == fdtdIntegratorType::FourthOrderInTime) {
+      updateFourthOrderInTime();
+      return;
+    }
 
-    if (periodicAlongX) {
-      makeEzPeriodicX();
-    } else {
-      if (absorbingLeft) abc.applyLeft(Ez);
-      if (absorbingRight) abc.applyRight(Ez);
+    if (isTracking()) {
+      updateActive();
+      return;
     }
+    setAllActive();
 
-    if (periodicAlongY) {
-      makeEzPeriodicY();
+    if (canRunParallel()) {
+      advanceParallel(1);
+      return;
+    }
+
+    // one sweep that also does the edges of each row (and of the y edges per strip) while in cache
+    if (canBlockInTime()) {
+      advanceBlock(1);
+      return;
+    }
+
+    if (kernel == fdtdKernelType::Tiled) {
+      if (stencil == fdtdStencilType::FourthOrder)
+        updateWide();
+      else
+        updateTiled();
+      if (diagnosticsOn) finishDiagnostics(sums, updateCounter);
     } else {
-      if (absorbingTop) abc.applyTop(Ez);
-      if (absorbingBottom) abc.applyBottom(Ez);
+      updateHxHy();
+      if (cpmlX || cpmlY)
+        for (int iy = 0; iy < NY; iy++) updateHxHyRowPML(iy, 0, NX);
+      updateEz();
+      if (cpmlX || cpmlY)
+        for (int iy = 1; iy < NY - 1; iy++) updateEzRowPML(iy, 0, NX);
     }
 
+    updateBoundaryEz();
     applySource();
 
     source.updateTheta();
     updateCounter++;
   }
 
+  // nsteps calls to update(), but with temporal blocking where the boundary
+  // conditions allow it (see advanceBlock()); the result is bit-identical
+  void advance(int nsteps) {
+    if (integrator == fdtdIntegratorType::FourthOrderInTime) {
+      for (int n = 0; n < nsteps; n++) updateFourthOrderInTime();
+      return;
+    }
+    for (; nsteps > 0 && isTracking(); nsteps--) update();
+    if (nsteps == 0)
+      return;
+    setAllActive();
+    if (canRunParallel()) {
+      advanceParallel(nsteps);
+      return;
+    }
+    if (!canBlockInTime() || temporalDepth < 2) {
+      for (int n = 0; n < nsteps; n++) update();
+      return;
+    }
+    while (nsteps > 0) {
+      const int nb = (nsteps < temporalDepth ? nsteps : temporalDepth);
+      advanceBlock(nb);
+      nsteps -= nb;
+    }
+  }
+
+  // A timestep in pieces, for drivers that split the grid into row ranges (threads, subdomains).
+  // update() is the same as: updateHRows(0, NY); updateERows(0, NY); updateEdgeBottom();
+  // updateEdgeTop(); applySourceRows(0, NY); finishSteps(1) (with periodic y handled by the driver).
+  void updateHRows(int r0, 
+                   int r1) 
+  {
+    for (int iy = r0; iy < r1; iy++)
+      updateHxHyRow(iy, 0, NX);
+  }
+
+  // E and the x edges of the rows in [r0, r1); the first and last rows of the grid are skipped
+  void updateERows(int r0, 
+                   int r1) 
+  {
+    if (r0 < 1) r0 = 1;
+    if (r1 > NY - 1) r1 = NY - 1;
+    for (int iy = r0; iy < r1; iy++) {
+      updateEzRow(iy, 0, NX);
+      if (periodicAlongX) {
+        makeEzPeriodicXRow(iy);
+      } else {
+        if (symmetryX == fdtdSymmetryType::EvenSymmetry) makeEzMirrorXRow(iy);
+        if (iy >= abc.rowSkip && iy < NY - abc.bskip) {
+          if (absorbingLeft) abc.applyLeftRow(Ez, iy, updateCounter & 1);
+          if (absorbingRight) abc.applyRightRow(Ez, iy, updateCounter & 1);
+        }
+      }
+    }
+  }
+
+  // E of row iy (no x edges) with the Hx rows above and below given explicitly (periodic y seams)
+  void updateEzRowWith(int iy, 
+                       const T* hx, 
+                       const T* hxs) 
+  {
+    const int row = index(0, iy);
+    kernelEzRow<PerCellMedium, false, false, false>(Ez + row, material + row, materials, hx, hxs, nullptr, nullptr, Hy + row, 1, NX - 1, nullptr);
+    if (symmetryX == fdtdSymmetryType::EvenSymmetry)
+      updateEzEdgeNode(0, iy, (Hy[row] + Hy[row]) * gxH[0], (hx[0] - hxs[0]) * gyE[iy]);
+    if (periodicAlongX)
+      makeEzPeriodicCorners(row, row, hx, hxs);
+  }
+
+  // E of the node (ix, iy) with the Hy left of it and the Hx below it given explicitly
+  // (Bloch seams, where those are the ones a period away times a phase factor)
+  void updateEzNodeWith(int ix,
+                        int iy,
+                        T hyLeft,
+                        T hxBelow)
+  {
+    const int i = index(ix, iy);
+    updateEzEdgeNode(ix, iy, (Hy[i] - hyLeft) * gxE[ix], (Hx[i] - hxBelow) * gyE[iy]);
+  }
+
+  void updateEdgeBottom() {
+    if (symmetryY == fdtdSymmetryType::EvenSymmetry) {
+      makeEzMirrorY(0, NX);
+      if (absorbingLeft) abc.applyLeftRow(Ez, 0, updateCounter & 1);
+      if (absorbingRight) abc.applyRightRow(Ez, 0, updateCounter & 1);
+    }
+    if (absorbingBottom && !periodicAlongY) abc.applyBottom(Ez, updateCounter & 1);
+  }
+  void updateEdgeTop() { if (absorbingTop && !periodicAlongY) abc.applyTop(Ez, updateCounter & 1); }
+
+  // inject the source if it sits in the rows [r0, r1)
+  void applySourceRows(int r0, 
+                       int r1) 
+  {
+    const int idx = sourceIndex();
+    if (idx < 0 || idx / NX < r0 || idx / NX >= r1)
+      return;
+    injectSource(idx, source.get(updateCounter));
+  }
+
+  // the cell update() injects the source into (-1: none) and the value it injects there in this
+  // step, or a fraction of a step later (for drivers that take a step in substeps)
+  int sourceCell() const { return sourceIndex(); }
+  double sourceValue(double fraction) const { return source.get(updateCounter, fraction); }
+
+  void finishSteps(int n) {
+    for (int k = 0; k < n; k++) source.updateTheta();
+    updateCounter += n;
+    setAllActive();
+  }
+
+  // y edge flags of a subdomain (an edge that is neither is left alone: a halo or PEC);
+  // unlike setAbsorbingY() the fields are not tapered
+  void setEdgesY(bool absorbBottom, 
+                 bool absorbTop) 
+  {
+    periodicAlongY = false;
+    cpmlY = false;
+    absorbingBottom = absorbBottom;
+    absorbingTop = absorbTop;
+    abc.zeroY();
+  }
+
+  // (writable, so the activity tracking gives up on these fields)
+  T* rowEz(int iy) { setAllActive(); return Ez + index(0, iy); }
+  T* rowHx(int iy) { setAllActive(); return Hx + index(0, iy); }
+  T* rowHy(int iy) { setAllActive(); return Hy + index(0, iy); }
+
+  // number of timesteps per temporal block (1 disables blocking)
+  void setTemporalDepth(int d) { temporalDepth = (d < 1 ? 1 : (d > maxTemporalDepth ? maxTemporalDepth : d)); }
+  int getTemporalDepth() const { return temporalDepth; }
+
+  // number of threads for update() and advance() with the tiled kernel (1: no worker threads);
+  // returns the actual count, which is always 1 unless built with FDTD_THREADS
+  int setThreads(int n) { return pool.start(n); }
+  int getThreads() const { return pool.size(); }
+
+  // both kernel types produce bit-identical fields
+  void setKernel(fdtdKernelType k) { kernel = k; }
+  fdtdKernelType getKernel() const { return kernel; }
+
+  // The (2,4) stencil is for running at about half the resolution of Yee. Its spatial error is
+  // fourth order, so what is left is mostly the second order time error of the leapfrog, and it
+  // steps at Courant number 0.3 (the limit is 0.606) to keep that small: at 10 points per
+  // wavelength the frequency error is then 4e-4 along an axis and 1.1e-3 along the diagonal,
+  // against 2.0e-3 for Yee at 20 points along an axis (the stencil test; Yee at its own limit is
+  // nearly exact along the diagonal). A step costs about 1.5 times a Yee step per cell, so the same
+  // accuracy takes roughly 0.4 of the work. At Courant number 0.6 (setCourant()) the error at 10
+  // points per wavelength is 5e-3 instead, worse than Yee at 20. The cells next to the edges, the
+  // periodic seams and the CPML layers keep the Yee stencil. Switching rescales
+  // the medium, boundary and source coefficients and keeps the fields. With the (2,4) stencil the
+  // steps are neither blocked in time nor activity tracked, and fdtdDomain refuses to step it.
+  // A graded mesh (setGrid()) and the fourth order time integrator stay with the Yee stencil.
+  // The Courant number goes back to the default of the stencil.
+  void setStencil(fdtdStencilType s) {
+    if ((graded || integrator != fdtdIntegratorType::Leapfrog) && s != fdtdStencilType::SecondOrder)
+      return;
+    stencil = s;
+    courant = (s == fdtdStencilType::FourthOrder ? courant_factor_24 : courant_factor);
+    rescale();
+  }
+
+  fdtdStencilType getStencil() const { return stencil; }
+
+  // The timestep is courant * getDelta() / c. Any Courant number up to getStabilityLimit() is
+  // accepted (returns false otherwise); the medium, boundary and source coefficients are rescaled
+  // and the fields kept. The limit holds for media with epr, mur >= 1, and on a graded mesh it is
+  // relative to the smallest spacing (so it errs on the safe side).
+  bool setCourant(double c) {
+    if (!(c > 0.0 && c <= getStabilityLimit()))
+      return false;
+    courant = c;
+    rescale();
+    return true;
+  }
+
+  double getStabilityLimit() const {
+    if (integrator == fdtdIntegratorType::FourthOrderInTime)
+      return courant_limit_t4;
+    return (stencil == fdtdStencilType::FourthOrder ? courant_limit_24 : courant_limit);
+  }
+
+  // The fourth order integrator replaces E by E + (dt^2 / 24) d^2E/dt^2 in the H update, and H
+  // likewise in the E update, with the second derivatives from the leapfrog operators themselves
+  // (as in Fang's (4,4) scheme, here with the Yee stencil). The time error falls as dt^4, and the
+  // Courant number can go up to 2.013 (instead of 1/sqrt(2)): a mode with L = dt^2 w^2 of the
+  // leapfrog (up to 8 S^2) steps as one with L (1 - L / 24)^2, which stays below 4 while L < 32.43.
+  // Above S = sqrt(3) the modes near the grid Nyquist then oscillate slower, down to standing
+  // still, which is harmless for a well resolved run. The leapfrog energy of fdtdDiagnostics is
+  // conserved exactly. The longer step does not make a run cheaper: a step is six full grid
+  // sweeps, five to seven times a (fused, tiled, blocked) leapfrog step, so at S = 1.5 the same
+  // simulated time takes two to three and a half times the work (the accuracy test prints it).
+  // What it buys is the time error, some eighty times smaller at 20 points per wavelength. In
+  // lossy media the loss terms are left out of the correction, which then is only second order
+  // there. Needs the Yee stencil and PEC or periodic edges (returns false otherwise), three more
+  // grid arrays, and is full grid and single threaded, without fused diagnostics.
+  // Switching on Mur or CPML edges goes back to the leapfrog. Back on the leapfrog, a Courant
+  // number above its limit is lowered to the default.
+  bool setIntegrator(fdtdIntegratorType t) {
+    if (t == fdtdIntegratorType::FourthOrderInTime) {
+      if (stencil != fdtdStencilType::SecondOrder || absorbingLeft || absorbingRight || absorbingTop || absorbingBottom || cpmlX || cpmlY)
+        return false;
+      const size_t cells = static_cast<size_t>(NX) * NY;
+      if (!scratchArena.reserve(3 * fdtdArena::footprint<T>(cells)))
+        return false;
+      for (int k = 0; k < 3; k++)
+        scratch[k] = scratchArena.allocate<T>(cells);
+      integrator = t;
+      diagnostics.step = -1;
+      return true;
+    }
+    integrator = t;
+    if (courant > getStabilityLimit())
+      setCourant(courant_factor);
+    return true;
+  }
+
+  fdtdIntegratorType getIntegrator() const { return integrator; }
+
+  // column strip width (in cells) of the tiled kernel; the default keeps
+  // the few rows of Ez, Hx, Hy that are reused between rows inside L1
+  void setTileWidth(int w) { tileWidth = (w < 8 ? 8 : w); }
+  int getTileWidth() const { return tileWidth; }
+
+  const T* dataEz() const { return Ez; }
+  const T* dataHx() const { return Hx; }
+  const T* dataHy() const { return Hy; }
+
   void halfbandFilterXY() {
+    setAllActive();
     halfbandFilterXY_(Ez);
     halfbandFilterXY_(Hx);
     halfbandFilterXY_(Hy);
@@ -337,6 +997,9 @@ public:
   }
 
   void setPeriodicX() {
+    symmetryX = fdtdSymmetryType::NoSymmetry;
+    abc.mirrorCorners(symmetryX == fdtdSymmetryType::EvenSymmetry, symmetryY == fdtdSymmetryType::EvenSymmetry);
+    cpmlX = false;
     absorbingLeft = false;
     absorbingRight = false;
     periodicAlongX = true;
@@ -345,6 +1008,9 @@ public:
   }
 
   void setPeriodicY() {
+    symmetryY = fdtdSymmetryType::NoSymmetry;
+    abc.mirrorCorners(symmetryX == fdtdSymmetryType::EvenSymmetry, symmetryY == fdtdSymmetryType::EvenSymmetry);
+    cpmlY = false;
     absorbingTop = false;
     absorbingBottom = false;
     periodicAlongY = true;
@@ -354,7 +1020,9 @@ public:
 
   void setAbsorbingX() {
     const int taper = 12;
-    absorbingLeft = true;
+    setIntegrator(fdtdIntegratorType::Leapfrog);
+    cpmlX = false;
+    absorbingLeft = (symmetryX == fdtdSymmetryType::NoSymmetry);
     absorbingRight = true;
     periodicAlongX = false;
     abc.zeroX();
@@ -367,8 +1035,10 @@ public:
 
   void setAbsorbingY() {
     const int taper = 12;
+    setIntegrator(fdtdIntegratorType::Leapfrog);
+    cpmlY = false;
     absorbingTop = true;
-    absorbingBottom = true;
+    absorbingBottom = (symmetryY == fdtdSymmetryType::NoSymmetry);
     periodicAlongY = false;
     abc.zeroY();
     taperBorderY(taper);
@@ -379,6 +1049,7 @@ public:
   }
 
   void setPECX() {
+    cpmlX = false;
     absorbingLeft = false;
     absorbingRight = false;
     periodicAlongX = false;
@@ -386,12 +1057,107 @@ public:
   }
 
   void setPECY() {
+    cpmlY = false;
     absorbingTop = false;
     absorbingBottom = false;
     periodicAlongY = false;
     zeroBoundaryEzY();
   }
 
+  // Convolutional PML of getCPMLThickness() cells inside the x (y) edges, backed by PEC;
+  // graded for the background medium (material 0) at the time it is switched on
+  bool setCPMLX() {
+    setIntegrator(fdtdIntegratorType::Leapfrog);
+    if (!(cpmlY && pml.d == usableCPMLThickness()) && !preparePML())
+      return false;
+    setPECX();
+    cpmlX = true;
+    pml.zeroX();
+    return true;
+  }
+
+  bool setCPMLY() {
+    setIntegrator(fdtdIntegratorType::Leapfrog);
+    if (!(cpmlX && pml.d == usableCPMLThickness()) && !preparePML())
+      return false;
+    setPECY();
+    cpmlY = true;
+    pml.zeroY();
+    return true;
+  }
+
+  bool isCPMLX() const { return cpmlX; }
+  bool isCPMLY() const { return cpmlY; }
+
+  // Symmetry plane at the left edge (x = getXmin()): the grid is the half x >= xmin of a domain
+  // that is mirror symmetric about the plane, with the fields of the given parity (so a quarter
+  // with setSymmetryY() too). On an even (PMC) plane the Ez nodes of the edge are updated with the
+  // H across it mirrored; an odd (PEC) plane keeps them at zero. The right edge keeps its type
+  // (periodic becomes PEC), and setAbsorbingX(), setCPMLX() and setPECX() then only set that edge;
+  // setPeriodicX() (or NoSymmetry) removes the plane. rasterizeEz() unfolds the mirror image.
+  bool setSymmetryX(fdtdSymmetryType s) {
+    symmetryX = s;
+    abc.mirrorCorners(symmetryX == fdtdSymmetryType::EvenSymmetry, symmetryY == fdtdSymmetryType::EvenSymmetry);
+    if (cpmlX)
+      return setCPMLX();
+    if (absorbingRight && !periodicAlongX)
+      setAbsorbingX();
+    else
+      setPECX();
+    return true;
+  }
+
+  bool setSymmetryY(fdtdSymmetryType s) {
+    symmetryY = s;
+    abc.mirrorCorners(symmetryX == fdtdSymmetryType::EvenSymmetry, symmetryY == fdtdSymmetryType::EvenSymmetry);
+    if (cpmlY)
+      return setCPMLY();
+    if (absorbingTop && !periodicAlongY)
+      setAbsorbingY();
+    else
+      setPECY();
+    return true;
+  }
+
+  fdtdSymmetryType getSymmetryX() const { return symmetryX; }
+  fdtdSymmetryType getSymmetryY() const { return symmetryY; }
+
+  // lower corner of the whole (unfolded) domain; the grid is its upper part with symmetry planes
+  double getImageXmin() const { return (symmetryX == fdtdSymmetryType::NoSymmetry ? getXmin() : 2.0 * getXmin() - getXmax()); }
+  double getImageYmin() const { return (symmetryY == fdtdSymmetryType::NoSymmetry ? getYmin() : 2.0 * getYmin() - getYmax()); }
+
+  // layer thickness in cells (clamped to [2, maxThickness], and to a third of the grid when used);
+  // takes effect the next time setCPMLX() or setCPMLY() is called
+  void setCPMLThickness(int d) { 
+    if (d > fdtdConvolutionalPML<T>::maxThickness) d = fdtdConvolutionalPML<T>::maxThickness;
+    cpmlThickness = (d < 2 ? 2 : d);
+  }
+  int getCPMLThickness() const { return cpmlThickness; }
+
+  // While on, the H kernels of the tiled sweeps (update(), advance(), threads) also reduce the
+  // values they have loaded into an fdtdDiagnostics of the last step taken, so the energy and
+  // the range of Ez cost no extra pass over the grid. Not gathered by the Reference kernel.
+  // Inside a CPML layer the H energy uses H before the (small) CPML correction of the step.
+  void setDiagnostics(bool on) { 
+    diagnosticsOn = on; 
+    diagnostics.step = -1;
+  }
+  bool isDiagnostics() const { return diagnosticsOn; }
+  const fdtdDiagnostics& getDiagnostics() const { return diagnostics; }
+
+  // Activity tracking: starting from zero fields (reset()), update() and advance() with the tiled
+  // kernel only touch the tiles that hold non-zero field or can get some within the step (next to
+  // such a tile, or holding the source), so early steps cost in proportion to the excited area.
+  // The fields are bit-identical. Tracking ends once all tiles are active, and whenever the fields
+  // are changed in other ways (threads and subdomains also take the full grid).
+  void setActivityTracking(bool on) { trackActivity = on; }
+  bool isActivityTracking() const { return trackActivity; }
+
+  // fraction of the tiles that are updated (1 unless tracking is still in effect)
+  double getActiveFraction() const {
+    return (activeCount >= TX * TY ? 1.0 : static_cast<double>(activeCount) / (TX * TY));
+  }
+
   double minimumEz() const {
     double val = Ez[0];
     for (int i = 1; i < size(); i++) {
@@ -410,6 +1176,7 @@ public:
 
   // (xmin, ymin) : lower left corner (0, h - 1)
   // (xmax, ymax) : upper right corner (w - 1, 0)
+  // with symmetry planes the window may reach down to getImageXmin(), getImageYmin()
   void rasterizeEz(uint32_t* imgdata, 
                    int w, 
                    int h,
@@ -439,15 +1206,57 @@ public:
     const double Y0 = (ymax - ygmin) / delta;
     const double Y1 = -1.0 * yupp / delta;
 
+    // points beyond a symmetry plane show the mirror image (with the sign flipped when odd)
+    const bool mirrorX = (symmetryX != fdtdSymmetryType::NoSymmetry);
+    const bool mirrorY = (symmetryY != fdtdSymmetryType::NoSymmetry);
+    const float signX = (symmetryX == fdtdSymmetryType::OddSymmetry ? -1.0f : 1.0f);
+    const float signY = (symmetryY == fdtdSymmetryType::OddSymmetry ? -1.0f : 1.0f);
+
+    // a graded mesh is sampled at the physical coordinates of the pixels
+    if (graded) {
+      for (int i = 0; i < w; i++) {
+        double x = xmin + i * xupp;
+        float fx = 1.0f;
+        if (mirrorX && x < xgmin) {
+          x = 2.0 * xgmin - x;
+          fx = signX;
+        }
+        double etax;
+        const int xi = gridPoint(xgrid, NX, x, etax);
+        for (int j = 0; j < h; j++) {
+          double y = ymax - j * yupp;
+          float f = fx;
+          if (mirrorY && y < ygmin) {
+            y = 2.0 * ygmin - y;
+            f *= signY;
+          }
+          double etay;
+          const int yi = gridPoint(ygrid, NY, y, etay);
+          imgdata[i + j * w] = (*rgbfunc)(A * (f * interpolate_float(Ez, xi, yi, (float) etax, (float) etay)) + B);
+        }
+      }
+      return;
+    }
+
     for (int i = 0; i < w; i++) {
       const double xi = xmin + i * xupp;
-      const double xhati = (xi - xgmin) / delta;
+      double xhati = (xi - xgmin) / delta;
+      float fx = 1.0f;
+      if (mirrorX && xhati < 0.0) {
+        xhati = -xhati;
+        fx = signX;
+      }
       for (int j = 0; j < h; j++) {
         //const double yj = ymax - j * yupp;
         //const double yhatj = (yj - ygmin) / delta;
         //const double Ezij = interpolate(Ez, xhati, yhatj);
-        const double yhatj = Y0 + Y1 * j;
-        const float Ezij = interpolate_float(Ez, (float) xhati, (float) yhatj);
+        double yhatj = Y0 + Y1 * j;
+        float f = fx;
+        if (mirrorY && yhatj < 0.0) {
+          yhatj = -yhatj;
+          f *= signY;
+        }
+        const float Ezij = f * interpolate_float(Ez, (float) xhati, (float) yhatj);
         imgdata[i + j * w] = (*rgbfunc)(A * Ezij + B);
       }
     }
@@ -499,7 +1308,7 @@ public:
     return source.amp;
   }
 
-  double sourceAmplitude(double a) {
+  void sourceAmplitude(double a) {
     source.amp = a;
   }
 
@@ -512,37 +1321,53 @@ public:
   }
 
 private:
-  double xgrid[NX];
-  double ygrid[NY];
+  int NX;
+  int NY;
+
+  fdtdArena arena;
+
+  double* xgrid; // NX
+  double* ygrid; // NY
+
+  // Graded mesh (setGrid()): delta is the smallest spacing, and a difference is scaled by delta
+  // over its own spacing: gxH for Hy (x spacing), gxE for Ez (dual x width), gyH for Hx, gyE for Ez.
+  // wxH, wxE are the x widths of the Hy and of the Ez (and Hx) cells over delta, for the diagnostics.
+  // All are 1 on a uniform grid.
+  bool graded;
+  double delta;
+  T* gxH; // NX
+  T* gxE;
+  T* wxH;
+  T* wxE;
+  T* gyH; // NY
+  T* gyE;
 
   // Grid points (as-is) are for the Ez field
   // The grid for Hx is staggered by half deltay
   // The grid for Hy is staggered by half deltax
 
-  double Hx[NX * NY]; // at t - 0.5 * deltat
-  double Hy[NX * NY]; // at t - 0.5 * deltat
-  double Ez[NX * NY]; // at t
+  T* Hx; // at t - 0.5 * deltat
+  T* Hy; // at t - 0.5 * deltat
+  T* Ez; // at t
 
-  double Y[NX + NY]; // can be used for temporary filter results
+  T* Y; // NX + NY; can be used for temporary filter results
 
-  // uniform medium (set properties)
-  double relativePermittivity;
-  double relativePermeability;
-  double electricConductivity;
-  double magneticConductivity;
-
-  // update coefficient arrays
-  double chxh[NX * NY];
-  double chxe[NX * NY];
-
-  double chyh[NX * NY];
-  double chye[NX * NY];
-
-  double ceze[NX * NY];
-  double cezh[NX * NY];
+  // per-cell material index (NX * NY) into a small table of update coefficients
+  uint8_t* material;
+  fdtdMaterial<T> materials[maxMaterials];
+  int materialCount;
+  bool uniformMap; // every cell is material 0
+  fdtdMediumType medium;
 
   int updateCounter;
 
+  fdtdKernelType kernel;
+  fdtdStencilType stencil;
+  fdtdIntegratorType integrator;
+  double courant;
+  int tileWidth;
+  int temporalDepth;
+
   bool periodicAlongX;
   bool periodicAlongY;
 
@@ -551,7 +1376,31 @@ private:
   bool absorbingTop;
   bool absorbingBottom;
 
-  fdtdAbsorbingBoundary<NX, NY> abc;
+  fdtdSymmetryType symmetryX;
+  fdtdSymmetryType symmetryY;
+
+  fdtdAbsorbingBoundary<T> abc;
+
+  bool cpmlX;
+  bool cpmlY;
+  int cpmlThickness;
+  fdtdConvolutionalPML<T> pml;
+
+  bool diagnosticsOn;
+  fdtdDiagnostics diagnostics;
+
+  // activity tiles: TX by TY, tile (tx, ty) is columns [tileX(tx), tileX(tx + 1)) and similarly in y
+  bool trackActivity;
+  int TX;
+  int TY;
+  uint8_t* activeTile;
+  int activeCount; // TX * TY once tracking has ended
+
+  fdtdThreadPool pool;
+
+  // the corrected fields and the work arrays of the fourth order integrator (NX * NY each)
+  fdtdArena scratchArena;
+  T* scratch[3];
 
   fdtdSource source;
 
@@ -561,45 +1410,248 @@ private:
     return NX * iy + ix;
   }
 
+  // all grid arrays are carved out of one aligned arena block
+  bool allocate(int nx, 
+                int ny)
+  {
+    if (nx < minimumGridSize || ny < minimumGridSize)
+      return false;
+
+    const size_t cells = static_cast<size_t>(nx) * ny;
+    const int tx = (nx / activityTileSize > 0 ? nx / activityTileSize : 1);
+    const int ty = (ny / activityTileSize > 0 ? ny / activityTileSize : 1);
+    const size_t bytes = fdtdArena::footprint<double>(nx) +
+                         fdtdArena::footprint<double>(ny) +
+                         fdtdArena::footprint<T>(nx + ny) +
+                         4 * fdtdArena::footprint<T>(nx) +
+                         2 * fdtdArena::footprint<T>(ny) +
+                         3 * fdtdArena::footprint<T>(cells) +
+                         fdtdArena::footprint<uint8_t>(cells) +
+                         fdtdArena::footprint<uint8_t>(tx * ty) +
+                         fdtdAbsorbingBoundary<T>::footprint(nx, ny);
+
+    NX = 0;
+    NY = 0;
+    if (!arena.reserve(bytes))
+      return false;
+
+    xgrid = arena.allocate<double>(nx);
+    ygrid = arena.allocate<double>(ny);
+    Y = arena.allocate<T>(nx + ny);
+    gxH = arena.allocate<T>(nx);
+    gxE = arena.allocate<T>(nx);
+    wxH = arena.allocate<T>(nx);
+    wxE = arena.allocate<T>(nx);
+    gyH = arena.allocate<T>(ny);
+    gyE = arena.allocate<T>(ny);
+
+    Hx = arena.allocate<T>(cells);
+    Hy = arena.allocate<T>(cells);
+    Ez = arena.allocate<T>(cells);
+
+    material = arena.allocate<uint8_t>(cells);
+
+    TX = tx;
+    TY = ty;
+    activeTile = arena.allocate<uint8_t>(tx * ty);
+    activeCount = 0;
+
+    if (!abc.allocate(arena, nx, ny))
+      return false;
+
+    NX = nx;
+    NY = ny;
+    return true;
+  }
+
   int integerx(double x) const {
+    if (graded) return nearestPoint(xgrid, NX, x);
     return (int) std::round((x - getXmin()) / getDelta());
   }
 
   int integery(double y) const {
+    if (graded) return nearestPoint(ygrid, NY, y);
     return (int) std::round((y - getYmin()) / getDelta());
   }
 
-  double interpolate(const double* f,
-                     double xhat, 
-                     double yhat) const
+  // spacing between the grid points i and i + 1, and the width of the dual cell around point i
+  // (at the first and last points the one across the periodic seam)
+  static double spacing(const double* g, 
+                        int i) 
   {
-    const int xi = (int) xhat;
-    const int yi = (int) yhat;
-    const double etax = xhat - xi;
-    const double etay = yhat - yi;
+    return g[i + 1] - g[i];
+  }
 
-    const double v00 = f[index(xi, yi)];
-    const double v01 = f[index(xi, yi + 1)];
-    const double v10 = f[index(xi + 1, yi)];
-    const double v11 = f[index(xi + 1, yi + 1)];
+  static double dualSpacing(const double* g, 
+                            int n, 
+                            int i)
+  {
+    if (i == 0 || i == n - 1)
+      return 0.5 * (spacing(g, 0) + spacing(g, n - 2));
+    return 0.5 * (g[i + 1] - g[i - 1]);
+  }
 
-    const double w00 = (1.0 - etax) * (1.0 - etay);
-    const double w01 = (1.0 - etax) * etay;
+  // the k with g[k] <= v < g[k + 1], clamped to [0, n - 2]
+  static int gridInterval(const double* g, 
+                          int n, 
+                          double v)
+  {
+    int lo = 0;
+    int hi = n - 1;
+    while (hi - lo > 1) {
+      const int mid = (lo + hi) / 2;
+      if (g[mid] <= v) lo = mid; else hi = mid;
+    }
+    return lo;
+  }
+
+  // v as the point k of the grid g plus the fraction eta (in [0, 1]) of the next spacing
+  static int gridPoint(const double* g, 
+                       int n, 
+                       double v,
+                       double& eta)
+  {
+    const int k = gridInterval(g, n, v);
+    eta = (v - g[k]) / spacing(g, k);
+    eta = (eta < 0.0 ? 0.0 : (eta > 1.0 ? 1.0 : eta));
+    return k;
+  }
+
+  // the grid point closest to v; -1 if v is more than half a spacing outside the grid
+  static int nearestPoint(const double* g, 
+                          int n, 
+                          double v)
+  {
+    if (v < g[0] - 0.5 * spacing(g, 0) || v > g[n - 1] + 0.5 * spacing(g, n - 2))
+      return -1;
+    const int k = gridInterval(g, n, v);
+    return (v - g[k] < g[k + 1] - v ? k : k + 1);
+  }
+
+  void prepareSpacing() {
+    for (int ix = 0; ix < NX; ix++) {
+      const double h = (ix < NX - 1 ? spacing(xgrid, ix) : delta);
+      const double d = dualSpacing(xgrid, NX, ix);
+      gxH[ix] = static_cast<T>(graded ? delta / h : 1.0);
+      wxH[ix] = static_cast<T>(graded ? h / delta : 1.0);
+      gxE[ix] = static_cast<T>(graded ? delta / d : 1.0);
+      wxE[ix] = static_cast<T>(graded ? d / delta : 1.0);
+    }
+    for (int iy = 0; iy < NY; iy++) {
+      const double h = (iy < NY - 1 ? spacing(ygrid, iy) : delta);
+      gyH[iy] = static_cast<T>(graded ? delta / h : 1.0);
+      gyE[iy] = static_cast<T>(graded ? delta / dualSpacing(ygrid, NY, iy) : 1.0);
+    }
+  }
+
+  // the spacing factors of row iy of a graded mesh, for the kernels (which get nullptr otherwise)
+  struct RowGrid
+  {
+    T gyH;
+    T gyE;
+    const T* gxH;
+    const T* gxE;
+    const T* wxH;
+    const T* wxE;
+    double wyH; // y height of the Hx cells over delta
+    double wyE; // of the Ez and Hy cells
+  };
+
+  RowGrid rowGrid(int iy) const {
+    RowGrid g;
+    g.gyH = gyH[iy];
+    g.gyE = gyE[iy];
+    g.gxH = gxH;
+    g.gxE = gxE;
+    g.wxH = wxH;
+    g.wxE = wxE;
+    g.wyH = (iy < NY - 1 ? spacing(ygrid, iy) / delta : 1.0);
+    g.wyE = dualSpacing(ygrid, NY, iy) / delta;
+    return g;
+  }
+
+  // energy of Ez, Hx or Hy on a graded mesh, each value weighted by the area of its cell: along x
+  // (y) the spacing if the field sits between grid points (px, py = 1), otherwise the dual width
+  double energyGraded(const T* f,
+                      int px,
+                      int py) const
+  {
+    const bool electric = (f == Ez);
+    double sum = 0.0;
+    for (int iy = 0; iy < NY - py; iy++) {
+      const double hy = (py ? spacing(ygrid, iy) : dualSpacing(ygrid, NY, iy));
+      for (int ix = 0; ix < NX - px; ix++) {
+        const int i = index(ix, iy);
+        const double hx = (px ? spacing(xgrid, ix) : dualSpacing(xgrid, NX, ix));
+        const fdtdMaterial<T>& m = materials[material[i]];
+        const double fi = f[i];
+        sum += (electric ? m.epr : m.mur) * fi * fi * hx * hy;
+      }
+    }
+    return (electric ? vacuum_permittivity : vacuum_permeability) * sum / 2.0;
+  }
+
+  // the coefficients that depend on delta and the Courant number: media, edges, CPML and source
+  void rescale() {
+    for (int i = 0; i < materialCount; i++) {
+      fdtdMaterial<T>& m = materials[i];
+      m.set(m.mur, m.epr, m.sigmam, m.sigma, getDelta(), courant);
+    }
+    prepareABC();
+    if (cpmlX || cpmlY)
+      preparePML();
+    source.setCourant(courant);
+  }
+
+  // Mur edges for the Courant number of the cells next to each edge
+  void prepareABC() {
+    abc.initialize(courant * vacuum_impedance, courant / vacuum_impedance);
+    abc.mirrorCorners(symmetryX == fdtdSymmetryType::EvenSymmetry, symmetryY == fdtdSymmetryType::EvenSymmetry);
+    if (!graded)
+      return;
+    abc.setCourant(abc.Left, courant * delta / spacing(xgrid, 0));
+    abc.setCourant(abc.Right, courant * delta / spacing(xgrid, NX - 2));
+    abc.setCourant(abc.Bottom, courant * delta / spacing(ygrid, 0));
+    abc.setCourant(abc.Top, courant * delta / spacing(ygrid, NY - 2));
+  }
+
+  double interpolate(const T* f,
+                     double xhat, 
+                     double yhat) const
+  {
+    const int xi = (int) xhat;
+    const int yi = (int) yhat;
+    const double etax = xhat - xi;
+    const double etay = yhat - yi;
+
+    const double v00 = f[index(xi, yi)];
+    const double v01 = f[index(xi, yi + 1)];
+    const double v10 = f[index(xi + 1, yi)];
+    const double v11 = f[index(xi + 1, yi + 1)];
+
+    const double w00 = (1.0 - etax) * (1.0 - etay);
+    const double w01 = (1.0 - etax) * etay;
     const double w10 = etax * (1.0 - etay);
     const double w11 = etax * etay;
 
     return w00 * v00 + w01 * v01 + w10 * v10 + w11 * v11;
   }
 
-  float interpolate_float(const double* f,
+  float interpolate_float(const T* f,
                           float xhat, 
                           float yhat) const
   {
     const int xi = (int) xhat;
     const int yi = (int) yhat;
-    const float etax = xhat - xi;
-    const float etay = yhat - yi;
+    return interpolate_float(f, xi, yi, xhat - xi, yhat - yi);
+  }
 
+  float interpolate_float(const T* f,
+                          int xi,
+                          int yi,
+                          float etax,
+                          float etay) const
+  {
     const int idx = index(xi, yi);
 
     const float v00 = (float) f[idx];
@@ -619,14 +1671,24 @@ private:
     for (int ix = 0; ix < NX; ix++) {
       for (int iy = 0; iy < NY - 1; iy++) {
         const int idx = index(ix, iy);
-        Hx[idx] = chxh[idx] * Hx[idx] - chxe[idx] * (Ez[index(ix, iy + 1)] - Ez[idx]);
+        const fdtdMaterial<T>& m = materials[material[idx]];
+        T dez = Ez[index(ix, iy + 1)] - Ez[idx];
+        if (isWideH(iy, NY, layerY()))
+          dez = wide(dez, Ez[index(ix, iy + 2)] - Ez[index(ix, iy - 1)]);
+        if (graded) dez = dez * gyH[iy];
+        Hx[idx] = m.chh * Hx[idx] - m.che * dez;
       }
     }
 
     for (int ix = 0; ix < NX - 1; ix++) {
       for (int iy = 0; iy < NY; iy++) {
         const int idx = index(ix, iy);
-        Hy[idx] = chyh[idx] * Hy[idx] + chye[idx] * (Ez[index(ix + 1, iy)] - Ez[idx]);
+        const fdtdMaterial<T>& m = materials[material[idx]];
+        T dez = Ez[index(ix + 1, iy)] - Ez[idx];
+        if (isWideH(ix, NX, layerX()))
+          dez = wide(dez, Ez[index(ix + 2, iy)] - Ez[index(ix - 1, iy)]);
+        if (graded) dez = dez * gxH[ix];
+        Hy[idx] = m.chh * Hy[idx] + m.che * dez;
       }
     }
   }
@@ -635,121 +1697,1159 @@ private:
     for (int ix = 1; ix < NX - 1; ix++) {
       for (int iy = 1; iy < NY - 1; iy++) {
         const int idx = index(ix, iy);
-        const double dxhy = Hy[idx] - Hy[index(ix - 1, iy)];
-        const double dyhx = Hx[idx] - Hx[index(ix, iy - 1)];
-        Ez[idx] = ceze[idx] * Ez[idx] + cezh[idx] * (dxhy - dyhx);
+        T dxhy = Hy[idx] - Hy[index(ix - 1, iy)];
+        T dyhx = Hx[idx] - Hx[index(ix, iy - 1)];
+        if (isWideE(ix, NX, layerX()))
+          dxhy = wide(dxhy, Hy[index(ix + 1, iy)] - Hy[index(ix - 2, iy)]);
+        if (isWideE(iy, NY, layerY()))
+          dyhx = wide(dyhx, Hx[index(ix, iy + 1)] - Hx[index(ix, iy - 2)]);
+        if (graded) {
+          dxhy = dxhy * gxE[ix];
+          dyhx = dyhx * gyE[iy];
+        }
+        const fdtdMaterial<T>& m = materials[material[idx]];
+        Ez[idx] = m.cee * Ez[idx] + m.ceh * (dxhy - dyhx);
       }
     }
   }
 
+  // FDTD(2,4) differences: H at i + 1/2 (E at i) is wide for i in [1, n - 3] ([2, n - 3]),
+  // which keeps the three-cell difference on the grid; the CPML layers stay Yee
+  int layerX() const { return (cpmlX ? pml.d : 0); }
+  int layerY() const { return (cpmlY ? pml.d : 0); }
+
+  bool isWideH(int i, 
+               int n, 
+               int layer) const
+  {
+    return stencil == fdtdStencilType::FourthOrder && i >= 1 + layer && i < n - 2 - layer;
+  }
+
+  bool isWideE(int i, 
+               int n, 
+               int layer) const
+  {
+    return stencil == fdtdStencilType::FourthOrder && i >= 2 + layer && i < n - 2 - layer;
+  }
+
+  // the part [a, b) of [x0, x1) where the H (lo = 1) or E (lo = 2) columns are wide
+  void wideColumns(int lo, 
+                   int x0, 
+                   int x1, 
+                   int& a, 
+                   int& b) const
+  {
+    a = x1;
+    b = x1;
+    if (stencil != fdtdStencilType::FourthOrder)
+      return;
+    const int hi = NX - 2 - layerX();
+    lo += layerX();
+    a = (lo < x0 ? x0 : (lo > x1 ? x1 : lo));
+    b = (hi < a ? a : (hi > x1 ? x1 : hi));
+  }
+
+  // Edge values of Ez are not touched by the E update kernels; they are set here
+  void updateBoundaryEz() {
+    // (the Mur x edges reach the row of an even y plane)
+    if (symmetryY == fdtdSymmetryType::EvenSymmetry) makeEzMirrorY(0, NX);
+
+    if (periodicAlongX) {
+      makeEzPeriodicX();
+    } else {
+      if (symmetryX == fdtdSymmetryType::EvenSymmetry) makeEzMirrorX();
+      if (absorbingLeft) abc.applyLeft(Ez, updateCounter & 1);
+      if (absorbingRight) abc.applyRight(Ez, updateCounter & 1);
+    }
+
+    if (periodicAlongY) {
+      makeEzPeriodicY();
+    } else {
+      if (absorbingTop) abc.applyTop(Ez, updateCounter & 1);
+      if (absorbingBottom) abc.applyBottom(Ez, updateCounter & 1);
+    }
+  }
+
+  // about 3 arrays (Ez, Hx, Hy) times 2 rows are reused from one row to the next;
+  // let that working set take half of L1
+  static int defaultTileWidth() {
+    return cacheBytesL1 / (2 * 3 * 2 * sizeof(T));
+  }
+
+  typedef fdtdVec<T> V;
+
+  // partial reductions of one step (per thread), in double; see fdtdDiagnostics
+  struct Sums
+  {
+    double ee;  // sum of epr Ez^2
+    double ez2; // sum of Ez^2
+    double hh;  // sum of mur H(n - 1/2) H(n + 1/2) over Hx and Hy
+    double mn;
+    double mx;
+    bool any;
+
+    void clear() { ee = ez2 = hh = mn = mx = 0.0; any = false; }
+
+    void add(const Sums& o) {
+      ee += o.ee;
+      ez2 += o.ez2;
+      hh += o.hh;
+      if (!o.any) return;
+      mn = (any && mn < o.mn ? mn : o.mn);
+      mx = (any && mx > o.mx ? mx : o.mx);
+      any = true;
+    }
+  };
+
+  Sums sums; // of the single-threaded sweeps
+
+  // lane accumulators for one row of a kernel, folded into Sums at the end of the row
+  // (row sums in T are short enough for float; the grid total is in double)
+  struct RowSums
+  {
+    typename V::type ee, ez2, hh, mn, mx;
+    T see, sez2, shh, smn, smx; // scalar tails
+    bool hasE;
+
+    explicit RowSums(T e0) :
+      ee(V::set1(0)), ez2(V::set1(0)), hh(V::set1(0)), mn(V::set1(e0)), mx(V::set1(e0)),
+      see(0), sez2(0), shh(0), smn(e0), smx(e0), hasE(false) {}
+
+    void addE(typename V::type e,
+              typename V::type w)
+    {
+      const typename V::type e2 = V::mul(e, e);
+      ee = V::add(ee, V::mul(w, e2));
+      ez2 = V::add(ez2, e2);
+      mn = V::min(mn, e);
+      mx = V::max(mx, e);
+      hasE = true;
+    }
+
+    void addE(T e,
+              T w)
+    {
+      see += w * (e * e);
+      sez2 += e * e;
+      smn = (e < smn ? e : smn);
+      smx = (e > smx ? e : smx);
+      hasE = true;
+    }
+
+    void addH(typename V::type h0,
+              typename V::type h1,
+              typename V::type w)
+    {
+      hh = V::add(hh, V::mul(w, V::mul(h0, h1)));
+    }
+
+    void addH(T h0,
+              T h1,
+              T w)
+    {
+      shh += w * (h0 * h1);
+    }
+
+    // re, rh: y height of the E and H cells of the row on a graded mesh
+    void fold(Sums* s,
+              double re = 1.0,
+              double rh = 1.0) const
+    {
+      T lee[V::width], lez2[V::width], lhh[V::width], lmn[V::width], lmx[V::width];
+      V::store(lee, ee);
+      V::store(lez2, ez2);
+      V::store(lhh, hh);
+      V::store(lmn, mn);
+      V::store(lmx, mx);
+      double a = see, b = sez2, c = shh, lo = smn, hi = smx;
+      for (int l = 0; l < V::width; l++) {
+        a += lee[l];
+        b += lez2[l];
+        c += lhh[l];
+        lo = (lmn[l] < lo ? lmn[l] : lo);
+        hi = (lmx[l] > hi ? lmx[l] : hi);
+      }
+      s->ee += a * re;
+      s->ez2 += b;
+      s->hh += c * rh;
+      if (hasE) {
+        s->mn = (s->any && s->mn < lo ? s->mn : lo);
+        s->mx = (s->any && s->mx > hi ? s->mx : hi);
+        s->any = true;
+      }
+    }
+  };
+
+  // Ez part of the diagnostics for the top row (which has no Hx update)
+  static void sumEzRow(const T* ez,
+                       const uint8_t* id,
+                       const fdtdMaterial<T>* m,
+                       int x0,
+                       int x1,
+                       Sums* s,
+                       const RowGrid* g)
+  {
+    if (x0 >= x1) return;
+    RowSums acc(ez[x0]);
+    for (int ix = x0; ix < x1; ix++)
+      acc.addE(ez[ix], g != nullptr ? m[id[ix]].wE * g->wxE[ix] : m[id[ix]].wE);
+    acc.fold(s, g != nullptr ? g->wyE : 1.0);
+  }
+
+  void finishDiagnostics(const Sums& s,
+                         int step)
+  {
+    const double delta = getDelta();
+    diagnostics.step = step;
+    diagnostics.energyE = vacuum_permittivity * (s.ee * delta * delta / 2.0);
+    diagnostics.energyH = vacuum_permeability * (s.hh * delta * delta / 2.0);
+    diagnostics.minimumEz = s.mn;
+    diagnostics.maximumEz = s.mx;
+    diagnostics.normEz = std::sqrt(s.ez2);
+  }
+
+  void updateMediumType() {
+    if (!uniformMap)
+      medium = PerCellMedium;
+    else if (materials[0].sigma == 0.0 && materials[0].sigmam == 0.0)
+      medium = LosslessMedium;
+    else
+      medium = UniformMedium;
+  }
+
+  // Row kernels on the half-open column range [x0, x1); same arithmetic as updateHxHy() and updateEz()
+  // with s, the diagnostics of row iy over [x0, x1) are added to it
+  void updateHxHyRow(int iy,
+                     int x0,
+                     int x1,
+                     Sums* s = nullptr)
+  {
+    switch (medium) {
+      case LosslessMedium: updateHxHyRow<LosslessMedium>(iy, x0, x1, s); break;
+      case UniformMedium: updateHxHyRow<UniformMedium>(iy, x0, x1, s); break;
+      default: updateHxHyRow<PerCellMedium>(iy, x0, x1, s); break;
+    }
+    if (cpmlX || cpmlY)
+      updateHxHyRowPML(iy, x0, x1);
+  }
+
+  void updateEzRow(int iy, 
+                   int x0, 
+                   int x1)
+  {
+    switch (medium) {
+      case LosslessMedium: updateEzRow<LosslessMedium>(iy, x0, x1); break;
+      case UniformMedium: updateEzRow<UniformMedium>(iy, x0, x1); break;
+      default: updateEzRow<PerCellMedium>(iy, x0, x1); break;
+    }
+    if (cpmlX || cpmlY)
+      updateEzRowPML(iy, x0, x1);
+  }
+
+  int usableCPMLThickness() const {
+    const int dmax = (NX < NY ? NX : NY) / 3;
+    return (cpmlThickness < dmax ? cpmlThickness : dmax);
+  }
+
+  // (re)grades the layer and zeroes its state
+  bool preparePML() {
+    return pml.initialize(NX, NY, usableCPMLThickness(), materials[0].epr, materials[0].mur, getDelta(), courant);
+  }
+
+  // CPML terms of row iy over the columns [x0, x1), after the regular update of the row;
+  // they read the same neighbours as the regular kernels, so tiling and blocking stay exact
+  // (the differences are scaled for a graded mesh; by exactly 1 on a uniform one)
+  void updateHxHyRowPML(int iy, 
+                        int x0, 
+                        int x1)
+  {
+    const int row = index(0, iy);
+    const int d = pml.d;
+    const int dl = (symmetryX == fdtdSymmetryType::NoSymmetry ? d : 0); // no layers on symmetry planes
+    const int db = (symmetryY == fdtdSymmetryType::NoSymmetry ? d : 0);
+    if (cpmlX) {
+      T* psi = pml.psiHyxLeft + iy * d;
+      for (int ix = x0; ix < (x1 < dl ? x1 : dl); ix++) {
+        psi[ix] = pml.bH[ix] * psi[ix] + pml.aH[ix] * ((Ez[row + ix + 1] - Ez[row + ix]) * gxH[ix]);
+        Hy[row + ix] += materials[material[row + ix]].che * psi[ix];
+      }
+      psi = pml.psiHyxRight + iy * d;
+      for (int ix = (x0 > NX - 1 - d ? x0 : NX - 1 - d); ix < (x1 < NX - 1 ? x1 : NX - 1); ix++) {
+        const int k = NX - 2 - ix;
+        psi[k] = pml.bH[k] * psi[k] + pml.aH[k] * ((Ez[row + ix + 1] - Ez[row + ix]) * gxH[ix]);
+        Hy[row + ix] += materials[material[row + ix]].che * psi[k];
+      }
+    }
+    if (cpmlY && iy < NY - 1) {
+      const int k = (iy < d ? iy : NY - 2 - iy);
+      if (k < d && (iy >= d || iy < db)) {
+        T* psi = (iy < d ? pml.psiHxyBottom : pml.psiHxyTop) + k * NX;
+        for (int ix = x0; ix < x1; ix++) {
+          psi[ix] = pml.bH[k] * psi[ix] + pml.aH[k] * ((Ez[row + NX + ix] - Ez[row + ix]) * gyH[iy]);
+          Hx[row + ix] -= materials[material[row + ix]].che * psi[ix];
+        }
+      }
+    }
+  }
+
+  void updateEzRowPML(int iy, 
+                      int x0, 
+                      int x1)
+  {
+    const int row = index(0, iy);
+    const int d = pml.d;
+    const int dl = (symmetryX == fdtdSymmetryType::NoSymmetry ? d : 0);
+    const int db = (symmetryY == fdtdSymmetryType::NoSymmetry ? d : 0);
+    if (x0 < 1) x0 = 1;
+    if (x1 > NX - 1) x1 = NX - 1;
+    if (cpmlX) {
+      T* psi = pml.psiEzxLeft + iy * d;
+      for (int ix = x0; ix < (x1 < dl ? x1 : dl); ix++) {
+        psi[ix] = pml.bE[ix] * psi[ix] + pml.aE[ix] * ((Hy[row + ix] - Hy[row + ix - 1]) * gxE[ix]);
+        Ez[row + ix] += materials[material[row + ix]].ceh * psi[ix];
+      }
+      psi = pml.psiEzxRight + iy * d;
+      for (int ix = (x0 > NX - d ? x0 : NX - d); ix < x1; ix++) {
+        const int k = NX - 1 - ix;
+        psi[k] = pml.bE[k] * psi[k] + pml.aE[k] * ((Hy[row + ix] - Hy[row + ix - 1]) * gxE[ix]);
+        Ez[row + ix] += materials[material[row + ix]].ceh * psi[k];
+      }
+    }
+    if (cpmlY) {
+      const int k = (iy < d ? iy : NY - 1 - iy);
+      if (k < d && (iy >= d || iy < db)) {
+        T* psi = (iy < d ? pml.psiEzyBottom : pml.psiEzyTop) + k * NX;
+        for (int ix = x0; ix < x1; ix++) {
+          psi[ix] = pml.bE[k] * psi[ix] + pml.aE[k] * ((Hx[row + ix] - Hx[row + ix - NX]) * gyE[iy]);
+          Ez[row + ix] -= materials[material[row + ix]].ceh * psi[ix];
+        }
+      }
+    }
+  }
+
+  template <int M>
+  void updateHxHyRow(int iy,
+                     int x0,
+                     int x1,
+                     Sums* s)
+  {
+    if (s == nullptr)
+      updateHxHyRow<M, false>(iy, x0, x1, s);
+    else
+      updateHxHyRow<M, true>(iy, x0, x1, s);
+  }
+
+  // with the (2,4) stencil a row is split into Yee, wide and Yee column ranges
+  template <int M, bool D>
+  void updateHxHyRow(int iy,
+                     int x0,
+                     int x1,
+                     Sums* s)
+  {
+    const int row = index(0, iy);
+    const T* ez = Ez + row;
+    const int x1y = (x1 < NX - 1 ? x1 : NX - 1);
+    if (graded) {
+      const RowGrid g = rowGrid(iy);
+      if (iy == NY - 1) {
+        if (D) sumEzRow(ez, material + row, materials, x0, x1, s, &g);
+      } else {
+        kernelHxRow<M, D, false, true>(Hx + row, material + row, materials, ez, ez + NX, nullptr, nullptr, x0, x1, s, &g);
+      }
+      if (x0 < x1y) kernelHyRow<M, D, false, true>(Hy + row, material + row, materials, ez, x0, x1y, s, &g);
+      return;
+    }
+    if (iy == NY - 1) {
+      if (D) sumEzRow(ez, material + row, materials, x0, x1, s, nullptr);
+    } else if (isWideH(iy, NY, layerY())) {
+      kernelHxRow<M, D, true, false>(Hx + row, material + row, materials, ez, ez + NX, ez - NX, ez + 2 * NX, x0, x1, s, nullptr);
+    } else {
+      kernelHxRow<M, D, false, false>(Hx + row, material + row, materials, ez, ez + NX, nullptr, nullptr, x0, x1, s, nullptr);
+    }
+    int a, b;
+    wideColumns(1, x0, x1y, a, b);
+    if (x0 < a) kernelHyRow<M, D, false, false>(Hy + row, material + row, materials, ez, x0, a, s, nullptr);
+    if (a < b) kernelHyRow<M, D, true, false>(Hy + row, material + row, materials, ez, a, b, s, nullptr);
+    if (b < x1y) kernelHyRow<M, D, false, false>(Hy + row, material + row, materials, ez, b, x1y, s, nullptr);
+  }
+
+  template <int M>
+  void updateEzRow(int iy, 
+                   int x0, 
+                   int x1)
+  {
+    const T* hx = Hx + index(0, iy);
+    if (isWideE(iy, NY, layerY()))
+      updateEzRow<M, true>(iy, hx + NX, hx - 2 * NX, x0, x1);
+    else
+      updateEzRow<M, false>(iy, nullptr, nullptr, x0, x1);
+  }
+
+  template <int M, bool WY>
+  void updateEzRow(int iy, 
+                   const T* hxn, 
+                   const T* hxss, 
+                   int x0, 
+                   int x1)
+  {
+    const int row = index(0, iy);
+    if (x0 < 1) x0 = 1;
+    if (x1 > NX - 1) x1 = NX - 1;
+    T* ez = Ez + row;
+    const T* hx = Hx + row;
+    if (graded) {
+      const RowGrid g = rowGrid(iy);
+      if (x0 < x1) kernelEzRow<M, false, false, true>(ez, material + row, materials, hx, hx - NX, nullptr, nullptr, Hy + row, x0, x1, &g);
+      return;
+    }
+    int a, b;
+    wideColumns(2, x0, x1, a, b);
+    if (x0 < a) kernelEzRow<M, false, WY, false>(ez, material + row, materials, hx, hx - NX, hxn, hxss, Hy + row, x0, a, nullptr);
+    if (a < b) kernelEzRow<M, true, WY, false>(ez, material + row, materials, hx, hx - NX, hxn, hxss, Hy + row, a, b, nullptr);
+    if (b < x1) kernelEzRow<M, false, WY, false>(ez, material + row, materials, hx, hx - NX, hxn, hxss, Hy + row, b, x1, nullptr);
+  }
+
+  // coefficients ca, cb of the materials of the next V::width cells;
+  // a broadcast when they all share one material (the usual case)
+  static void gather(const uint8_t* id, 
+                     const fdtdMaterial<T>* m,
+                     T fdtdMaterial<T>::* a,
+                     T fdtdMaterial<T>::* b,
+                     typename V::type& ca,
+                     typename V::type& cb)
+  {
+    bool same = true;
+    for (int l = 1; l < V::width; l++) same = same && (id[l] == id[0]);
+    if (same) {
+      ca = V::set1(m[id[0]].*a);
+      cb = V::set1(m[id[0]].*b);
+      return;
+    }
+    T la[V::width];
+    T lb[V::width];
+    for (int l = 0; l < V::width; l++) {
+      la[l] = m[id[l]].*a;
+      lb[l] = m[id[l]].*b;
+    }
+    ca = V::load(la);
+    cb = V::load(lb);
+  }
+
+  // d1 is the one-cell difference, d3 the three-cell one (same order of operations everywhere)
+  static T wide(T d1, 
+                T d3) 
+  {
+    return static_cast<T>(9.0 / 8.0) * d1 + static_cast<T>(-1.0 / 24.0) * d3;
+  }
+
+  static typename V::type wideVec(typename V::type d1, 
+                                  typename V::type d3) 
+  {
+    return V::add(V::mul(V::set1(static_cast<T>(9.0 / 8.0)), d1), V::mul(V::set1(static_cast<T>(-1.0 / 24.0)), d3));
+  }
+
+  // M is an fdtdMediumType; with a uniform medium all cells use material 0 and the
+  // per-cell lookups fold away, with a lossless one the ca multiply (by exactly 1) does too.
+  // With D the kernels also reduce what they have loaded into s: Ez at n (in the Hx kernel,
+  // which covers every column) and the products of old and new H.
+  // With W the (2,4) difference is taken, which also reads the rows ezs below and eznn two above.
+  // With G the differences are scaled for a graded mesh (and the diagnostics weighted by cell area).
+  template <int M, bool D, bool W, bool G>
+  static void kernelHxRow(T* __restrict hx,
+                          const uint8_t* __restrict id,
+                          const fdtdMaterial<T>* __restrict m,
+                          const T* __restrict ez,
+                          const T* __restrict ezn,
+                          const T* __restrict ezs,
+                          const T* __restrict eznn,
+                          int x0,
+                          int x1,
+                          Sums* s,
+                          const RowGrid* g)
+  {
+    const T ca0 = m[0].chh;
+    const T cb0 = m[0].che;
+    typename V::type ca = V::set1(ca0);
+    typename V::type cb = V::set1(cb0);
+    typename V::type we = V::set1(m[0].wE);
+    typename V::type wh = V::set1(m[0].wH);
+    const typename V::type gy = V::set1(G ? g->gyH : T(1));
+    RowSums acc(D && x0 < x1 ? ez[x0] : T(0));
+    int ix = x0;
+    for (; ix + V::width <= x1; ix += V::width) {
+      if (M == PerCellMedium)
+        gather(id + ix, m, &fdtdMaterial<T>::chh, &fdtdMaterial<T>::che, ca, cb);
+      const typename V::type h = V::load(hx + ix);
+      const typename V::type e = V::load(ez + ix);
+      typename V::type dez = V::sub(V::load(ezn + ix), e);
+      if (W) dez = wideVec(dez, V::sub(V::load(eznn + ix), V::load(ezs + ix)));
+      if (G) dez = V::mul(dez, gy);
+      const typename V::type hn = V::sub(M == LosslessMedium ? h : V::mul(ca, h), V::mul(cb, dez));
+      V::store(hx + ix, hn);
+      if (D) {
+        if (M == PerCellMedium)
+          gather(id + ix, m, &fdtdMaterial<T>::wE, &fdtdMaterial<T>::wH, we, wh);
+        if (G) {
+          const typename V::type wx = V::load(g->wxE + ix);
+          acc.addE(e, V::mul(we, wx));
+          acc.addH(h, hn, V::mul(wh, wx));
+        } else {
+          acc.addE(e, we);
+          acc.addH(h, hn, wh);
+        }
+      }
+    }
+    for (; ix < x1; ix++) {
+      const T a = (M == PerCellMedium ? m[id[ix]].chh : ca0);
+      const T b = (M == PerCellMedium ? m[id[ix]].che : cb0);
+      const T h = hx[ix];
+      T dez = ezn[ix] - ez[ix];
+      if (W) dez = wide(dez, eznn[ix] - ezs[ix]);
+      if (G) dez = dez * g->gyH;
+      hx[ix] = (M == LosslessMedium ? h : a * h) - b * dez;
+      if (D) {
+        const fdtdMaterial<T>& mi = m[M == PerCellMedium ? id[ix] : 0];
+        acc.addE(ez[ix], G ? mi.wE * g->wxE[ix] : mi.wE);
+        acc.addH(h, hx[ix], G ? mi.wH * g->wxE[ix] : mi.wH);
+      }
+    }
+    if (D) acc.fold(s, G ? g->wyE : 1.0, G ? g->wyH : 1.0);
+  }
+
+  template <int M, bool D, bool W, bool G>
+  static void kernelHyRow(T* __restrict hy,
+                          const uint8_t* __restrict id,
+                          const fdtdMaterial<T>* __restrict m,
+                          const T* __restrict ez,
+                          int x0,
+                          int x1,
+                          Sums* s,
+                          const RowGrid* g)
+  {
+    const T ca0 = m[0].chh;
+    const T cb0 = m[0].che;
+    typename V::type ca = V::set1(ca0);
+    typename V::type cb = V::set1(cb0);
+    typename V::type wh = V::set1(m[0].wH);
+    RowSums acc(0);
+    int ix = x0;
+    for (; ix + V::width <= x1; ix += V::width) {
+      if (M == PerCellMedium)
+        gather(id + ix, m, &fdtdMaterial<T>::chh, &fdtdMaterial<T>::che, ca, cb);
+      const typename V::type h = V::load(hy + ix);
+      typename V::type dez = V::sub(V::load(ez + ix + 1), V::load(ez + ix));
+      if (W) dez = wideVec(dez, V::sub(V::load(ez + ix + 2), V::load(ez + ix - 1)));
+      if (G) dez = V::mul(dez, V::load(g->gxH + ix));
+      const typename V::type hn = V::add(M == LosslessMedium ? h : V::mul(ca, h), V::mul(cb, dez));
+      V::store(hy + ix, hn);
+      if (D) {
+        if (M == PerCellMedium)
+          gather(id + ix, m, &fdtdMaterial<T>::wH, &fdtdMaterial<T>::wH, wh, wh);
+        acc.addH(h, hn, G ? V::mul(wh, V::load(g->wxH + ix)) : wh);
+      }
+    }
+    for (; ix < x1; ix++) {
+      const T a = (M == PerCellMedium ? m[id[ix]].chh : ca0);
+      const T b = (M == PerCellMedium ? m[id[ix]].che : cb0);
+      const T h = hy[ix];
+      T dez = ez[ix + 1] - ez[ix];
+      if (W) dez = wide(dez, ez[ix + 2] - ez[ix - 1]);
+      if (G) dez = dez * g->gxH[ix];
+      hy[ix] = (M == LosslessMedium ? h : a * h) + b * dez;
+      if (D) {
+        const T w = m[M == PerCellMedium ? id[ix] : 0].wH;
+        acc.addH(h, hy[ix], G ? w * g->wxH[ix] : w);
+      }
+    }
+    if (D) acc.fold(s, 1.0, G ? g->wyE : 1.0);
+  }
+
+  // hxs is the Hx row below (for the periodic y edges it is the row on the other side);
+  // WX, WY take the (2,4) differences in x and in y (then with the rows hxn above and hxss two below)
+  template <int M, bool WX, bool WY, bool G>
+  static void kernelEzRow(T* __restrict ez,
+                          const uint8_t* __restrict id,
+                          const fdtdMaterial<T>* __restrict m,
+                          const T* __restrict hx,
+                          const T* __restrict hxs,
+                          const T* __restrict hxn,
+                          const T* __restrict hxss,
+                          const T* __restrict hy,
+                          int x0,
+                          int x1,
+                          const RowGrid* g)
+  {
+    const T ca0 = m[0].cee;
+    const T cb0 = m[0].ceh;
+    typename V::type ca = V::set1(ca0);
+    typename V::type cb = V::set1(cb0);
+    const typename V::type gy = V::set1(G ? g->gyE : T(1));
+    int ix = x0;
+    for (; ix + V::width <= x1; ix += V::width) {
+      if (M == PerCellMedium)
+        gather(id + ix, m, &fdtdMaterial<T>::cee, &fdtdMaterial<T>::ceh, ca, cb);
+      const typename V::type e = V::load(ez + ix);
+      typename V::type dxhy = V::sub(V::load(hy + ix), V::load(hy + ix - 1));
+      typename V::type dyhx = V::sub(V::load(hx + ix), V::load(hxs + ix));
+      if (WX) dxhy = wideVec(dxhy, V::sub(V::load(hy + ix + 1), V::load(hy + ix - 2)));
+      if (WY) dyhx = wideVec(dyhx, V::sub(V::load(hxn + ix), V::load(hxss + ix)));
+      if (G) {
+        dxhy = V::mul(dxhy, V::load(g->gxE + ix));
+        dyhx = V::mul(dyhx, gy);
+      }
+      V::store(ez + ix, V::add(M == LosslessMedium ? e : V::mul(ca, e), V::mul(cb, V::sub(dxhy, dyhx))));
+    }
+    for (; ix < x1; ix++) {
+      const T a = (M == PerCellMedium ? m[id[ix]].cee : ca0);
+      const T b = (M == PerCellMedium ? m[id[ix]].ceh : cb0);
+      T dxhy = hy[ix] - hy[ix - 1];
+      T dyhx = hx[ix] - hxs[ix];
+      if (WX) dxhy = wide(dxhy, hy[ix + 1] - hy[ix - 2]);
+      if (WY) dyhx = wide(dyhx, hxn[ix] - hxss[ix]);
+      if (G) {
+        dxhy = dxhy * g->gxE[ix];
+        dyhx = dyhx * g->gyE;
+      }
+      ez[ix] = (M == LosslessMedium ? ez[ix] : a * ez[ix]) + b * (dxhy - dyhx);
+    }
+  }
+
+  // Column strips of tileWidth cells, each swept bottom to top with H then E per row.
+  // E of a row only needs H of the same and the previous row, and H of a row only needs
+  // E of the same and the next row (not yet updated), so the sweep is exact.
+  void updateTiled() {
+    Sums* s = (diagnosticsOn ? &sums : nullptr);
+    sums.clear();
+    for (int x0 = 0; x0 < NX; x0 += tileWidth) {
+      const int x1 = (x0 + tileWidth < NX ? x0 + tileWidth : NX);
+      for (int iy = 0; iy < NY; iy++) {
+        updateHxHyRow(iy, x0, x1, s);
+        if (iy >= 1 && iy < NY - 1)
+          updateEzRow(iy, x0, x1);
+      }
+    }
+  }
+
+  // The tiled sweep for the (2,4) stencil: H of a row reads E up to two rows above and one below,
+  // and E of a row reads Hx up to one row above, so E trails H by two rows. Full-width rows, since
+  // a wide Hy reads E two columns to the right.
+  void updateWide() {
+    Sums* s = (diagnosticsOn ? &sums : nullptr);
+    sums.clear();
+    for (int iy = 0; iy < NY + 2; iy++) {
+      if (iy < NY)
+        updateHxHyRow(iy, 0, NX, s);
+      if (iy - 2 >= 1 && iy - 2 < NY - 1)
+        updateEzRow(iy - 2, 0, NX);
+    }
+  }
+
   // Hx usage size if (NX, NY - 1)
   // Hy usage size is (NX - 1, NY)
   void makeEzPeriodicX() {
+    for (int iy = 1; iy < NY - 1; iy++)
+      makeEzPeriodicXRow(iy);
+  }
+
+  void makeEzPeriodicXRow(int iy) {
     const int ixmin = 0;
-    for (int iy = 1; iy < NY - 1; iy++) {
-      const int idx = index(ixmin, iy);
-      const double dxhy = Hy[idx] - Hy[index(NX - 2, iy)];
-      const double dyhx = Hx[idx] - Hx[index(ixmin, iy - 1)];
-      Ez[idx] = ceze[idx] * Ez[idx] + cezh[idx] * (dxhy - dyhx);
+    const int idx0 = index(ixmin, iy);
+    T dxhy0 = Hy[idx0] - Hy[index(NX - 2, iy)];
+    T dyhx0 = Hx[idx0] - Hx[index(ixmin, iy - 1)];
+    if (graded) {
+      dxhy0 = dxhy0 * gxE[ixmin];
+      dyhx0 = dyhx0 * gyE[iy];
     }
+    const fdtdMaterial<T>& m0 = materials[material[idx0]];
+    Ez[idx0] = m0.cee * Ez[idx0] + m0.ceh * (dxhy0 - dyhx0);
 
     const int ixmax = NX - 1;
-    for (int iy = 1; iy < NY - 1; iy++) {
-      const int idx = index(ixmax, iy);
-      const double dxhy = Hy[index(0, iy)] - Hy[index(ixmax - 1, iy)];
-      const double dyhx = Hx[idx] - Hx[index(ixmax, iy - 1)];
-      Ez[idx] = ceze[idx] * Ez[idx] + cezh[idx] * (dxhy - dyhx);
+    const int idx1 = index(ixmax, iy);
+    T dxhy1 = Hy[index(0, iy)] - Hy[index(ixmax - 1, iy)];
+    T dyhx1 = Hx[idx1] - Hx[index(ixmax, iy - 1)];
+    if (graded) {
+      dxhy1 = dxhy1 * gxE[ixmax];
+      dyhx1 = dyhx1 * gyE[iy];
     }
+    const fdtdMaterial<T>& m1 = materials[material[idx1]];
+    Ez[idx1] = m1.cee * Ez[idx1] + m1.ceh * (dxhy1 - dyhx1);
   }
 
   void zeroBoundaryEzX() {
     for (int iy = 0; iy < NY; iy++) {
-      Ez[index(0, iy)] = 0.0;
+      if (symmetryX != fdtdSymmetryType::EvenSymmetry) Ez[index(0, iy)] = 0.0;
       Ez[index(NX - 1, iy)] = 0.0;
     }
   }
 
+  // fade the fields out towards the x edges over width cells (not at a symmetry plane)
   void taperBorderX(int width) {
+    const bool left = (symmetryX == fdtdSymmetryType::NoSymmetry);
     for (int iy = 0; iy < NY; iy++) {
       for (int w = 0; w < width; w++) {
         const double sw = static_cast<double>(w) / width;
         const double swsq = sw * sw;
-        Ez[index(w, iy)] *= swsq;
+        if (left) {
+          Ez[index(w, iy)] *= swsq;
+          Hx[index(w, iy)] *= swsq;
+          Hy[index(w, iy)] *= swsq;
+        }
         Ez[index(NX - 1 - w, iy)] *= swsq;
-        Hx[index(w, iy)] *= swsq;
         Hx[index(NX - 1 - w, iy)] *= swsq;
-        Hy[index(w, iy)] *= swsq;
         Hy[index(NX - 1 - w, iy)] *= swsq;
       }
     }
   }
 
+  // same as updateEz() on the first and last rows, with the row below (above) taken from the other side
   void makeEzPeriodicY() {
-    const int iymin = 0;
-    for (int ix = 1; ix < NX - 1; ix++) {
-      const int idx = index(ix, iymin);
-      const double dxhy = Hy[idx] - Hy[index(ix - 1, iymin)];
-      const double dyhx = Hx[idx] - Hx[index(ix, NY - 2)];
-      Ez[idx] = ceze[idx] * Ez[idx] + cezh[idx] * (dxhy - dyhx);
+    const int row0 = index(0, 0);
+    const int row1 = index(0, NY - 1);
+    const int rowm = index(0, NY - 2);
+    if (graded) {
+      const RowGrid g0 = rowGrid(0);
+      const RowGrid g1 = rowGrid(NY - 1);
+      kernelEzRow<PerCellMedium, false, false, true>(Ez + row0, material + row0, materials, Hx + row0, Hx + rowm, nullptr, nullptr, Hy + row0, 1, NX - 1, &g0);
+      kernelEzRow<PerCellMedium, false, false, true>(Ez + row1, material + row1, materials, Hx + row0, Hx + rowm, nullptr, nullptr, Hy + row1, 1, NX - 1, &g1);
+    } else {
+      kernelEzRow<PerCellMedium, false, false, false>(Ez + row0, material + row0, materials, Hx + row0, Hx + rowm, nullptr, nullptr, Hy + row0, 1, NX - 1, nullptr);
+      kernelEzRow<PerCellMedium, false, false, false>(Ez + row1, material + row1, materials, Hx + row0, Hx + rowm, nullptr, nullptr, Hy + row1, 1, NX - 1, nullptr);
+    }
+    if (symmetryX == fdtdSymmetryType::EvenSymmetry) {
+      updateEzEdgeNode(0, 0, (Hy[row0] + Hy[row0]) * gxH[0], (Hx[row0] - Hx[rowm]) * gyE[0]);
+      updateEzEdgeNode(0, NY - 1, (Hy[row1] + Hy[row1]) * gxH[0], (Hx[row0] - Hx[rowm]) * gyE[NY - 1]);
     }
+    if (periodicAlongX)
+      makeEzPeriodicCorners(row0, row1, Hx + row0, Hx + rowm);
+  }
 
-    const int iymax = NY - 1;
-    for (int ix = 1; ix < NX - 1; ix++) {
-      const int idx = index(ix, iymax);
-      const double dxhy = Hy[idx] - Hy[index(ix - 1, iymax)];
-      const double dyhx = Hx[index(ix, 0)] - Hx[index(ix, iymax - 1)];
-      Ez[idx] = ceze[idx] * Ez[idx] + cezh[idx] * (dxhy - dyhx);
+  // the first and last nodes of the rows r0 and r1 where both seams meet (hx and hxs as for the rows)
+  void makeEzPeriodicCorners(int r0,
+                             int r1,
+                             const T* hx,
+                             const T* hxs)
+  {
+    const int iy0 = r0 / NX;
+    const int iy1 = r1 / NX;
+    updateEzEdgeNode(0, iy0, (Hy[r0] - Hy[r0 + NX - 2]) * gxE[0], (hx[0] - hxs[0]) * gyE[iy0]);
+    updateEzEdgeNode(NX - 1, iy0, (Hy[r0] - Hy[r0 + NX - 2]) * gxE[NX - 1], (hx[NX - 1] - hxs[NX - 1]) * gyE[iy0]);
+    if (r1 == r0)
+      return;
+    updateEzEdgeNode(0, iy1, (Hy[r1] - Hy[r1 + NX - 2]) * gxE[0], (hx[0] - hxs[0]) * gyE[iy1]);
+    updateEzEdgeNode(NX - 1, iy1, (Hy[r1] - Hy[r1 + NX - 2]) * gxE[NX - 1], (hx[NX - 1] - hxs[NX - 1]) * gyE[iy1]);
+  }
+
+  // Even symmetry planes. Across the plane H parallel to it is the mirror image of H inside with
+  // the sign flipped, so the difference across an edge node is twice the value inside, over the
+  // dual cell of the unfolded grid (the first cell, on a graded mesh). The corner of two planes
+  // (or of a plane and a periodic seam) takes both.
+  void makeEzMirrorX() {
+    for (int iy = 1; iy < NY - 1; iy++)
+      makeEzMirrorXRow(iy);
+  }
+
+  void makeEzMirrorXRow(int iy) {
+    const int idx = index(0, iy);
+    updateEzEdgeNode(0, iy, (Hy[idx] + Hy[idx]) * gxH[0], (Hx[idx] - Hx[idx - NX]) * gyE[iy]);
+  }
+
+  // the bottom row over the columns [x0, x1) (the corners with the first and last strip)
+  void makeEzMirrorY(int x0,
+                     int x1)
+  {
+    const T gy = gyH[0];
+    for (int ix = (x0 > 1 ? x0 : 1); ix < (x1 < NX - 1 ? x1 : NX - 1); ix++)
+      updateEzEdgeNode(ix, 0, (Hy[ix] - Hy[ix - 1]) * gxE[ix], (Hx[ix] + Hx[ix]) * gy);
+    if (x0 == 0 && symmetryX == fdtdSymmetryType::EvenSymmetry)
+      updateEzEdgeNode(0, 0, (Hy[0] + Hy[0]) * gxH[0], (Hx[0] + Hx[0]) * gy);
+    if (x1 == NX && periodicAlongX) {
+      updateEzEdgeNode(0, 0, (Hy[0] - Hy[NX - 2]) * gxE[0], (Hx[0] + Hx[0]) * gy);
+      updateEzEdgeNode(NX - 1, 0, (Hy[0] - Hy[NX - 2]) * gxE[NX - 1], (Hx[NX - 1] + Hx[NX - 1]) * gy);
+    }
+  }
+
+  // the E update of one node from its (scaled) H differences, with the CPML terms of its layers
+  void updateEzEdgeNode(int ix,
+                        int iy,
+                        T dxhy,
+                        T dyhx)
+  {
+    const int i = index(ix, iy);
+    const fdtdMaterial<T>& m = materials[material[i]];
+    Ez[i] = m.cee * Ez[i] + m.ceh * (dxhy - dyhx);
+    const int d = pml.d;
+    if (cpmlX && ix >= 1 && ix < NX - 1 && (ix >= NX - d || (ix < d && symmetryX == fdtdSymmetryType::NoSymmetry))) {
+      const int k = (ix < d ? ix : NX - 1 - ix);
+      T* psi = (ix < d ? pml.psiEzxLeft : pml.psiEzxRight) + iy * d;
+      psi[k] = pml.bE[k] * psi[k] + pml.aE[k] * dxhy;
+      Ez[i] += m.ceh * psi[k];
+    }
+    if (cpmlY && iy >= 1 && iy < NY - 1 && (iy >= NY - d || (iy < d && symmetryY == fdtdSymmetryType::NoSymmetry))) {
+      const int k = (iy < d ? iy : NY - 1 - iy);
+      T* psi = (iy < d ? pml.psiEzyBottom : pml.psiEzyTop) + k * NX;
+      psi[ix] = pml.bE[k] * psi[ix] + pml.aE[k] * dyhx;
+      Ez[i] -= m.ceh * psi[ix];
     }
   }
 
   void zeroBoundaryEzY() {
     for (int ix = 0; ix < NX; ix++) {
-      Ez[index(ix, 0)] = 0.0;
+      if (symmetryY != fdtdSymmetryType::EvenSymmetry) Ez[index(ix, 0)] = 0.0;
       Ez[index(ix, NY - 1)] = 0.0;
     }
   }
 
   void taperBorderY(int width) {
+    const bool bottom = (symmetryY == fdtdSymmetryType::NoSymmetry);
     for (int ix = 0; ix < NX; ix++) {
       for (int w = 0; w < width; w++) {
         const double sw = static_cast<double>(w) / width;
         const double swsq = sw * sw;
-        Ez[index(ix, w)] *= swsq;
+        if (bottom) {
+          Ez[index(ix, w)] *= swsq;
+          Hx[index(ix, w)] *= swsq;
+          Hy[index(ix, w)] *= swsq;
+        }
         Ez[index(ix, NY - 1 - w)] *= swsq;
-        Hx[index(ix, w)] *= swsq;
         Hx[index(ix, NY - 1 - w)] *= swsq;
-        Hy[index(ix, w)] *= swsq;
         Hy[index(ix, NY - 1 - w)] *= swsq;
       }
     }
   }
 
-  void applySource() {
+  // returns -1 if there is no source to inject
+  int sourceIndex() const {
     const int ix = integerx(source.x);
     if (ix < 0 || ix >= NX)
-      return;
+      return -1;
 
     const int iy = integery(source.y);
     if (iy < 0 || iy >= NY)
-      return;
+      return -1;
 
     if (source.type == fdtdSourceType::NoSource)
-      return;
+      return -1;
 
-    const double Sxy = source.get(updateCounter);
+    return index(ix, iy);
+  }
+
+  void applySource() {
+    const int idx = sourceIndex();
+    if (idx < 0)
+      return;
+    injectSource(idx, source.get(updateCounter));
+  }
 
+  void injectSource(int idx, 
+                    double Sxy) 
+  {
     if (source.additive) {
-      Ez[index(ix, iy)] += Sxy;
+      Ez[idx] += static_cast<T>(Sxy);
     } else {
-      Ez[index(ix, iy)] = Sxy;
+      Ez[idx] = static_cast<T>(Sxy);
+    }
+  }
+
+  // Temporal blocking: nb timesteps are pipelined over the rows of a column strip,
+  // step k + 1 trailing step k by wavefrontLag rows. Step k works on the strip shifted
+  // left by k columns, so that everything it reads from the right (E of the next column)
+  // is still at step k - 1 and everything from the left (H of the previous column) is
+  // already at step k. Each (step, row) unit does exactly what update() does to that row.
+  // Periodic x couples the two edges, so the strip is then the full width;
+  // periodic y couples the first and last rows, and is not blocked at all.
+  bool canBlockInTime() const {
+    return kernel == fdtdKernelType::Tiled && !periodicAlongY && stencil == fdtdStencilType::SecondOrder;
+  }
+
+  void advanceBlock(int nb) {
+    double S[maxTemporalDepth];
+    const int isrc = sourceIndex();
+    for (int k = 0; k < nb; k++) {
+      S[k] = (isrc >= 0 ? source.get(updateCounter + k) : 0.0);
+      source.updateTheta();
+    }
+
+    // row after which the source is injected; it must come after the y edge that reads it
+    int srcRow = (isrc >= 0 ? isrc / NX : -1);
+    if (absorbingBottom && srcRow >= 0 && srcRow <= 2) srcRow = 2;
+    if (absorbingTop && srcRow >= NY - 3) srcRow = NY - 1;
+    const int srcCol = (isrc >= 0 ? isrc % NX : -1);
+
+    // (a single step has no shifted strips, so periodic x needs no full-width strip then)
+    const int W = ((periodicAlongX && nb > 1) || tileWidth >= NX ? NX : (tileWidth > nb + 3 ? tileWidth : nb + 3));
+    const int L = wavefrontLag;
+    sums.clear();
+
+    // (a trailing strip under 3 columns is folded into the one before it: the right Mur edge
+    // reads Ez at NX - 2 and NX - 3, which must be in the last strip)
+    for (int x0 = 0; x0 < NX; x0 += W) {
+      const bool firstStrip = (x0 == 0);
+      const bool lastStrip = (x0 + W > NX - 3);
+      for (int sweep = 0; sweep < NY + L * (nb - 1); sweep++) {
+        for (int k = 0; k < nb; k++) {
+          const int iy = sweep - L * k;
+          if (iy < 0 || iy >= NY)
+            continue;
+          const int a = (firstStrip ? 0 : x0 - k);
+          const int b = (lastStrip ? NX : x0 + W - k);
+          const int parity = (updateCounter + k) & 1;
+
+          updateHxHyRow(iy, a, b, (diagnosticsOn && k == nb - 1 ? &sums : nullptr));
+          if (iy >= 1 && iy < NY - 1)
+            updateEzRow(iy, a, b);
+
+          if (periodicAlongX) {
+            if (iy >= 1 && iy < NY - 1 && lastStrip)
+              makeEzPeriodicXRow(iy);
+          } else {
+            if (symmetryY == fdtdSymmetryType::EvenSymmetry && iy == 0)
+              makeEzMirrorY(a, b);
+            if (symmetryX == fdtdSymmetryType::EvenSymmetry && firstStrip && iy >= 1 && iy < NY - 1)
+              makeEzMirrorXRow(iy);
+            if (iy >= abc.rowSkip && iy < NY - abc.bskip) {
+              if (absorbingLeft && firstStrip) abc.applyLeftRow(Ez, iy, parity);
+              if (absorbingRight && lastStrip) abc.applyRightRow(Ez, iy, parity);
+            }
+          }
+          if (periodicAlongX && symmetryY == fdtdSymmetryType::EvenSymmetry && iy == 0)
+            makeEzMirrorY(a, b);
+
+          if (absorbingBottom && iy == 2) abc.applyBottom(Ez, a, b, parity);
+          if (absorbingTop && iy == NY - 1) abc.applyTop(Ez, a, b, parity);
+
+          if (iy == srcRow && srcCol >= a && srcCol < b)
+            injectSource(isrc, S[k]);
+        }
+      }
+      if (lastStrip)
+        break;
+    }
+
+    if (diagnosticsOn) finishDiagnostics(sums, updateCounter + nb - 1);
+    updateCounter += nb;
+  }
+
+  bool isTracking() const {
+    return trackActivity && activeCount < TX * TY && kernel == fdtdKernelType::Tiled &&
+           stencil == fdtdStencilType::SecondOrder;
+  }
+
+  void setAllActive() { activeCount = TX * TY; }
+
+  int tileX(int tx) const { return (NX * tx) / TX; }
+  int tileY(int ty) const { return (NY * ty) / TY; }
+
+  void activate(int tx,
+                int ty)
+  {
+    uint8_t& a = activeTile[ty * TX + tx];
+    if (a == 0) {
+      a = 1;
+      activeCount++;
+    }
+  }
+
+  bool anyNonZero(int x0,
+                  int x1,
+                  int y0,
+                  int y1) const
+  {
+    for (int iy = y0; iy < y1; iy++) {
+      for (int ix = x0; ix < x1; ix++) {
+        const int i = index(ix, iy);
+        if (Ez[i] != 0 || Hx[i] != 0 || Hy[i] != 0)
+          return true;
+      }
+    }
+    return false;
+  }
+
+  // Inactive tiles hold exact zeros (as do the Mur and CPML states next to them), and a step
+  // only reaches one cell further (two across the periodic seams, which couple the first and the
+  // second to last column or row). So before each step, a tile is activated if an active neighbour
+  // has non-zero field within two cells of their common side, or if it holds the source.
+  void growActive() {
+    const int isrc = sourceIndex();
+    if (isrc >= 0) {
+      int tx = ((isrc % NX) * TX) / NX;
+      int ty = ((isrc / NX) * TY) / NY;
+      while (tileX(tx + 1) <= isrc % NX) tx++;
+      while (tileY(ty + 1) <= isrc / NX) ty++;
+      activate(tx, ty);
+    }
+    for (int ty = 0; ty < TY; ty++) {
+      for (int tx = 0; tx < TX; tx++) {
+        if (activeTile[ty * TX + tx] == 0)
+          continue;
+        const int x0 = tileX(tx);
+        const int x1 = tileX(tx + 1);
+        const int y0 = tileY(ty);
+        const int y1 = tileY(ty + 1);
+        const int left = (tx > 0 ? tx - 1 : (periodicAlongX ? TX - 1 : -1));
+        const int right = (tx < TX - 1 ? tx + 1 : (periodicAlongX ? 0 : -1));
+        const int below = (ty > 0 ? ty - 1 : (periodicAlongY ? TY - 1 : -1));
+        const int above = (ty < TY - 1 ? ty + 1 : (periodicAlongY ? 0 : -1));
+        if (left >= 0 && activeTile[ty * TX + left] == 0 && anyNonZero(x0, x0 + 2, y0, y1)) activate(left, ty);
+        if (right >= 0 && activeTile[ty * TX + right] == 0 && anyNonZero(x1 - 2, x1, y0, y1)) activate(right, ty);
+        if (below >= 0 && activeTile[below * TX + tx] == 0 && anyNonZero(x0, x1, y0, y0 + 2)) activate(tx, below);
+        if (above >= 0 && activeTile[above * TX + tx] == 0 && anyNonZero(x0, x1, y1 - 2, y1)) activate(tx, above);
+      }
+    }
+  }
+
+  // updateTiled() over the active tiles only: column by column of tiles, each bottom to top,
+  // which keeps the order of the reads exact (a skipped neighbour is zero before and after)
+  void updateActive() {
+    growActive();
+    Sums* s = (diagnosticsOn ? &sums : nullptr);
+    sums.clear();
+    sums.any = (activeCount < TX * TY); // (the range of Ez starts from the zeros of the skipped tiles)
+    for (int tx = 0; tx < TX; tx++) {
+      const int x0 = tileX(tx);
+      const int x1 = tileX(tx + 1);
+      for (int ty = 0; ty < TY; ty++) {
+        if (activeTile[ty * TX + tx] == 0)
+          continue;
+        for (int iy = tileY(ty); iy < tileY(ty + 1); iy++) {
+          updateHxHyRow(iy, x0, x1, s);
+          if (iy >= 1 && iy < NY - 1)
+            updateEzRow(iy, x0, x1);
+        }
+      }
     }
+    if (diagnosticsOn) finishDiagnostics(sums, updateCounter);
+
+    updateBoundaryEz();
+    applySource();
+
+    source.updateTheta();
+    updateCounter++;
+  }
+
+  bool canRunParallel() const {
+    return pool.size() > 1 && kernel == fdtdKernelType::Tiled;
+  }
+
+  // Row strips, one per thread, and three phases per timestep separated by barriers:
+  // H of the strip; E of the strip with the x edges of its rows (row local);
+  // the y edges (first thread: bottom or periodic y, last thread: top) and the source,
+  // on the thread that did the edge closest to it. Bit-identical to update().
+  void advanceParallel(int nsteps) {
+    const int nt = pool.size();
+    const int isrc = sourceIndex();
+    const int srcRow = (isrc >= 0 ? isrc / NX : 0);
+    const int srcThread = (periodicAlongY || srcRow < NY / 2 ? 0 : nt - 1);
+    const int lastStep = updateCounter + nsteps - 1;
+    Sums partial[fdtdThreadPool::maxThreads];
+
+    auto job = [&](int t) {
+      const int r0 = (NY * t) / nt;
+      const int r1 = (NY * (t + 1)) / nt;
+      partial[t].clear();
+      for (int n = 0; n < nsteps; n++) {
+        Sums* s = (diagnosticsOn && n == nsteps - 1 ? &partial[t] : nullptr);
+        for (int iy = r0; iy < r1; iy++)
+          updateHxHyRow(iy, 0, NX, s);
+        pool.barrier();
+
+        updateERows(r0, r1);
+        pool.barrier();
+
+        if (t == 0) {
+          if (periodicAlongY)
+            makeEzPeriodicY();
+          else
+            updateEdgeBottom();
+        }
+        if (t == nt - 1)
+          updateEdgeTop();
+        if (t == srcThread)
+          applySourceRows(0, NY);
+        pool.barrier();
+
+        // nobody reads the counter (the Mur step parity) again before the next barrier
+        if (t == srcThread)
+          finishSteps(1);
+      }
+    };
+    pool.run(job);
+
+    if (diagnosticsOn) {
+      for (int t = 1; t < nt; t++) partial[0].add(partial[t]);
+      finishDiagnostics(partial[0], lastStep);
+    }
+  }
+
+  // E of the whole grid with its periodic seams, from the current H (no Mur edges, no source)
+  void updateEAll() {
+    for (int iy = 1; iy < NY - 1; iy++) {
+      updateEzRow(iy, 0, NX);
+      if (periodicAlongX) makeEzPeriodicXRow(iy);
+      else if (symmetryX == fdtdSymmetryType::EvenSymmetry) makeEzMirrorXRow(iy);
+    }
+    if (periodicAlongY) makeEzPeriodicY();
+    else if (symmetryY == fdtdSymmetryType::EvenSymmetry) makeEzMirrorY(0, NX);
+  }
+
+  // a <- b + a / 24 over the grid
+  void addCorrection(T* a,
+                     const T* b)
+  {
+    const T w = static_cast<T>(1.0 / 24.0);
+    for (int i = 0; i < size(); i++) a[i] = b[i] + w * a[i];
+  }
+
+  // One step of the fourth order integrator (see setIntegrator()), through the regular kernels
+  // pointed at other arrays: an H update of zero H from E is dt dH/dt, and an E update of zero E
+  // from that is dt^2 d^2E/dt^2 (the seams included, and nothing at PEC edges); same for H.
+  void updateFourthOrderInTime() {
+    T* const ez = Ez;
+    T* const hx = Hx;
+    T* const hy = Hy;
+    const size_t bytes = sizeof(T) * size();
+    T* a = scratch[0];
+    T* b = scratch[1];
+    T* c = scratch[2];
+
+    // b = E + (dt^2 / 24) E'' (through a, c = dt H' of E)
+    std::memset(a, 0, bytes);
+    std::memset(b, 0, bytes);
+    std::memset(c, 0, bytes);
+    Hx = a; Hy = c;
+    updateHRows(0, NY);
+    Ez = b;
+    updateEAll();
+    addCorrection(b, ez);
+
+    // H from the corrected E
+    Ez = b; Hx = hx; Hy = hy;
+    updateHRows(0, NY);
+
+    // a, b = H + (dt^2 / 24) H'' (through c = dt E' of H)
+    std::memset(a, 0, bytes);
+    std::memset(b, 0, bytes);
+    std::memset(c, 0, bytes);
+    Ez = c;
+    updateEAll();
+    Hx = a; Hy = b;
+    updateHRows(0, NY);
+    addCorrection(a, hx);
+    addCorrection(b, hy);
+
+    // E from the corrected H
+    Ez = ez;
+    updateEAll();
+    Hx = hx; Hy = hy;
+
+    applySourceRows(0, NY);
+    finishSteps(1);
   }
 
-  void halfbandFilterXY_(double* f) {
+  void halfbandFilterXY_(T* f) {
     // filter horizontally
     for (int iy = 0; iy < NY; iy++) {
       hbf.apply(Y, 1, &f[index(0, iy)], 1, NX);
-      std::memcpy(&f[index(0, iy)], Y, sizeof(double) * NX);
+      std::memcpy(&f[index(0, iy)], Y, sizeof(T) * NX);
     }
     // filter vertically
     for (int ix = 0; ix < NX; ix++) {
@@ -26,9 +26,11 @@ public:
       tail[i] = v;
   }
 
-  void apply(double* y,
+  // y and x may be float or double arrays; the filter itself runs in double
+  template <typename T>
+  void apply(T* y,
              int stridey,
-             const double* x,
+             const T* x,
              int stridex, 
              int L) const
   {
@@ -36,26 +38,27 @@ public:
       double s = 0.0;
       for (int n = -K; n < -i; n++) s += b[n + K] * head[n + K + i];
       for (int n = -i; n <= K; n++) s += b[n + K] * x[(n + i) * stridex];
-      y[i * stridey] = s;
+      y[i * stridey] = static_cast<T>(s);
     }
     for (int i = K; i < L - K; i++) {
       double s = 0.0;
       for (int n = -K; n <= K; n++) {
         s += b[n + K] * x[(n + i) * stridex];
       }
-      y[i * stridey] = s;
+      y[i * stridey] = static_cast<T>(s);
     }
     for (int i = L - K; i < L; i++) {
       double s = 0.0;
       for (int n = -K; n < L - i; n++) s += b[n + K] * x[(n + i) * stridex];
       for (int n = L - i; n <= K; n++)  s += b[n + K] * tail[n + i - L];
-      y[i * stridey] = s;
+      y[i * stridey] = static_cast<T>(s);
     }
   }
 
-  void applyPeriodic(double* y,
+  template <typename T>
+  void applyPeriodic(T* y,
                      int stridey,
-                     const double* x, 
+                     const T* x, 
                      int stridex, 
                      int L) 
   {
@@ -66,9 +69,10 @@ public:
     apply(y, stridey, x, stridex, L);
   }
 
-  void applyZero(double* y,
+  template <typename T>
+  void applyZero(T* y,
                  int stridey,
-                 const double* x,
+                 const T* x,
                  int stridex, 
                  int L)
   {
@@ -77,9 +81,10 @@ public:
     apply(y, stridey, x, stridex, L);
   }
 
-  void applyHold(double* y,
+  template <typename T>
+  void applyHold(T* y,
                  int stridey,
-                 const double* x,
+                 const T* x,
                  int stridex, 
                  int L)
   {
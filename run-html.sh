@@ -15,6 +15,11 @@ if [ $# -gt 2 ]; then
   echo "ignoring extra arguments to script"
 fi
 
+if [ ! -f payload/wasmem.wasm ]; then
+  echo "no payload/wasmem.wasm: run ./build.sh first"
+  exit 1
+fi
+
 cd payload
 
 if [ $browserName == "firefox" ]; then
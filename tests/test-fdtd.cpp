@@ -0,0 +1,2213 @@
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#define FDTD_THREADS
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "../halfband.hpp"
+#include "../rgb-utils.hpp"
+#include "../fdtd-arena.hpp"
+#include "../fdtd-simd.hpp"
+#include "../fdtd-threads.hpp"
+#include "../fdtd-constants.hpp"
+#include "../fdtd-source.hpp"
+#include "../fdtd-tmz.hpp"
+#include "../fdtd-raster.hpp"
+#include "../fdtd-subgrid.hpp"
+#include "../fdtd-bloch.hpp"
+#include "../fdtd-domain.hpp"
+#include "../fdtd-socket.hpp"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+// run two solvers through the same sequence of boundary/medium/source changes
+// and require bit-identical fields after every phase
+template <typename T>
+bool sameFields(const TMz::fdtdSolver<T>& a, 
+                const TMz::fdtdSolver<T>& b)
+{
+  const size_t bytes = sizeof(T) * a.size();
+  return std::memcmp(a.dataEz(), b.dataEz(), bytes) == 0 &&
+         std::memcmp(a.dataHx(), b.dataHx(), bytes) == 0 &&
+         std::memcmp(a.dataHy(), b.dataHy(), bytes) == 0;
+}
+
+template <typename T>
+bool compareScenario(TMz::fdtdSolver<T>& a, 
+                     TMz::fdtdSolver<T>& b,
+                     int steps)
+{
+  for (int phase = 0; phase < 5; phase++) {
+    switch (phase) {
+      case 1: a.setAbsorbingX(); b.setAbsorbingX(); break;
+      case 2: a.setAbsorbingY(); b.setAbsorbingY(); a.setDamping(10.0); b.setDamping(10.0); break;
+      case 3: a.setPECX(); b.setPECX(); a.sourceType(RickerPulse); b.sourceType(RickerPulse); break;
+      case 4: a.setPeriodicX(); b.setPECY(); a.setPECY(); b.setPeriodicX(); a.sourceMove(0.01, -0.003); b.sourceMove(0.01, -0.003); break;
+    }
+    for (int n = 0; n < steps; n++) {
+      a.update();
+      b.update();
+    }
+    if (!sameFields(a, b)) return false;
+  }
+  return true;
+}
+
+// same as compareScenario() but the second solver takes its steps in chunks with advance()
+template <typename T>
+bool compareAdvance(TMz::fdtdSolver<T>& a, 
+                    TMz::fdtdSolver<T>& b,
+                    int steps,
+                    int chunk)
+{
+  for (int n = 0; n < steps; n++) a.update();
+  for (int n = 0; n < steps; n += chunk) b.advance(n + chunk <= steps ? chunk : steps - n);
+  return sameFields(a, b) && a.getUpdateCount() == b.getUpdateCount();
+}
+
+// million cell updates per second (one cell update = Hx, Hy and Ez)
+template <typename T>
+double benchmark(TMz::fdtdSolver<T>& sim, 
+                 int steps)
+{
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int n = 0; n < steps; n++) sim.update();
+  const auto t1 = std::chrono::steady_clock::now();
+  const double seconds = std::chrono::duration<double>(t1 - t0).count();
+  return (static_cast<double>(sim.size()) * steps) / seconds * 1.0e-6;
+}
+
+template <typename T>
+double benchmarkAdvance(TMz::fdtdSolver<T>& sim, 
+                        int steps)
+{
+  const auto t0 = std::chrono::steady_clock::now();
+  sim.advance(steps);
+  const auto t1 = std::chrono::steady_clock::now();
+  const double seconds = std::chrono::duration<double>(t1 - t0).count();
+  return (static_cast<double>(sim.size()) * steps) / seconds * 1.0e-6;
+}
+
+template <typename T>
+bool testTiled(double delta)
+{
+  const int dims[3][2] = { {300, 175}, {97, 61}, {600, 40} };
+  const int widths[3] = { 8, 37, 256 };
+  for (int k = 0; k < 3; k++) {
+    const int nx = dims[k][0];
+    const int ny = dims[k][1];
+    TMz::fdtdSolver<T> ref;
+    TMz::fdtdSolver<T> sim;
+    ref.initialize(nx, ny, -0.5 * delta * nx, -0.5 * delta * ny, delta);
+    sim.initialize(nx, ny, -0.5 * delta * nx, -0.5 * delta * ny, delta);
+    ref.setKernel(TMz::fdtdKernelType::Reference);
+    sim.setKernel(TMz::fdtdKernelType::Tiled);
+    sim.setTileWidth(widths[k]);
+    ref.sourcePlace(0.0, 0.0);
+    sim.sourcePlace(0.0, 0.0);
+    if (!compareScenario(ref, sim, 150)) return false;
+  }
+  return true;
+}
+
+template <typename T>
+bool testAdvance(double delta)
+{
+  const int nx = 150;
+  const int ny = 97;
+  const double src[6][2] = { {0.0, 0.0}, {0.0, 0.0}, {1.0, 0.0}, {2.0, 1.0}, {0.5, ny - 3.0}, {nx - 1.0, ny - 1.0} }; // in cells
+  for (int bc = 0; bc < 6; bc++) {
+    for (int j = 0; j < 6; j++) {
+      TMz::fdtdSolver<T> ref;
+      TMz::fdtdSolver<T> sim;
+      ref.initialize(nx, ny, 0.0, 0.0, delta);
+      sim.initialize(nx, ny, 0.0, 0.0, delta);
+      sim.setTileWidth(j % 2 == 0 ? 24 : 256);
+      sim.setTemporalDepth(j % 3 == 0 ? 5 : 8);
+      TMz::fdtdSolver<T>* both[2] = { &ref, &sim };
+      for (int i = 0; i < 2; i++) {
+        TMz::fdtdSolver<T>& s = *both[i];
+        if (j == 0) s.sourcePlace(nx * delta / 2.0, ny * delta / 2.0);
+          else s.sourcePlace(src[j][0] * delta, src[j][1] * delta);
+        if (j == 3) s.sourceAdditive(true);
+        if (j == 4) s.sourceType(RickerPulse);
+        if (bc == 0 || bc == 3) s.setAbsorbingX();
+        if (bc == 1 || bc == 3) s.setAbsorbingY();
+        if (bc == 2) { s.setPECX(); s.setAbsorbingY(); }
+        if (bc == 4) { s.setPECX(); s.setPECY(); }
+        if (bc == 5) { s.setAbsorbingX(); s.setPECY(); s.setDamping(20.0); }
+      }
+      if (!compareAdvance(ref, sim, 211, 37)) return false;
+    }
+  }
+  // a last column strip of one or two columns, which the right Mur edge reads past
+  for (int extra = 1; extra <= 2; extra++) {
+    TMz::fdtdSolver<T> ref;
+    TMz::fdtdSolver<T> sim;
+    ref.initialize(24 + extra, 60, 0.0, 0.0, delta);
+    sim.initialize(24 + extra, 60, 0.0, 0.0, delta);
+    sim.setTileWidth(24);
+    sim.setTemporalDepth(8);
+    TMz::fdtdSolver<T>* both[2] = { &ref, &sim };
+    for (int i = 0; i < 2; i++) {
+      both[i]->sourcePlace(10.0 * delta, 30.0 * delta);
+      both[i]->setAbsorbingX();
+      both[i]->setPECY(); // (periodic y is not blocked)
+    }
+    if (!compareAdvance(ref, sim, 211, 37)) return false;
+  }
+  return true;
+}
+
+// a dielectric slab and a lossy block painted into the grid;
+// reference, tiled and temporally blocked updates must agree bit for bit
+template <typename T>
+bool testMaterials(double delta)
+{
+  const int nx = 173;
+  const int ny = 101;
+  TMz::fdtdSolver<T> sims[3];
+  for (int i = 0; i < 3; i++) {
+    TMz::fdtdSolver<T>& s = sims[i];
+    s.initialize(nx, ny, 0.0, 0.0, delta);
+    s.setKernel(i == 0 ? TMz::fdtdKernelType::Reference : TMz::fdtdKernelType::Tiled);
+    s.setTileWidth(29);
+    s.setAbsorbingX();
+    s.setAbsorbingY();
+    s.sourcePlace(40.0 * delta, 50.0 * delta);
+    const int glass = s.defineMaterial(1.0, 4.0, 0.0, 0.0);
+    const int lossy = s.defineMaterial(1.5, 2.0, 0.0, 50.0);
+    if (glass != 1 || lossy != 2) return false;
+    if (s.getMediumType() != TMz::LosslessMedium) return false;
+    s.paintMaterial(glass, 80, 0, 95, ny);
+    s.paintMaterial(lossy, 120, 30, 300, 61);
+    if (s.getMaterial(81, 10) != glass || s.getMaterial(172, 60) != lossy || s.isVacuum()) return false;
+    if (s.getMediumType() != TMz::PerCellMedium) return false;
+  }
+  for (int n = 0; n < 300; n++) {
+    sims[0].update();
+    sims[1].update();
+  }
+  sims[2].advance(300);
+  return sameFields(sims[0], sims[1]) && sameFields(sims[0], sims[2]) && sims[0].energyE() > 0.0;
+}
+
+// the threaded update must match the serial one for any thread count and boundary setup
+template <typename T>
+bool testThreads(double delta)
+{
+  const int nx = 141;
+  const int ny = 89;
+  const int threads[4] = { 2, 3, 4, 7 };
+  for (int bc = 0; bc < 6; bc++) {
+    for (int j = 0; j < 4; j++) {
+      TMz::fdtdSolver<T> ref;
+      TMz::fdtdSolver<T> sim;
+      ref.initialize(nx, ny, 0.0, 0.0, delta);
+      sim.initialize(nx, ny, 0.0, 0.0, delta);
+      if (sim.setThreads(threads[j]) != threads[j]) return false;
+      TMz::fdtdSolver<T>* both[2] = { &ref, &sim };
+      for (int i = 0; i < 2; i++) {
+        TMz::fdtdSolver<T>& s = *both[i];
+        s.sourcePlace((j % 2 == 0 ? 30.0 : 70.0) * delta, (j < 2 ? 20.0 : ny - 2.0) * delta);
+        if (bc == 0 || bc == 3) s.setAbsorbingX();
+        if (bc == 1 || bc == 3) s.setAbsorbingY();
+        if (bc == 2) { s.setPECX(); s.setAbsorbingY(); }
+        if (bc == 4) { s.setPECX(); s.setPECY(); }
+        if (bc == 5) { s.setAbsorbingX(); s.setPECY(); s.paintMaterial(s.defineMaterial(1.0, 3.0, 0.0, 20.0), 50, 10, 90, 60); }
+      }
+      for (int n = 0; n < 50; n++) {
+        ref.update();
+        sim.update();
+      }
+      if (!sameFields(ref, sim)) return false;
+      if (!compareAdvance(ref, sim, 173, 41)) return false;
+    }
+  }
+  return true;
+}
+
+// CPML in combination with the other edge types; reference, tiled, blocked and threaded
+// updates must agree bit for bit
+template <typename T>
+bool testCPML(double delta)
+{
+  const int nx = 131;
+  const int ny = 87;
+  for (int c = 0; c < 4; c++) {
+    TMz::fdtdSolver<T> sims[4];
+    for (int i = 0; i < 4; i++) {
+      TMz::fdtdSolver<T>& s = sims[i];
+      s.initialize(nx, ny, 0.0, 0.0, delta);
+      s.setKernel(i == 0 ? TMz::fdtdKernelType::Reference : TMz::fdtdKernelType::Tiled);
+      s.setTileWidth(23);
+      s.setCPMLThickness(c == 1 ? 7 : 12);
+      if (i == 3) s.setThreads(3);
+      s.sourcePlace(20.0 * delta, 15.0 * delta);
+      s.sourceType(RickerPulse);
+      if (c == 0) { if (!s.setCPMLX() || !s.setCPMLY()) return false; }
+      if (c == 1) { s.setAbsorbingY(); if (!s.setCPMLX()) return false; }
+      if (c == 2) { s.setPeriodicY(); if (!s.setCPMLX()) return false; }
+      if (c == 3) { s.setPeriodicX(); if (!s.setCPMLY()) return false; }
+      s.paintMaterial(s.defineMaterial(1.0, 2.0, 0.0, 10.0), 0, 40, 60, 60);
+    }
+    for (int n = 0; n < 240; n++) {
+      sims[0].update();
+      sims[1].update();
+    }
+    sims[2].advance(240);
+    sims[3].advance(240);
+    for (int i = 1; i < 4; i++)
+      if (!sameFields(sims[0], sims[i])) return false;
+  }
+  return true;
+}
+
+// updates with activity tracking (the default) against the full grid, from a point source in a
+// grid that is mostly quiescent; wherever the source and the edges are
+template <typename T>
+bool testActivity(double delta)
+{
+  const int nx = 410;
+  const int ny = 263;
+  const double src[5][2] = { {205.0, 130.0}, {100.0, 60.0}, {300.0, 200.0}, {1.0, 2.0}, {409.0, 131.0} }; // in cells
+  for (int c = 0; c < 5; c++) {
+    TMz::fdtdSolver<T> ref;
+    TMz::fdtdSolver<T> sim;
+    ref.initialize(nx, ny, 0.0, 0.0, delta);
+    sim.initialize(nx, ny, 0.0, 0.0, delta);
+    ref.setActivityTracking(false);
+    if (!sim.isActivityTracking()) return false;
+    TMz::fdtdSolver<T>* both[2] = { &ref, &sim };
+    for (int i = 0; i < 2; i++) {
+      TMz::fdtdSolver<T>& s = *both[i];
+      s.sourcePlace(src[c][0] * delta, src[c][1] * delta);
+      if (c == 1) { s.setAbsorbingX(); s.setAbsorbingY(); }
+      if (c == 2) { s.setCPMLX(); s.setCPMLY(); s.sourceType(RickerPulse); }
+      if (c == 3) { s.setAbsorbingY(); s.paintMaterial(s.defineMaterial(1.0, 4.0, 0.0, 30.0), 0, 0, 40, 30); }
+      if (c == 4) { s.setPECX(); s.setPECY(); s.sourceAdditive(true); }
+    }
+    for (int n = 0; n < 20; n++) {
+      ref.update();
+      sim.update();
+    }
+    if (!sameFields(ref, sim) || !(sim.getActiveFraction() < 0.1)) return false;
+    for (int n = 0; n < 250; n++) {
+      ref.update();
+      sim.update();
+      if (n % 50 == 0 && !sameFields(ref, sim)) return false;
+    }
+    ref.advance(300);
+    sim.advance(300);
+    if (!sameFields(ref, sim) || sim.getActiveFraction() != 1.0) return false;
+  }
+  return true;
+}
+
+// the (2,4) stencil: reference, tiled, advance() and threaded updates must agree bit for bit,
+// with any edges, CPML layers and materials (and switching back and forth keeps them in step)
+template <typename T>
+bool testStencil(double delta)
+{
+  const int nx = 127;
+  const int ny = 93;
+  for (int c = 0; c < 5; c++) {
+    TMz::fdtdSolver<T> sims[4];
+    for (int i = 0; i < 4; i++) {
+      TMz::fdtdSolver<T>& s = sims[i];
+      s.initialize(nx, ny, 0.0, 0.0, delta);
+      s.setKernel(i == 0 ? TMz::fdtdKernelType::Reference : TMz::fdtdKernelType::Tiled);
+      s.setTileWidth(19);
+      if (i == 3) s.setThreads(3);
+      s.setStencil(TMz::fdtdStencilType::FourthOrder);
+      if (s.getCourant() != courant_factor_24) return false;
+      s.sourcePlace(30.0 * delta, 25.0 * delta);
+      if (c == 0) { s.setAbsorbingX(); s.setAbsorbingY(); }
+      if (c == 1) { s.setCPMLX(); s.setCPMLY(); s.sourceType(RickerPulse); }
+      if (c == 2) { s.setPeriodicY(); s.setCPMLX(); }
+      if (c == 3) { s.setPECX(); s.setAbsorbingY(); s.paintMaterial(s.defineMaterial(1.0, 4.0, 0.0, 30.0), 60, 0, 80, 70); }
+      if (c == 4) { s.setAbsorbingX(); s.setDamping(15.0); s.sourceType(RickerPulse); }
+    }
+    for (int n = 0; n < 200; n++) {
+      sims[0].update();
+      sims[1].update();
+    }
+    sims[2].advance(200);
+    sims[3].advance(200);
+    for (int i = 1; i < 4; i++)
+      if (!sameFields(sims[0], sims[i])) return false;
+    for (int i = 0; i < 4; i++) {
+      sims[i].setStencil(TMz::fdtdStencilType::SecondOrder);
+      sims[i].advance(50);
+      sims[i].setStencil(TMz::fdtdStencilType::FourthOrder);
+      sims[i].advance(50);
+    }
+    for (int i = 1; i < 4; i++)
+      if (!sameFields(sims[0], sims[i])) return false;
+    if (!(sims[0].energyE() > 0.0) || !std::isfinite(sims[0].energyE())) return false;
+  }
+  return true;
+}
+
+// Frequency of the (m, n) standing mode of a square PEC box relative to the exact one, from the
+// zero crossings of the projection of Ez onto the mode shape (started from Ez only);
+// courant 0 keeps the default of the stencil
+double modeFrequencyError(double delta, 
+                          TMz::fdtdStencilType stencil,
+                          int m,
+                          int n,
+                          TMz::fdtdIntegratorType integrator = TMz::fdtdIntegratorType::Leapfrog,
+                          double courant = 0.0)
+{
+  const int N = 121;
+  TMz::fdtdSolver<double> sim;
+  sim.initialize(N, N, 0.0, 0.0, delta);
+  sim.sourceType(NoSource);
+  sim.setPECX();
+  sim.setPECY();
+  sim.setStencil(stencil);
+  if (!sim.setIntegrator(integrator)) return 1.0;
+  if (courant > 0.0 && !sim.setCourant(courant)) return 1.0;
+  std::vector<double> shape(N * N);
+  for (int iy = 0; iy < N; iy++) {
+    double* ez = sim.rowEz(iy);
+    for (int ix = 0; ix < N; ix++) {
+      shape[iy * N + ix] = std::sin(M_PI * m * ix / (N - 1)) * std::sin(M_PI * n * iy / (N - 1));
+      ez[ix] = shape[iy * N + ix];
+    }
+  }
+  double previous = 1.0;
+  double first = -1.0;
+  double last = -1.0;
+  int crossings = 0;
+  for (int k = 1; k <= 2000; k++) {
+    sim.update();
+    double a = 0.0;
+    for (int i = 0; i < N * N; i++) a += shape[i] * sim.dataEz()[i];
+    if ((a < 0.0) != (previous < 0.0)) {
+      const double t = k - a / (a - previous);
+      if (crossings == 0) first = t;
+      last = t;
+      crossings++;
+    }
+    previous = a;
+  }
+  const double omega = M_PI * (crossings - 1) / ((last - first) * sim.getTimestep());
+  const double exact = M_PI * vacuum_velocity * std::sqrt(static_cast<double>(m * m + n * n)) / ((N - 1) * delta);
+  return omega / exact - 1.0;
+}
+
+// dispersion of the two stencils along an axis and the diagonal, near 20 and 10 points per wavelength:
+// (2,4) at 10 must be within the worst error of (2,2) at 20 (which is along the axis; Yee at its
+// Courant limit is nearly exact on the diagonal) and much less anisotropic than (2,2) at 10
+bool dispersionReport(double delta)
+{
+  const int modes[4][2] = { {12, 1}, {9, 8}, {24, 1}, {17, 17} };
+  double err[2][4];
+  std::cout << std::scientific << std::setprecision(3);
+  for (int j = 0; j < 4; j++) {
+    const double ppw = 2.0 * 120 / std::sqrt(static_cast<double>(modes[j][0] * modes[j][0] + modes[j][1] * modes[j][1]));
+    err[0][j] = modeFrequencyError(delta, TMz::fdtdStencilType::SecondOrder, modes[j][0], modes[j][1]);
+    err[1][j] = modeFrequencyError(delta, TMz::fdtdStencilType::FourthOrder, modes[j][0], modes[j][1]);
+    std::cout << "mode (" << modes[j][0] << ", " << modes[j][1] << "), " << std::setprecision(1) << std::fixed << ppw 
+              << " ppw: frequency error (2,2) " << std::scientific << std::setprecision(3) << err[0][j] 
+              << ", (2,4) " << err[1][j] << std::endl;
+  }
+  const double worst2 = std::max(std::fabs(err[0][0]), std::fabs(err[0][1]));
+  const double worst4 = std::max(std::fabs(err[1][2]), std::fabs(err[1][3]));
+  std::cout << "worst frequency error: (2,2) at 20 ppw " << worst2 << ", (2,4) at 10 ppw " << worst4 << std::endl;
+  const double spread2 = std::fabs(err[0][2] - err[0][3]);
+  const double spread4 = std::fabs(err[1][2] - err[1][3]);
+  return worst4 <= worst2 && spread4 < 0.2 * spread2;
+}
+
+// the fourth order time integrator: its API and edge rules, and all kernels, advance() and threads
+// agreeing bit for bit with it (it has one code path) and after switching back to the leapfrog
+template <typename T>
+bool testIntegrator(double delta)
+{
+  const int nx = 101;
+  const int ny = 77;
+  {
+    TMz::fdtdSolver<T> s;
+    s.initialize(nx, ny, 0.0, 0.0, delta);
+    if (s.getStabilityLimit() != courant_limit || s.setCourant(0.75) || s.setCourant(0.0)) return false;
+    if (!s.setCourant(0.5) || s.getCourant() != 0.5) return false;
+    s.setAbsorbingX();
+    if (s.setIntegrator(TMz::fdtdIntegratorType::FourthOrderInTime)) return false;
+    s.setPECX();
+    s.setCPMLY();
+    if (s.setIntegrator(TMz::fdtdIntegratorType::FourthOrderInTime)) return false;
+    s.setPECY();
+    s.setStencil(TMz::fdtdStencilType::FourthOrder);
+    if (s.setIntegrator(TMz::fdtdIntegratorType::FourthOrderInTime)) return false;
+    s.setStencil(TMz::fdtdStencilType::SecondOrder);
+    if (!s.setIntegrator(TMz::fdtdIntegratorType::FourthOrderInTime)) return false;
+    if (s.getStabilityLimit() != courant_limit_t4 || s.setCourant(1.01 * courant_limit_t4) || !s.setCourant(1.7)) return false;
+    s.setStencil(TMz::fdtdStencilType::FourthOrder);
+    if (s.getStencil() != TMz::fdtdStencilType::SecondOrder) return false;
+    // Mur edges go back to the leapfrog (and a stable Courant number)
+    s.setAbsorbingY();
+    if (s.getIntegrator() != TMz::fdtdIntegratorType::Leapfrog || s.getCourant() != courant_factor) return false;
+  }
+  for (int c = 0; c < 3; c++) {
+    TMz::fdtdSolver<T> sims[4];
+    for (int i = 0; i < 4; i++) {
+      TMz::fdtdSolver<T>& s = sims[i];
+      s.initialize(nx, ny, 0.0, 0.0, delta);
+      s.setKernel(i == 0 ? TMz::fdtdKernelType::Reference : TMz::fdtdKernelType::Tiled);
+      s.setTileWidth(19);
+      if (i == 3) s.setThreads(3);
+      s.sourcePlace(30.0 * delta, 25.0 * delta);
+      if (c == 0) { s.setPECX(); s.setPECY(); s.paintMaterial(s.defineMaterial(1.0, 4.0, 0.0, 30.0), 60, 0, 80, 50); }
+      if (c == 1) { s.setPeriodicX(); s.setPECY(); s.sourceType(RickerPulse); s.sourceAdditive(true); }
+      if (c == 2) { s.setPeriodicX(); s.setPeriodicY(); s.paintMaterial(s.defineMaterial(2.0, 3.0, 0.0, 0.0), 10, 40, 50, 60); }
+      if (!s.setIntegrator(TMz::fdtdIntegratorType::FourthOrderInTime) || !s.setCourant(1.6)) return false;
+    }
+    for (int n = 0; n < 150; n++) {
+      sims[0].update();
+      sims[1].update();
+    }
+    sims[2].advance(150);
+    sims[3].advance(150);
+    for (int i = 1; i < 4; i++)
+      if (!sameFields(sims[0], sims[i])) return false;
+    for (int i = 0; i < 4; i++) {
+      sims[i].setIntegrator(TMz::fdtdIntegratorType::Leapfrog);
+      if (sims[i].getCourant() != courant_factor) return false;
+      sims[i].advance(50);
+      sims[i].setIntegrator(TMz::fdtdIntegratorType::FourthOrderInTime);
+      sims[i].advance(50);
+    }
+    for (int i = 1; i < 4; i++)
+      if (!sameFields(sims[0], sims[i])) return false;
+    if (!(sims[0].energyE() > 0.0) || !std::isfinite(sims[0].energyE())) return false;
+  }
+  return true;
+}
+
+// one step, returning the leapfrog energy of the level it starts from (as fdtdDiagnostics:
+// epr Ez^2 at n and mur H at n - 1/2 times H at n + 1/2, here for a PEC box)
+double stepLeapfrogEnergy(TMz::fdtdSolver<double>& sim)
+{
+  const int nx = sim.getNX();
+  const int ny = sim.getNY();
+  std::vector<double> hx(sim.dataHx(), sim.dataHx() + sim.size());
+  std::vector<double> hy(sim.dataHy(), sim.dataHy() + sim.size());
+  double ee = 0.0;
+  for (int i = 0; i < sim.size(); i++)
+    ee += sim.getMaterialProperties(sim.getMaterial(i % nx, i / nx)).epr * sim.dataEz()[i] * sim.dataEz()[i];
+  sim.update();
+  double hh = 0.0;
+  for (int iy = 0; iy < ny; iy++) {
+    for (int ix = 0; ix < nx; ix++) {
+      const int i = iy * nx + ix;
+      const double w = sim.getMaterialProperties(sim.getMaterial(ix, iy)).mur;
+      if (iy < ny - 1) hh += w * hx[i] * sim.dataHx()[i];
+      if (ix < nx - 1) hh += w * hy[i] * sim.dataHy()[i];
+    }
+  }
+  return vacuum_permittivity * ee + vacuum_permeability * hh;
+}
+
+// Relative range of the leapfrog energy of a lossless PEC box (with a glass inclusion) under the
+// fourth order integrator at Courant number courant, in a background of relative permittivity epr
+void integratorEnergyRange(double delta,
+                           double courant,
+                           double epr,
+                           int steps,
+                           double& lo,
+                           double& hi)
+{
+  TMz::fdtdSolver<double> sim;
+  sim.initialize(64, 48, 0.0, 0.0, delta);
+  sim.sourceType(NoSource);
+  sim.setPECX();
+  sim.setPECY();
+  sim.setUniformMedium(1.0, epr, 0.0, 0.0);
+  sim.paintMaterial(sim.defineMaterial(1.0, 2.5, 0.0, 0.0), 20, 10, 40, 30);
+  lo = hi = 0.0;
+  if (!sim.setIntegrator(TMz::fdtdIntegratorType::FourthOrderInTime) || !sim.setCourant(courant)) { hi = 1.0; return; }
+  sim.superimposeGaussian(20.0, 20.0, 2.0, 2.0);
+  const double U0 = stepLeapfrogEnergy(sim);
+  for (int n = 1; n < steps; n++) {
+    const double U = (n % 10 == 0 ? stepLeapfrogEnergy(sim) / U0 - 1.0 : (sim.update(), 0.0));
+    if (!std::isfinite(U)) { hi = U; return; }
+    if (U < lo) lo = U;
+    if (U > hi) hi = U;
+  }
+}
+
+// Just below the Courant limit of the fourth order integrator its energy is conserved to rounding;
+// just above it (reached through a background with epr < 1, which the limit does not cover, as
+// the Courant number itself is refused) the fields blow up
+bool integratorStability(double delta)
+{
+  const double below = 0.99 * courant_limit_t4;
+  double lo = 0.0;
+  double hi = 0.0;
+  integratorEnergyRange(delta, below, 1.0, 20000, lo, hi);
+  std::cout << std::scientific << std::setprecision(3);
+  std::cout << "fourth order integrator at S = " << below << ", 20000 steps: energy within [" << lo << ", " << hi << "] of the start" << std::endl;
+  if (!(lo > -1.0e-12 && hi < 1.0e-12)) return false;
+
+  const double epr = (0.99 / 1.02) * (0.99 / 1.02); // an effective Courant number of 1.02 times the limit
+  integratorEnergyRange(delta, below, epr, 2000, lo, hi);
+  std::cout << "at 1.02 times the limit, 2000 steps: energy up to " << hi << " above the start" << std::endl;
+  return !(hi < 1.0e6);
+}
+
+// Measured mode frequencies against the dispersion relation of the integrators on the Yee grid:
+// sin(w dt / 2) = sqrt(f(L)) / 2 with L = 4 S^2 (sin^2(kx / 2) + sin^2(ky / 2)), f(L) = L for the
+// leapfrog and L (1 - L / 24)^2 for the fourth order one; the time error is that against sqrt(L)
+bool integratorDispersion(double delta)
+{
+  const int modes[2][2] = { {12, 1}, {17, 17} };
+  const double S[2] = { courant_factor, 1.5 };
+  const TMz::fdtdIntegratorType types[2] = { TMz::fdtdIntegratorType::Leapfrog, TMz::fdtdIntegratorType::FourthOrderInTime };
+  double timeError[2][2];
+  std::cout << std::scientific << std::setprecision(3);
+  for (int j = 0; j < 2; j++) {
+    const int m = modes[j][0];
+    const int n = modes[j][1];
+    for (int i = 0; i < 2; i++) {
+      const double sx = std::sin(M_PI * m / 240.0);
+      const double sy = std::sin(M_PI * n / 240.0);
+      const double L = 4.0 * S[i] * S[i] * (sx * sx + sy * sy);
+      const double f = (i == 0 ? L : L * (1.0 - L / 24.0) * (1.0 - L / 24.0));
+      const double wdt = 2.0 * std::asin(std::sqrt(f) / 2.0);
+      const double exact = M_PI * S[i] * std::sqrt(static_cast<double>(m * m + n * n)) / 120.0;
+      const double measured = modeFrequencyError(delta, TMz::fdtdStencilType::SecondOrder, m, n, types[i], S[i]);
+      const double predicted = wdt / exact - 1.0;
+      timeError[j][i] = wdt / std::sqrt(L) - 1.0;
+      std::cout << "mode (" << m << ", " << n << "), " << (i == 0 ? "leapfrog" : "fourth order") << " at S = " << std::fixed << std::setprecision(3) << S[i]
+                << ": frequency error " << std::scientific << measured << " (predicted " << predicted << "), time error " << timeError[j][i] << std::endl;
+      if (!(std::fabs(measured - predicted) < 1.0e-4)) return false;
+    }
+    if (!(std::fabs(timeError[j][1]) < 0.1 * std::fabs(timeError[j][0]))) return false;
+  }
+  return true;
+}
+
+// Symmetry planes: a case is the parity of the x and y planes (0: no y plane) and the type of
+// the edges across from them (0 PEC, 1 Mur, 2 CPML, 3 periodic y), with or without a source on the planes
+struct SymmetryCase
+{
+  int px;
+  int py;
+  int xedge;
+  int yedge;
+  bool source;
+};
+
+const SymmetryCase symmetryCases[8] = {
+  { 1, 0, 0, 0, true }, { -1, 0, 0, 3, false }, { 1, 0, 2, 2, true }, { 1, 1, 0, 0, true },
+  { -1, 1, 1, 1, false }, { 1, -1, 2, 2, false }, { 1, 1, 1, 1, true }, { 1, 0, 1, 3, true } };
+
+// f(-u) = parity f(u) exactly (for parity 0 a plain bump)
+double parityBump(double u,
+                  double a,
+                  int parity)
+{
+  const double g = std::exp(-(u - a) * (u - a) / 20.0);
+  return (parity == 0 ? g : g + parity * std::exp(-(u + a) * (u + a) / 20.0));
+}
+
+// Whole grid (mirror = false, centered on the planes) or the part of it on the upper side of the
+// planes (mirror = true, with the planes set), started from the same field of the case's parity
+template <typename T>
+void setupSymmetryCase(TMz::fdtdSolver<T>& s,
+                       const SymmetryCase& c,
+                       bool mirror,
+                       double delta)
+{
+  const int m = 60;
+  const int n = (c.py == 0 ? 50 : 45);
+  const int nx = (mirror ? m : 2 * m - 1);
+  const int ny = (mirror || c.py == 0 ? n : 2 * n - 1);
+  const int cx = (mirror ? 0 : m - 1);
+  const int cy = (mirror || c.py == 0 ? 0 : n - 1);
+  s.initialize(nx, ny, -cx * delta, -cy * delta, delta);
+  s.sourceType(NoSource);
+  if (c.source) {
+    s.sourceType(c.xedge == 2 ? RickerPulse : Monochromatic);
+    s.sourceAdditive(c.xedge == 2);
+    s.sourcePlace(0.0, (c.py == 0 ? 20.0 : 0.0) * delta);
+  }
+  if (c.xedge == 0) s.setPECX();
+  if (c.xedge == 1) s.setAbsorbingX();
+  if (c.xedge == 2) s.setCPMLX();
+  if (c.yedge == 0) s.setPECY();
+  if (c.yedge == 1) s.setAbsorbingY();
+  if (c.yedge == 2) s.setCPMLY();
+  if (c.yedge == 3) s.setPeriodicY();
+  if (mirror) {
+    s.setSymmetryX(c.px > 0 ? TMz::fdtdSymmetryType::EvenSymmetry : TMz::fdtdSymmetryType::OddSymmetry);
+    if (c.py != 0) s.setSymmetryY(c.py > 0 ? TMz::fdtdSymmetryType::EvenSymmetry : TMz::fdtdSymmetryType::OddSymmetry);
+  }
+  for (int iy = 0; iy < ny; iy++) {
+    const double fy = parityBump(iy - cy, 9.0, c.py);
+    T* ez = s.rowEz(iy);
+    for (int ix = 0; ix < nx; ix++) ez[ix] = static_cast<T>(parityBump(ix - cx, 7.0, c.px) * fy);
+  }
+}
+
+// The half (quarter) grid steps like the upper part of the whole grid: on a mirror image the whole
+// grid does the same operations (up to rounding where the absorbing layers overlap)
+bool symmetryEquivalence(double delta)
+{
+  std::cout << std::scientific << std::setprecision(3);
+  for (int k = 0; k < 8; k++) {
+    const SymmetryCase& c = symmetryCases[k];
+    TMz::fdtdSolver<double> whole;
+    TMz::fdtdSolver<double> part;
+    setupSymmetryCase(whole, c, false, delta);
+    setupSymmetryCase(part, c, true, delta);
+    whole.advance(400);
+    part.advance(400);
+    const int cx = whole.getNX() - part.getNX();
+    const int cy = whole.getNY() - part.getNY();
+    double peak = 0.0;
+    double diff = 0.0;
+    for (int iy = 0; iy < part.getNY(); iy++) {
+      for (int ix = 0; ix < part.getNX(); ix++) {
+        const int i = part.getNX() * iy + ix;
+        const int j = whole.getNX() * (iy + cy) + ix + cx;
+        diff = std::max(diff, std::fabs(part.dataEz()[i] - whole.dataEz()[j]));
+        diff = std::max(diff, std::fabs(part.dataHx()[i] - whole.dataHx()[j]));
+        diff = std::max(diff, std::fabs(part.dataHy()[i] - whole.dataHy()[j]));
+        peak = std::max(peak, std::fabs(part.dataEz()[i]));
+      }
+    }
+    if (!(peak > 1.0e-6) || !(diff <= 1.0e-12)) { // the fields start at order one
+      std::cout << "case " << k << ": max difference " << diff << " (peak " << peak << ")" << std::endl;
+      return false;
+    }
+
+    // the unfolded image of the part is (nearly) the image of the whole
+    const int w = 240;
+    const int h = 160;
+    std::vector<uint32_t> a(w * h);
+    std::vector<uint32_t> b(w * h);
+    const double d = 1.0e-8 * delta;
+    whole.rasterizeEz(a.data(), w, h, true, -0.5, 0.5, whole.getXmin(), whole.getXmax() - d, whole.getYmin(), whole.getYmax() - d);
+    part.rasterizeEz(b.data(), w, h, true, -0.5, 0.5, part.getImageXmin(), part.getXmax() - d, part.getImageYmin(), part.getYmax() - d);
+    if (part.getImageXmin() != whole.getXmin()) return false;
+    int same = 0;
+    for (int i = 0; i < w * h; i++) same += (a[i] == b[i]);
+    if (!(same > 0.99 * w * h)) {
+      std::cout << "case " << k << ": " << same << " of " << w * h << " pixels agree" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// A doubly periodic grid is a lattice with no special point: moving the source by (dx, dy) nodes
+// moves the fields by as much (modulo the periods), also across the corner where both seams meet,
+// and the four corner nodes are one node of the lattice (a corner held at zero would be a PEC post)
+bool periodicCorners(double delta)
+{
+  const int nx = 37;
+  const int ny = 29;
+  const int dx = 20;
+  const int dy = 15;
+  TMz::fdtdSolver<double> s[2];
+  for (int i = 0; i < 2; i++) {
+    s[i].initialize(nx, ny, 0.0, 0.0, delta);
+    s[i].sourceType(RickerPulse);
+    s[i].sourceAdditive(true);
+    s[i].sourcePlace((9 + i * dx) * delta, (7 + i * dy) * delta);
+    s[i].advance(150);
+  }
+  const double* a = s[0].dataEz();
+  const double* b = s[1].dataEz();
+  double peak = 0.0;
+  double worst = 0.0;
+  for (int iy = 0; iy < ny - 1; iy++) {
+    for (int ix = 0; ix < nx - 1; ix++) {
+      const int j = nx * ((iy + dy) % (ny - 1)) + (ix + dx) % (nx - 1);
+      peak = std::max(peak, std::fabs(a[nx * iy + ix]));
+      worst = std::max(worst, std::fabs(b[j] - a[nx * iy + ix]));
+    }
+  }
+  const int last = nx * ny - 1;
+  return worst < 1.0e-12 * peak && std::fabs(a[0]) > 1.0e-6 * peak &&
+         a[nx - 1] == a[0] && a[last - nx + 1] == a[0] && a[last] == a[0];
+}
+
+// the same cases on the part grids: all kernels, advance(), threads and activity tracking agree
+template <typename T>
+bool testSymmetry(double delta)
+{
+  for (int k = 0; k < 8; k++) {
+    TMz::fdtdSolver<T> sims[4];
+    for (int i = 0; i < 4; i++) {
+      setupSymmetryCase(sims[i], symmetryCases[k], true, delta);
+      sims[i].setKernel(i == 0 ? TMz::fdtdKernelType::Reference : TMz::fdtdKernelType::Tiled);
+      sims[i].setTileWidth(13);
+      if (i == 3) sims[i].setThreads(3);
+    }
+    // from zero fields (when there is a source), so that tracking is in effect
+    if (symmetryCases[k].source)
+      for (int i = 0; i < 4; i++) sims[i].reset();
+    for (int n = 0; n < 150; n++) {
+      sims[0].update();
+      sims[1].update();
+    }
+    sims[2].advance(150);
+    sims[3].advance(150);
+    for (int i = 1; i < 4; i++)
+      if (!sameFields(sims[0], sims[i])) return false;
+    if (!(sims[0].energyE() > 0.0) || !std::isfinite(sims[0].energyE())) return false;
+  }
+
+  // the planes go with periodic edges, and an odd plane holds zero
+  TMz::fdtdSolver<T> s;
+  s.initialize(64, 48, 0.0, 0.0, delta);
+  s.setSymmetryX(TMz::fdtdSymmetryType::OddSymmetry);
+  s.setSymmetryY(TMz::fdtdSymmetryType::EvenSymmetry);
+  if (s.isPeriodicX() || s.isPeriodicY() || s.getImageXmin() != -s.getXmax()) return false;
+  s.sourcePlace(20.0 * delta, 0.0);
+  s.advance(100);
+  for (int iy = 0; iy < 48; iy++)
+    if (s.rowEz(iy)[0] != 0) return false;
+  if (!(std::fabs(s.rowEz(0)[20]) > 0)) return false;
+  s.setPeriodicX();
+  s.setPeriodicY();
+  return s.getSymmetryX() == TMz::fdtdSymmetryType::NoSymmetry && s.getSymmetryY() == TMz::fdtdSymmetryType::NoSymmetry &&
+         s.getImageYmin() == s.getYmin();
+}
+
+// A Bloch cell at k = 0 is the periodic solver (with the imaginary part left at zero), and a batch
+// of cells on a pool steps like the cells one by one
+template <typename T>
+bool testBloch(double delta)
+{
+  const int nx = 41;
+  const int ny = 33;
+  TMz::fdtdSolver<T> ref;
+  TMz::fdtdBlochCell<T> cell;
+  ref.initialize(nx, ny, 0.0, 0.0, delta);
+  if (!cell.initialize(nx, ny, 0.0, 0.0, delta)) return false;
+  for (int i = 0; i < 2; i++) {
+    TMz::fdtdSolver<T>& s = (i == 0 ? ref : cell.real());
+    s.sourceType(RickerPulse);
+    s.sourceAdditive(true);
+    s.sourcePlace(9.0 * delta, 5.0 * delta);
+    s.setTileWidth(13);
+  }
+  ref.paintMaterial(ref.defineMaterial(1.0, 4.0, 0.0, 0.0), 10, 8, 25, 20);
+  cell.paintMaterial(cell.defineMaterial(1.0, 4.0, 0.0, 0.0), 10, 8, 25, 20);
+  ref.advance(300);
+  if (!cell.advance(300) || !sameFields(ref, cell.real())) return false;
+  for (int i = 0; i < nx * ny; i++)
+    if (cell.imag().dataEz()[i] != 0 || cell.imag().dataHx()[i] != 0 || cell.imag().dataHy()[i] != 0) return false;
+
+  const int count = 5;
+  TMz::fdtdBlochCell<T> batch[count];
+  TMz::fdtdBlochCell<T> single[count];
+  for (int c = 0; c < count; c++) {
+    for (int j = 0; j < 2; j++) {
+      TMz::fdtdBlochCell<T>& b = (j == 0 ? batch[c] : single[c]);
+      b.initialize(nx, ny, 0.0, 0.0, delta);
+      b.real().sourceType(RickerPulse);
+      b.real().sourceAdditive(true);
+      b.real().sourcePlace(30.0 * delta, 0.0);
+      b.paintMaterial(b.defineMaterial(1.0, 3.0, 0.0, 0.0), 0, 0, 6, ny);
+      b.setWavevector(0.7 * c / delta / (nx - 1), -0.4 * c / delta / (ny - 1));
+    }
+  }
+  fdtdThreadPool pool;
+  pool.start(3);
+  if (!TMz::advanceBloch(batch, count, 200, pool)) return false;
+  for (int c = 0; c < count; c++) {
+    if (!single[c].advance(200)) return false;
+    if (!sameFields(batch[c].real(), single[c].real()) || !sameFields(batch[c].imag(), single[c].imag())) return false;
+  }
+  // the images hold at the seams, and the (2,4) stencil is refused
+  const double px = 0.7 * 2 / delta / (nx - 1) * batch[2].getPeriodX();
+  double a0, b0, a1, b1;
+  batch[2].getEz(0, 7, a0, b0);
+  batch[2].getEz(nx - 1, 7, a1, b1);
+  if (!(std::fabs(a0) > 0.0) || !(std::fabs(a1 - (std::cos(px) * a0 - std::sin(px) * b0)) < 1.0e-5)) return false;
+  batch[0].real().setStencil(TMz::fdtdStencilType::FourthOrder);
+  return !batch[0].advance(1);
+}
+
+// A plane wave exp(i k.x) of the empty lattice is a Bloch mode of the cell for any k, so Ez steps
+// as E(n + 1) + E(n - 1) = 2 cos(w dt) E(n) with sin(w dt / 2) = S sqrt(sin^2(kx / 2) + sin^2(ky / 2))
+bool blochDispersion(double delta)
+{
+  const double k[3][2] = { {0.4, -0.25}, {1.1, 0.0}, {2.0, 1.3} }; // radians per cell
+  std::cout << std::scientific << std::setprecision(3);
+  for (int j = 0; j < 3; j++) {
+    TMz::fdtdBlochCell<double> cell;
+    cell.initialize(23, 17, 0.0, 0.0, delta);
+    cell.setWavevector(k[j][0] / delta, k[j][1] / delta);
+    for (int iy = 0; iy < 17; iy++) {
+      double* er = cell.real().rowEz(iy);
+      double* ei = cell.imag().rowEz(iy);
+      for (int ix = 0; ix < 23; ix++) {
+        er[ix] = std::cos(k[j][0] * ix + k[j][1] * iy);
+        ei[ix] = std::sin(k[j][0] * ix + k[j][1] * iy);
+      }
+    }
+    cell.makeImages();
+    std::vector<double> e[3];
+    double worst = 0.0;
+    const double sx = std::sin(0.5 * k[j][0]);
+    const double sy = std::sin(0.5 * k[j][1]);
+    const double S = cell.real().getCourant();
+    const double predicted = 1.0 - 2.0 * S * S * (sx * sx + sy * sy);
+    for (int n = 0; n < 400; n++) {
+      cell.advance(1);
+      e[n % 3].resize(2 * 23 * 17);
+      for (int i = 0; i < 23 * 17; i++) {
+        e[n % 3][2 * i] = cell.real().dataEz()[i];
+        e[n % 3][2 * i + 1] = cell.imag().dataEz()[i];
+      }
+      if (n < 2)
+        continue;
+      const std::vector<double>& e0 = e[(n - 2) % 3];
+      const std::vector<double>& e1 = e[(n - 1) % 3];
+      const std::vector<double>& e2 = e[n % 3];
+      double num = 0.0;
+      double den = 0.0;
+      for (size_t i = 0; i < e1.size(); i++) {
+        num += e1[i] * (e0[i] + e2[i]);
+        den += e1[i] * e1[i];
+      }
+      worst = std::max(worst, std::fabs(0.5 * num / den - predicted));
+    }
+    std::cout << "bloch mode k = (" << k[j][0] << ", " << k[j][1] << ") per cell: cos(w dt) " << predicted << ", worst deviation " << worst << std::endl;
+    if (!(worst < 1.0e-12)) return false;
+  }
+  return true;
+}
+
+// the reductions of the last step, by separate passes over a twin solver that steps without diagnostics
+template <typename T>
+bool checkDiagnostics(const TMz::fdtdDiagnostics& d,
+                      TMz::fdtdSolver<T>& ref,
+                      const double* mur)
+{
+  const int n = ref.size();
+  std::vector<T> hx(ref.dataHx(), ref.dataHx() + n);
+  std::vector<T> hy(ref.dataHy(), ref.dataHy() + n);
+  const double uE = ref.energyE();
+  const double ezmin = ref.minimumEz();
+  const double ezmax = ref.maximumEz();
+  double ez2 = 0.0;
+  for (int i = 0; i < n; i++) ez2 += static_cast<double>(ref.dataEz()[i]) * ref.dataEz()[i];
+  const int step = ref.getUpdateCount();
+  ref.update();
+  double hh = 0.0;
+  for (int iy = 0; iy < ref.getNY(); iy++) {
+    for (int ix = 0; ix < ref.getNX(); ix++) {
+      const int i = iy * ref.getNX() + ix;
+      const double w = mur[ref.getMaterial(ix, iy)];
+      if (iy < ref.getNY() - 1) hh += w * hx[i] * ref.dataHx()[i];
+      if (ix < ref.getNX() - 1) hh += w * hy[i] * ref.dataHy()[i];
+    }
+  }
+  const double uH = vacuum_permeability * hh * ref.getDelta() * ref.getDelta() / 2.0;
+  const double tol = (sizeof(T) == 4 ? 1.0e-4 : 1.0e-10);
+  return d.step == step && d.minimumEz == ezmin && d.maximumEz == ezmax &&
+         std::fabs(d.energyE - uE) <= tol * uE &&
+         std::fabs(d.energyH - uH) <= tol * std::fabs(uE) &&
+         std::fabs(d.normEz - std::sqrt(ez2)) <= tol * std::sqrt(ez2);
+}
+
+// diagnostics gathered by the tiled, blocked and threaded sweeps against separate passes;
+// the fields must not change by switching them on
+template <typename T>
+bool testDiagnostics(double delta)
+{
+  const int nx = 133;
+  const int ny = 91;
+  for (int c = 0; c < 4; c++) {
+    const double mur[3] = { (c == 3 ? 2.0 : 1.0), 1.0, 1.5 };
+    TMz::fdtdSolver<T> ref;
+    TMz::fdtdSolver<T> sim;
+    TMz::fdtdSolver<T> twin;
+    TMz::fdtdSolver<T>* all[3] = { &ref, &sim, &twin };
+    for (int i = 0; i < 3; i++) {
+      TMz::fdtdSolver<T>& s = *all[i];
+      s.initialize(nx, ny, 0.0, 0.0, delta);
+      s.setTileWidth(37);
+      s.sourcePlace(50.0 * delta, 40.0 * delta);
+      if (c == 1 || c == 2) { s.setAbsorbingX(); s.setAbsorbingY(); }
+      if (c == 1) {
+        s.paintMaterial(s.defineMaterial(1.0, 4.0, 0.0, 0.0), 80, 0, 95, ny);
+        s.paintMaterial(s.defineMaterial(1.5, 2.0, 0.0, 50.0), 100, 30, 300, 61);
+      }
+      if (c == 2) s.setDamping(20.0);
+      if (c == 3) { s.setPECX(); s.setAbsorbingY(); s.setUniformMedium(2.0, 3.0, 0.0, 0.0); s.sourceType(RickerPulse); }
+    }
+    if (sim.isDiagnostics() || sim.getDiagnostics().step != -1) return false;
+    sim.setDiagnostics(true);
+    if (c == 2) sim.setThreads(3);
+
+    // single steps
+    for (int n = 0; n < 60; n++) {
+      ref.update();
+      if (n < 59) twin.update();
+      sim.update();
+    }
+    if (!sameFields(ref, sim) || !checkDiagnostics(sim.getDiagnostics(), twin, mur)) return false;
+
+    // blocks of steps
+    sim.advance(45);
+    for (int n = 0; n < 45; n++) ref.update();
+    for (int n = 0; n < 44; n++) twin.update();
+    if (!sameFields(ref, sim) || !checkDiagnostics(sim.getDiagnostics(), twin, mur)) return false;
+  }
+  return true;
+}
+
+// with activity tracking the tiles not yet reached are skipped, and their zeros still count in
+// the range of Ez
+template <typename T>
+bool testDiagnosticsActive(double delta)
+{
+  TMz::fdtdSolver<T> sim;
+  sim.initialize(160, 128, 0.0, 0.0, delta);
+  sim.setActivityTracking(true);
+  sim.sourcePlace(20.0 * delta, 20.0 * delta);
+  sim.sourceType(RickerPulse);
+  sim.setDiagnostics(true);
+  int skipped = 0;
+  for (int n = 0; n < 120; n++) {
+    const double ezmin = sim.minimumEz();
+    const double ezmax = sim.maximumEz();
+    if (sim.getActiveFraction() < 1.0) skipped++;
+    sim.update();
+    const TMz::fdtdDiagnostics& d = sim.getDiagnostics();
+    if (d.minimumEz != ezmin || d.maximumEz != ezmax) {
+      std::cout << "diagnostics with activity tracking, step " << n << ": range [" << d.minimumEz << ", " << d.maximumEz
+                << "] instead of [" << ezmin << ", " << ezmax << "]" << std::endl;
+      return false;
+    }
+  }
+  return skipped > 0;
+}
+
+// lossless closed box: the leapfrog energy of the diagnostics is conserved to rounding,
+// while energyE() + energyB() (H half a step off) oscillates
+bool energyConservation(double delta)
+{
+  TMz::fdtdSolver<double> sim;
+  sim.initialize(300, 175, 0.0, 0.0, delta);
+  sim.sourceType(NoSource);
+  sim.setPECX();
+  sim.setPECY();
+  sim.superimposeGaussian(150.0, 87.0, 10.0, 10.0);
+  sim.setDiagnostics(true);
+  double worstDiag = 0.0;
+  double worstSplit = 0.0;
+  double U0 = 0.0;
+  double V0 = 0.0;
+  for (int n = 0; n < 2000; n++) {
+    const double V = sim.energyE() + sim.energyB();
+    sim.update();
+    const double U = sim.getDiagnostics().energyE + sim.getDiagnostics().energyH;
+    if (n == 0) { U0 = U; V0 = V; }
+    worstDiag = std::max(worstDiag, std::fabs(U - U0) / U0);
+    worstSplit = std::max(worstSplit, std::fabs(V - V0) / V0);
+  }
+  std::cout << std::scientific << std::setprecision(3);
+  std::cout << "energy variation over 2000 steps: diagnostics " << worstDiag << ", energyE() + energyB() " << worstSplit << std::endl;
+  return worstDiag < 1.0e-10;
+}
+
+// A pulse from the middle of a small grid against the same pulse in a grid large enough that
+// nothing comes back within the run: the difference in the small grid is the edge reflection
+// (relative to the peak field). Returns the CPML reflection; Mur is printed for comparison.
+double edgeReflection(double delta, 
+                      int kind)
+{
+  const int ns = 120;
+  const int nb = 520;
+  const int steps = 250;
+  const int d = 12;
+  TMz::fdtdSolver<double> small;
+  TMz::fdtdSolver<double> big;
+  small.initialize(ns, ns, -0.5 * ns * delta, -0.5 * ns * delta, delta);
+  big.initialize(nb, nb, -0.5 * nb * delta, -0.5 * nb * delta, delta);
+  TMz::fdtdSolver<double>* both[2] = { &small, &big };
+  for (int i = 0; i < 2; i++) {
+    both[i]->sourcePlace(0.0, 0.0);
+    both[i]->sourceType(RickerPulse);
+    both[i]->setPECX();
+    both[i]->setPECY();
+  }
+  if (kind == 0) {
+    small.setCPMLThickness(d);
+    small.setCPMLX();
+    small.setCPMLY();
+  } else {
+    small.setAbsorbingX();
+    small.setAbsorbingY();
+  }
+  const int off = (nb - ns) / 2;
+  double peak = 0.0;
+  double worst = 0.0;
+  for (int n = 0; n < steps; n++) {
+    small.update();
+    big.update();
+    for (int iy = d; iy < ns - d; iy++) {
+      for (int ix = d; ix < ns - d; ix++) {
+        const double eb = big.dataEz()[(iy + off) * nb + ix + off];
+        const double es = small.dataEz()[iy * ns + ix];
+        if (std::fabs(eb) > peak) peak = std::fabs(eb);
+        if (std::fabs(es - eb) > worst) worst = std::fabs(es - eb);
+      }
+    }
+  }
+  return worst / peak;
+}
+
+// Refinement patches in a closed lossless box, for a long run: a pulse from outside through a
+// patch holding a dielectric block painted at the fine resolution, and a pulse from inside one
+// (stopped where it ends: cut short, it also excites modes at the Nyquist rate of the coarse
+// step, which hold their energy in a different measure). The total energy stays put (the
+// coupling conserves it); with a lossy block it decays.
+template <typename T>
+bool testSubgrid(double delta)
+{
+  TMz::fdtdSolver<T> sim;
+  TMz::fdtdSubgrid<T> patch;
+  sim.initialize(100, 80, 0.0, 0.0, delta);
+  if (patch.initialize(&sim, 40, 25, 70, 55, 1)) return false;
+  if (patch.initialize(&sim, 2, 25, 30, 55, 2)) return false; // too close to the edge for the band
+  sim.setStencil(TMz::fdtdStencilType::FourthOrder);
+  if (patch.initialize(&sim, 40, 25, 70, 55, 2)) return false;
+  sim.setStencil(TMz::fdtdStencilType::SecondOrder);
+
+  const int steps = 10000;
+  const int window = 500; // energyE() + energyB() swings with the half step between them: compare means
+  const int off = 2 * static_cast<int>(2.0 * 30.0 / courant_factor); // end of the first Ricker pulse (30 ppw)
+  for (int c = 0; c < 5; c++) {
+    const int ratio = (c < 3 ? c + 2 : 3);
+    sim.initialize(100, 80, 0.0, 0.0, delta);
+    sim.setPECX();
+    sim.setPECY();
+    sim.sourceType(RickerPulse);
+    sim.sourceAdditive(true);
+    sim.sourcePlace((c == 3 ? 55.0 : 20.0) * delta, 40.0 * delta);
+    if (!patch.initialize(&sim, 40, 25, 70, 55, ratio)) return false;
+    if (patch.getNX() != 30 * ratio + 1 || patch.getNY() != 30 * ratio + 1) return false;
+    const int id = (c == 4 ? patch.defineMaterial(1.0, 3.0, 0.0, 20.0) : patch.defineMaterial(1.0, 4.0, 0.0, 0.0));
+    patch.paintMaterial(id, 10 * ratio + 1, 12 * ratio, 14 * ratio + 2, 18 * ratio + 1);
+    double U0 = 0.0;
+    double sum = 0.0;
+    double lo = 1.0;
+    double hi = 1.0;
+    for (int n = 0; n < steps; n++) {
+      if (n == off) sim.sourceType(NoSource);
+      patch.update();
+      sum += patch.energyE() + patch.energyB();
+      if (!std::isfinite(sum)) return false;
+      if (n % window == window - 1) {
+        if (n == 2 * window - 1) U0 = sum;
+        if (n > 2 * window) {
+          lo = std::min(lo, sum / U0);
+          hi = std::max(hi, sum / U0);
+        }
+        sum = 0.0;
+      }
+    }
+    if (c == 4) {
+      if (!(hi <= 1.0 && lo < 0.2)) return false;
+    } else if (!(lo > 0.98 && hi < 1.02)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A pulse through a refinement patch against the coarse grid alone (CPML all round): the
+// difference upstream of the patch is the interface reflection, relative to the peak field.
+// The pulse is 10 coarse cells per wavelength at its peak frequency.
+double subgridReflection(double delta, 
+                         int ratio)
+{
+  const int nx = 300;
+  const int ny = 200;
+  TMz::fdtdSolver<double> sim;
+  TMz::fdtdSolver<double> ref;
+  TMz::fdtdSolver<double>* both[2] = { &sim, &ref };
+  for (int i = 0; i < 2; i++) {
+    both[i]->initialize(nx, ny, 0.0, 0.0, delta);
+    both[i]->setCPMLX();
+    both[i]->setCPMLY();
+    both[i]->sourcePlace(60.0 * delta, 100.0 * delta);
+    both[i]->sourceType(RickerPulse);
+    both[i]->sourceAdditive(true);
+    both[i]->sourceTune(-20.0);
+  }
+  TMz::fdtdSubgrid<double> patch;
+  if (!patch.initialize(&sim, 120, 70, 180, 130, ratio)) return 1.0;
+  double peak = 0.0;
+  double worst = 0.0;
+  for (int n = 0; n < 400; n++) {
+    patch.update();
+    ref.update();
+    for (int iy = 20; iy < ny - 20; iy++) {
+      for (int ix = 20; ix < 110; ix++) {
+        const int i = nx * iy + ix;
+        peak = std::max(peak, std::fabs(ref.dataEz()[i]));
+        worst = std::max(worst, std::fabs(sim.dataEz()[i] - ref.dataEz()[i]));
+      }
+    }
+  }
+  return worst / peak;
+}
+
+// Axis of n points from x0: spacing h, except over [a, a + 2 ramp + w) where it falls to h / ratio
+// (a raised cosine over ramp cells), stays there for w cells and rises back
+void gradedAxis(std::vector<double>& g,
+                int n,
+                double x0,
+                double h,
+                double ratio,
+                int a,
+                int ramp,
+                int w)
+{
+  g.resize(n);
+  g[0] = x0;
+  for (int i = 0; i < n - 1; i++) {
+    const int k = i - a;
+    double fine = 0.0;
+    if (k >= 0 && k < ramp) fine = 0.5 * (1.0 - std::cos(M_PI * (k + 0.5) / ramp));
+    if (k >= ramp && k < ramp + w) fine = 1.0;
+    if (k >= ramp + w && k < 2 * ramp + w) fine = 0.5 * (1.0 + std::cos(M_PI * (k - ramp - w + 0.5) / ramp));
+    g[i + 1] = g[i] + h * (1.0 - (1.0 - 1.0 / ratio) * fine);
+  }
+}
+
+// graded meshes: reference, tiled (with activity tracking), advance() and threaded updates must
+// agree bit for bit with any edges, CPML layers and materials; and the grid maps the source
+template <typename T>
+bool testGraded(double delta)
+{
+  const int nx = 131;
+  const int ny = 97;
+  std::vector<double> x, y;
+  gradedAxis(x, nx, 0.0, delta, 3.0, 40, 12, 20);
+  gradedAxis(y, ny, -0.01, delta, 2.0, 10, 8, 15);
+  {
+    TMz::fdtdSolver<T> s;
+    s.initialize(nx, ny, 0.0, 0.0, delta);
+    s.setStencil(TMz::fdtdStencilType::FourthOrder);
+    if (s.setGrid(x.data(), y.data())) return false;
+    s.setStencil(TMz::fdtdStencilType::SecondOrder);
+    std::vector<double> bad(x);
+    bad[50] = bad[49];
+    if (s.setGrid(bad.data(), y.data()) || s.isGraded()) return false;
+    if (!s.setGrid(x.data(), y.data()) || !s.isGraded()) return false;
+    if (!(std::fabs(s.getDelta() - delta / 3.0) < 1.0e-12 * delta)) return false;
+    s.setStencil(TMz::fdtdStencilType::FourthOrder);
+    if (s.getStencil() != TMz::fdtdStencilType::SecondOrder) return false;
+    s.sourcePlace(x[57] + 0.4 * (x[58] - x[57]), y[30] - 0.4 * (y[30] - y[29]));
+    if (s.sourceCell() != nx * 30 + 57) return false;
+    s.sourcePlace(x[0] - delta, y[30]);
+    if (s.sourceCell() != -1) return false;
+  }
+  for (int c = 0; c < 5; c++) {
+    TMz::fdtdSolver<T> sims[4];
+    for (int i = 0; i < 4; i++) {
+      TMz::fdtdSolver<T>& s = sims[i];
+      s.initialize(nx, ny, 0.0, 0.0, delta);
+      s.setKernel(i == 0 ? TMz::fdtdKernelType::Reference : TMz::fdtdKernelType::Tiled);
+      s.setTileWidth(19);
+      if (i == 3) s.setThreads(3);
+      if (c == 1) { s.setCPMLX(); s.setCPMLY(); s.sourceType(RickerPulse); }
+      if (!s.setGrid(x.data(), y.data())) return false;
+      s.sourcePlace(x[50], y[40]);
+      if (c == 0) { s.setAbsorbingX(); s.setAbsorbingY(); }
+      if (c == 2) { s.setPeriodicX(); s.setAbsorbingY(); s.paintMaterial(s.defineMaterial(1.0, 4.0, 0.0, 30.0), 60, 0, 80, 70); }
+      if (c == 3) { s.setPECX(); s.setPECY(); s.setDamping(15.0); s.sourceType(RickerPulse); }
+      if (c == 4) { s.setAbsorbingX(); s.sourceAdditive(true); }
+    }
+    for (int n = 0; n < 200; n++) {
+      sims[0].update();
+      sims[1].update();
+    }
+    sims[2].advance(200);
+    sims[3].advance(200);
+    for (int i = 1; i < 4; i++)
+      if (!sameFields(sims[0], sims[i])) return false;
+    if (!(sims[0].energyE() > 0.0) || !std::isfinite(sims[0].energyE())) return false;
+  }
+  return true;
+}
+
+// lossless closed box on a graded mesh: the energy the diagnostics weigh by cell area is conserved
+// to rounding, and their E part is energyE() of the same time level
+bool gradedEnergy(double delta)
+{
+  const int nx = 200;
+  const int ny = 150;
+  std::vector<double> x, y;
+  gradedAxis(x, nx, 0.0, delta, 4.0, 30, 20, 60);
+  gradedAxis(y, ny, 0.0, delta, 2.5, 50, 15, 10);
+  TMz::fdtdSolver<double> sim;
+  sim.initialize(nx, ny, 0.0, 0.0, delta);
+  if (!sim.setGrid(x.data(), y.data())) return false;
+  sim.sourceType(NoSource);
+  sim.setPECX();
+  sim.setPECY();
+  sim.paintMaterial(sim.defineMaterial(2.0, 3.0, 0.0, 0.0), 120, 20, 160, 60);
+  sim.superimposeGaussian(70.0, 75.0, 8.0, 8.0);
+  sim.setDiagnostics(true);
+  double U0 = 0.0;
+  double worst = 0.0;
+  for (int n = 0; n < 3000; n++) {
+    const double uE = sim.energyE();
+    sim.update();
+    const TMz::fdtdDiagnostics& d = sim.getDiagnostics();
+    if (!(std::fabs(d.energyE - uE) <= 1.0e-12 * (d.energyE + d.energyH))) return false;
+    const double U = d.energyE + d.energyH;
+    if (n == 0) U0 = U;
+    worst = std::max(worst, std::fabs(U - U0) / U0);
+  }
+  std::cout << std::scientific << std::setprecision(3);
+  std::cout << "graded mesh energy variation over 3000 steps: " << worst << std::endl;
+  return worst < 1.0e-10;
+}
+
+// A pulse through a band of cells graded down to 1 / ratio of the spacing and back, against the
+// uniform grid (CPML all round; both have one small cell inside the top layer, so the timestep is
+// the same): the difference upstream of the band is its reflection, relative to the peak field.
+// The pulse is 10 coarse cells per wavelength at its peak frequency.
+double gradedReflection(double delta,
+                        int ratio)
+{
+  const int ramp = 20;
+  const int w = 30 * ratio;
+  const int nx = 140 + 2 * ramp + w + 100;
+  const int ny = 200;
+  std::vector<double> x, y, xu;
+  gradedAxis(x, nx, 0.0, delta, ratio, 140, ramp, w);
+  gradedAxis(xu, 300, 0.0, delta, 1.0, 0, 0, 0);
+  gradedAxis(y, ny, 0.0, delta, ratio, ny - 2, 0, 1);
+  TMz::fdtdSolver<double> sim;
+  TMz::fdtdSolver<double> ref;
+  sim.initialize(nx, ny, 0.0, 0.0, delta);
+  ref.initialize(300, ny, 0.0, 0.0, delta);
+  if (!sim.setGrid(x.data(), y.data()) || !ref.setGrid(xu.data(), y.data())) return 1.0;
+  if (sim.getTimestep() != ref.getTimestep()) return 1.0;
+  TMz::fdtdSolver<double>* both[2] = { &sim, &ref };
+  for (int i = 0; i < 2; i++) {
+    both[i]->setCPMLX();
+    both[i]->setCPMLY();
+    both[i]->sourcePlace(60.0 * delta, 100.0 * delta);
+    both[i]->sourceType(RickerPulse);
+    both[i]->sourceAdditive(true);
+    both[i]->sourceTune(10.0 * ratio - 30.0);
+  }
+  double peak = 0.0;
+  double worst = 0.0;
+  for (int n = 0; n < 250 * ratio; n++) {
+    sim.update();
+    ref.update();
+    for (int iy = 20; iy < ny - 20; iy++) {
+      for (int ix = 20; ix < 130; ix++) {
+        peak = std::max(peak, std::fabs(ref.dataEz()[300 * iy + ix]));
+        worst = std::max(worst, std::fabs(sim.dataEz()[nx * iy + ix] - ref.dataEz()[300 * iy + ix]));
+      }
+    }
+  }
+  return worst / peak;
+}
+
+// fdtdRaster against rasterizeEz() (the reference): colormap indices may differ by one where the
+// value falls next to a step; over 99% of the pixels must agree and the rest be neighbouring colors
+bool sameImage(const std::vector<uint32_t>& a,
+               const std::vector<uint32_t>& b)
+{
+  int same = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i] == b[i]) {
+      same++;
+      continue;
+    }
+    for (int c = 0; c < 32; c += 8) {
+      const int d = static_cast<int>((a[i] >> c) & 255) - static_cast<int>((b[i] >> c) & 255);
+      if (d > 8 || d < -8) return false;
+    }
+  }
+  return same > 0.99 * a.size();
+}
+
+template <typename T>
+bool testRaster(double delta)
+{
+  const int nx = 150;
+  const int ny = 101;
+  for (int c = 0; c < 4; c++) {
+    TMz::fdtdSolver<T> s;
+    s.initialize(nx, ny, 0.0, 0.0, delta);
+    if (c == 1) {
+      std::vector<double> x, y;
+      gradedAxis(x, nx, 0.0, delta, 3.0, 40, 12, 20);
+      gradedAxis(y, ny, -0.01, delta, 2.0, 10, 8, 15);
+      if (!s.setGrid(x.data(), y.data())) return false;
+    }
+    if (c == 2) {
+      s.setSymmetryX(TMz::fdtdSymmetryType::OddSymmetry);
+      s.setSymmetryY(TMz::fdtdSymmetryType::EvenSymmetry);
+    }
+    s.sourceType(NoSource);
+    s.superimposeGaussian(40.0, 30.0, 6.0, 4.0);
+    s.superimposeGaussian(100.0, 70.0, 3.0, 8.0);
+    s.advance(60);
+    TMz::fdtdRaster<T> raster;
+    raster.setPyramidBudget(-1); // (point sampling, as the reference)
+    // the whole image, magnified, reduced, a window inside and odd sizes (tables rebuilt each time)
+    const int sizes[4][2] = { {2 * nx, 2 * ny}, {901, 677}, {nx / 3, ny / 3}, {97, 53} };
+    for (int k = 0; k < 4; k++) {
+      const int w = sizes[k][0];
+      const int h = sizes[k][1];
+      const double d = 1.0e-8 * delta;
+      double x0 = s.getImageXmin();
+      double x1 = s.getXmax() - d;
+      double y0 = s.getImageYmin();
+      double y1 = s.getYmax() - d;
+      if (k == 3 || c == 3) {
+        x0 = s.getX(20) + 0.3 * delta;
+        x1 = s.getX(90);
+        y0 = s.getY(30);
+        y1 = s.getY(60) + 0.7 * delta;
+      }
+      std::vector<uint32_t> a(w * h);
+      std::vector<uint32_t> b(w * h);
+      for (int m = 0; m < 2; m++) {
+        s.rasterizeEz(a.data(), w, h, m == 0, -0.3, 0.5, x0, x1, y0, y1);
+        raster.renderEz(s, b.data(), w, h, m == 0 ? rgb_packed_viridis.rgba : rgb_packed_jet.rgba, -0.3, 0.5, x0, x1, y0, y1);
+        if (!sameImage(a, b)) {
+          std::cout << "case " << c << ", image " << w << "x" << h << " differs" << std::endl;
+          return false;
+        }
+      }
+    }
+    // the nodes themselves (all, and every third for a preview), unfolded across the planes
+    if (c == 1)
+      continue;
+    for (int step = 1; step <= 3; step += 2) {
+      const int w = raster.nodesWidth(s, step);
+      const int h = raster.nodesHeight(s, step);
+      const bool mx = (s.getSymmetryX() != TMz::fdtdSymmetryType::NoSymmetry);
+      const bool my = (s.getSymmetryY() != TMz::fdtdSymmetryType::NoSymmetry);
+      if (w != ((mx ? 2 * nx - 1 : nx) - 1) / step + 1 || h != ((my ? 2 * ny - 1 : ny) - 1) / step + 1) return false;
+      std::vector<uint32_t> a(w * h);
+      std::vector<uint32_t> b(w * h);
+      for (int j = 0; j < h; j++) {
+        const int v = (my ? 2 * ny - 2 : ny - 1) - j * step; // from the bottom of the whole grid
+        const int iy = (my ? std::abs(v - (ny - 1)) : v);
+        const double fy = (my && v < ny - 1 && s.getSymmetryY() == TMz::fdtdSymmetryType::OddSymmetry ? -1.0 : 1.0);
+        for (int i = 0; i < w; i++) {
+          const int u = i * step;
+          const int ix = (mx ? std::abs(u - (nx - 1)) : u);
+          const double fx = (mx && u < nx - 1 && s.getSymmetryX() == TMz::fdtdSymmetryType::OddSymmetry ? -1.0 : 1.0);
+          a[i + j * w] = rgb_d_viridis(static_cast<float>((fx * fy * s.dataEz()[nx * iy + ix] + 0.3) / 0.8));
+        }
+      }
+      raster.renderEzNodes(s, b.data(), rgb_packed_viridis.rgba, -0.3, 0.5, step);
+      if (!sameImage(a, b)) {
+        std::cout << "case " << c << ", nodes every " << step << " differ" << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// An H component at a node (Hy: alongX, else Hx) and its square, interpolated linearly in
+// position from the edges on either side (the far one across a periodic seam, the mirror image
+// across a symmetry plane), or the one edge inside at other boundaries
+template <typename T>
+void nodeH(const TMz::fdtdSolver<T>& s,
+           bool alongX,
+           int ix,
+           int iy,
+           double& h,
+           double& h2)
+{
+  const int nx = s.getNX();
+  const int n = (alongX ? nx : s.getNY());
+  const bool periodic = (alongX ? s.isPeriodicX() : s.isPeriodicY());
+  const TMz::fdtdSymmetryType sym = (alongX ? s.getSymmetryX() : s.getSymmetryY());
+  auto g = [&](int i) { return (alongX ? s.getX(i) : s.getY(i)); };
+  auto edge = [&](int j) { return static_cast<double>(alongX ? s.dataHy()[nx * iy + j] : s.dataHx()[nx * j + ix]); };
+  int k = (alongX ? ix : iy);
+  if (k == n - 1 && periodic) k = 0;
+  double v0, v1, p0, p1;
+  if (k > 0 && k < n - 1) {
+    v0 = edge(k - 1);
+    v1 = edge(k);
+    p0 = 0.5 * (g(k - 1) + g(k));
+    p1 = 0.5 * (g(k) + g(k + 1));
+  } else if (k == 0 && periodic) {
+    v0 = edge(n - 2);
+    v1 = edge(0);
+    p0 = g(0) - 0.5 * (g(n - 1) - g(n - 2));
+    p1 = 0.5 * (g(0) + g(1));
+  } else if (k == 0 && sym != TMz::fdtdSymmetryType::NoSymmetry) {
+    v1 = edge(0);
+    v0 = (sym == TMz::fdtdSymmetryType::OddSymmetry ? v1 : -v1);
+    p1 = 0.5 * (g(0) + g(1));
+    p0 = 2.0 * g(0) - p1;
+  } else {
+    h = edge(k == 0 ? 0 : n - 2);
+    h2 = h * h;
+    return;
+  }
+  const double t = (g(k) - p0) / (p1 - p0);
+  h = v0 + t * (v1 - v0);
+  h2 = v0 * v0 + t * (v1 * v1 - v0 * v0);
+}
+
+// the quantities of fdtdFieldType at a node, computed directly
+template <typename T>
+double nodeField(const TMz::fdtdSolver<T>& s,
+                 TMz::fdtdFieldType f,
+                 int ix,
+                 int iy)
+{
+  double hx, hx2, hy, hy2;
+  nodeH(s, false, ix, iy, hx, hx2);
+  nodeH(s, true, ix, iy, hy, hy2);
+  const double eta0 = vacuum_impedance;
+  const double ez = s.dataEz()[s.getNX() * iy + ix];
+  const double hm = eta0 * std::sqrt(hx * hx + hy * hy);
+  const TMz::fdtdMaterial<T>& m = s.getMaterialProperties(s.getMaterial(ix, iy));
+  switch (f) {
+  case TMz::fdtdFieldType::Hx: return eta0 * hx;
+  case TMz::fdtdFieldType::Hy: return eta0 * hy;
+  case TMz::fdtdFieldType::MagnitudeH: return hm;
+  case TMz::fdtdFieldType::EnergyDensity: return 0.5 * (m.epr * ez * ez + m.mur * eta0 * eta0 * (hx2 + hy2));
+  case TMz::fdtdFieldType::MagnitudeS: return std::fabs(ez) * hm;
+  default: return ez;
+  }
+}
+
+// fdtdRaster drawing H and the derived quantities: the image must be the one rasterizeEz() makes
+// of a grid holding the quantity, computed directly at the nodes, in place of Ez (with the planes
+// of that grid mirroring it the way the quantity mirrors); the range of the pixels comes along
+template <typename T>
+bool testRasterFields(double delta)
+{
+  const int nx = 120;
+  const int ny = 91;
+  for (int c = 0; c < 5; c++) {
+    TMz::fdtdSolver<T> s;
+    s.initialize(nx, ny, 0.0, 0.0, delta);
+    std::vector<double> x, y;
+    if (c == 1) {
+      s.setPeriodicX();
+      s.setPeriodicY();
+    }
+    if (c == 2) {
+      gradedAxis(x, nx, 0.0, delta, 3.0, 30, 10, 20);
+      gradedAxis(y, ny, -0.01, delta, 2.0, 10, 8, 15);
+      if (!s.setGrid(x.data(), y.data())) return false;
+    }
+    if (c == 3 || c == 4) {
+      s.setSymmetryX(c == 3 ? TMz::fdtdSymmetryType::OddSymmetry : TMz::fdtdSymmetryType::EvenSymmetry);
+      s.setSymmetryY(c == 3 ? TMz::fdtdSymmetryType::EvenSymmetry : TMz::fdtdSymmetryType::OddSymmetry);
+    }
+    s.paintMaterial(s.defineMaterial(2.0, 4.0, 0.0, 0.0), 60, 10, 90, 50);
+    s.sourceType(NoSource);
+    s.superimposeGaussian(20.0, 30.0, 6.0, 4.0);
+    s.superimposeGaussian(80.0, 60.0, 3.0, 8.0);
+    s.advance(50);
+
+    TMz::fdtdRaster<T> raster;
+    raster.setPyramidBudget(-1); // (point sampling, as the reference)
+    for (int f = 1; f <= static_cast<int>(TMz::fdtdFieldType::MagnitudeS); f++) {
+      const TMz::fdtdFieldType field = static_cast<TMz::fdtdFieldType>(f);
+      TMz::fdtdSolver<T> q;
+      q.initialize(nx, ny, 0.0, 0.0, delta);
+      if (c == 2) q.setGrid(x.data(), y.data());
+      // Hx flips opposite to Ez across a plane normal to y, Hy across one normal to x
+      const bool flipX = (field == TMz::fdtdFieldType::Hy);
+      const bool flipY = (field == TMz::fdtdFieldType::Hx);
+      const bool signed_ = (f <= 2);
+      if (s.getSymmetryX() != TMz::fdtdSymmetryType::NoSymmetry)
+        q.setSymmetryX(signed_ && ((s.getSymmetryX() == TMz::fdtdSymmetryType::OddSymmetry) != flipX) ? TMz::fdtdSymmetryType::OddSymmetry : TMz::fdtdSymmetryType::EvenSymmetry);
+      if (s.getSymmetryY() != TMz::fdtdSymmetryType::NoSymmetry)
+        q.setSymmetryY(signed_ && ((s.getSymmetryY() == TMz::fdtdSymmetryType::OddSymmetry) != flipY) ? TMz::fdtdSymmetryType::OddSymmetry : TMz::fdtdSymmetryType::EvenSymmetry);
+      // (over the whole image, with the mirror images of the nodes)
+      const bool odd = (q.getSymmetryX() == TMz::fdtdSymmetryType::OddSymmetry || q.getSymmetryY() == TMz::fdtdSymmetryType::OddSymmetry);
+      double lo = 0.0;
+      double hi = 0.0;
+      for (int iy = 0; iy < ny; iy++) {
+        T* r = q.rowEz(iy);
+        for (int ix = 0; ix < nx; ix++) {
+          const double v = nodeField(s, field, ix, iy);
+          r[ix] = static_cast<T>(v);
+          lo = std::min(lo, odd ? -std::fabs(v) : v);
+          hi = std::max(hi, odd ? std::fabs(v) : v);
+        }
+      }
+      const double span = (signed_ ? 2.0 * std::max(hi, -lo) : hi - lo);
+      const double vmin = (signed_ ? -0.6 * span : lo - 0.2 * span);
+      const double vmax = (signed_ ? 0.6 * span : hi + 0.1 * span);
+
+      const int sizes[3][2] = { {2 * nx, 2 * ny}, {nx / 3, ny / 3}, {97, 53} };
+      for (int k = 0; k < 3; k++) {
+        const int w = sizes[k][0];
+        const int h = sizes[k][1];
+        const double d = 1.0e-8 * delta;
+        double x0 = s.getImageXmin();
+        double x1 = s.getXmax() - d;
+        double y0 = s.getImageYmin();
+        double y1 = s.getYmax() - d;
+        if (k == 2) {
+          x0 = s.getX(20) + 0.3 * delta;
+          x1 = s.getX(90);
+          y0 = s.getY(30);
+          y1 = s.getY(60) + 0.7 * delta;
+        }
+        std::vector<uint32_t> a(w * h);
+        std::vector<uint32_t> b(w * h);
+        q.rasterizeEz(a.data(), w, h, true, vmin, vmax, x0, x1, y0, y1);
+        raster.renderField(s, field, b.data(), w, h, rgb_packed_viridis.rgba, vmin, vmax, x0, x1, y0, y1);
+        if (!sameImage(a, b)) {
+          std::cout << "case " << c << ", field " << f << ", image " << w << "x" << h << " differs" << std::endl;
+          return false;
+        }
+      }
+      if (c == 2)
+        continue;
+      const int w = raster.nodesWidth(s, 1);
+      const int h = raster.nodesHeight(s, 1);
+      std::vector<uint32_t> a(w * h);
+      std::vector<uint32_t> b(w * h);
+      TMz::fdtdRaster<T> ref;
+      ref.renderEzNodes(q, a.data(), rgb_packed_jet.rgba, vmin, vmax, 1);
+      raster.renderFieldNodes(s, field, b.data(), rgb_packed_jet.rgba, vmin, vmax, 1);
+      if (!sameImage(a, b)) {
+        std::cout << "case " << c << ", field " << f << ", nodes differ" << std::endl;
+        return false;
+      }
+      if (std::fabs(raster.renderedMinimum() - lo) > 1.0e-4 * span || std::fabs(raster.renderedMaximum() - hi) > 1.0e-4 * span) {
+        std::cout << "case " << c << ", field " << f << ": range [" << raster.renderedMinimum() << ", " << raster.renderedMaximum()
+                  << "], nodes [" << lo << ", " << hi << "]" << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// The histogram of the raster pass: percentiles of a ramp with a few hot cells (which the exact
+// range has, and the percentiles ignore), an automatic range that settles from far too wide,
+// and the log scale (colormap indices through an identity table)
+template <typename T>
+bool testRasterRange(double delta)
+{
+  const int nx = 201;
+  const int ny = 60;
+  TMz::fdtdSolver<T> s;
+  s.initialize(nx, ny, 0.0, 0.0, delta);
+  for (int iy = 0; iy < ny; iy++) {
+    T* r = s.rowEz(iy);
+    for (int ix = 0; ix < nx; ix++)
+      r[ix] = static_cast<T>(0.2 + 0.6 * ix / (nx - 1.0)); // [0.2, 0.8]
+  }
+  for (int k = 0; k < 5; k++)
+    s.rowEz(10 + 7 * k)[40 + 20 * k] = 100;
+  TMz::fdtdRaster<T> raster;
+  std::vector<uint32_t> img(nx * ny);
+  raster.renderEzNodes(s, img.data(), rgb_packed_viridis.rgba, 0.0, 1.0, 1);
+  const double tol = 0.02;
+  if (std::fabs(raster.renderedMinimum() - 0.2) > 1.0e-5 || std::fabs(raster.renderedMaximum() - 100.0) > 1.0e-3 ||
+      std::fabs(raster.renderedPercentile(0.5) - 0.5) > tol || std::fabs(raster.renderedPercentile(0.01) - 0.206) > tol ||
+      std::fabs(raster.renderedPercentile(0.99) - 0.794) > tol) {
+    std::cout << "range [" << raster.renderedMinimum() << ", " << raster.renderedMaximum() << "], percentiles "
+              << raster.renderedPercentile(0.01) << " " << raster.renderedPercentile(0.5) << " " << raster.renderedPercentile(0.99) << std::endl;
+    return false;
+  }
+  double vmin = -50.0;
+  double vmax = 50.0;
+  for (int n = 0; n < 6; n++) {
+    raster.renderEzNodes(s, img.data(), rgb_packed_viridis.rgba, vmin, vmax, 1);
+    if (!raster.autoRange(0.01, 0.99, false, vmin, vmax)) return false;
+  }
+  if (std::fabs(vmin - 0.206) > tol || std::fabs(vmax - 0.794) > tol) {
+    std::cout << "auto range [" << vmin << ", " << vmax << "]" << std::endl;
+    return false;
+  }
+  if (!raster.autoRange(0.01, 0.99, true, vmin, vmax) || vmin != -vmax || std::fabs(vmax - 0.794) > tol) return false;
+
+  // four decades, 1e-4 to 1, over the columns; drawn over three
+  for (int iy = 0; iy < ny; iy++) {
+    T* r = s.rowEz(iy);
+    for (int ix = 0; ix < nx; ix++)
+      r[ix] = static_cast<T>((iy & 1 ? -1.0 : 1.0) * std::pow(10.0, -4.0 + 4.0 * ix / (nx - 1.0)));
+  }
+  uint32_t identity[256];
+  for (int k = 0; k < 256; k++) identity[k] = k;
+  raster.setColorScale(TMz::fdtdColorScale::Logarithmic);
+  raster.renderEzNodes(s, img.data(), identity, 1.0e-3, 1.0, 1);
+  for (int j = 0; j < ny; j++) {
+    for (int ix = 0; ix < nx; ix++) {
+      const double c = 255.0 * (4.0 * ix / (nx - 1.0) - 1.0) / 3.0;
+      const int expect = (c < 0.0 ? 0 : (c > 255.0 ? 255 : static_cast<int>(c)));
+      if (std::abs(static_cast<int>(img[j * nx + ix]) - expect) > 3) {
+        std::cout << "log scale: index " << img[j * nx + ix] << " at column " << ix << ", expected " << expect << std::endl;
+        return false;
+      }
+    }
+  }
+  if (std::fabs(std::log10(raster.renderedPercentile(0.5)) + 2.0) > 0.05) return false;
+  if (!raster.autoRange(0.0, 1.0, false, vmin, vmax) || std::fabs(std::log10(vmin) + 4.0) > 0.05 || std::fabs(vmax - 1.0) > 0.05) {
+    std::cout << "log auto range [" << vmin << ", " << vmax << "]" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Zoomed out, the raster samples its halfband pyramid: close to point sampling on a smooth field
+// (also across a mirror plane, and for a derived field), next to zero on a checkerboard (which point
+// sampling aliases to full range), and with a small budget the pyramid catches up with a new field
+// over a number of frames, to the same image as one built at once
+template <typename T>
+bool testRasterPyramid(double delta)
+{
+  const int nx = 801;
+  const int ny = 601;
+  const int w = 100;
+  const int h = 75;
+  uint32_t identity[256];
+  for (int k = 0; k < 256; k++) identity[k] = k;
+  std::vector<uint32_t> a(w * h);
+  std::vector<uint32_t> b(w * h);
+  std::vector<uint32_t> c(w * h);
+  auto smooth = [&](TMz::fdtdSolver<T>& s) {
+    for (int iy = 0; iy < ny; iy++) {
+      T* r = s.rowEz(iy);
+      for (int ix = 0; ix < nx; ix++)
+        r[ix] = static_cast<T>(0.9 * std::exp(-((ix - 300.0) * (ix - 300.0) + (iy - 350.0) * (iy - 350.0)) / (2.0 * 60.0 * 60.0)));
+    }
+  };
+  auto checkerboard = [&](TMz::fdtdSolver<T>& s) {
+    for (int iy = 0; iy < ny; iy++) {
+      T* r = s.rowEz(iy);
+      for (int ix = 0; ix < nx; ix++)
+        r[ix] = static_cast<T>((ix + iy) & 1 ? -0.9 : 0.9);
+    }
+  };
+  for (int m = 0; m < 2; m++) {
+    TMz::fdtdSolver<T> s;
+    s.initialize(nx, ny, 0.0, 0.0, delta);
+    if (m == 1) s.setSymmetryX(TMz::fdtdSymmetryType::OddSymmetry);
+    s.sourceType(NoSource);
+    smooth(s);
+    s.advance(30);
+    const double x0 = s.getImageXmin();
+    const double x1 = s.getXmax() - 1.0e-8 * delta;
+    const double y0 = s.getImageYmin();
+    const double y1 = s.getYmax() - 1.0e-8 * delta;
+    for (int f = 0; f < 2; f++) {
+      const TMz::fdtdFieldType field = (f == 0 ? TMz::fdtdFieldType::Ez : TMz::fdtdFieldType::MagnitudeH);
+      TMz::fdtdRaster<T> pyramid;
+      TMz::fdtdRaster<T> direct;
+      direct.setPyramidBudget(-1);
+      pyramid.renderField(s, field, a.data(), w, h, identity, -1.0, 1.0, x0, x1, y0, y1);
+      direct.renderField(s, field, b.data(), w, h, identity, -1.0, 1.0, x0, x1, y0, y1);
+      if (pyramid.getPyramidLevel() != 2 || direct.getPyramidLevel() != 0) {
+        std::cout << "pyramid level " << pyramid.getPyramidLevel() << std::endl;
+        return false;
+      }
+      for (int i = 0; i < w * h; i++) {
+        if (std::abs(static_cast<int>(a[i]) - static_cast<int>(b[i])) > 2) {
+          std::cout << "case " << m << ", field " << f << ": pyramid " << a[i] << ", point sampled " << b[i] << " at pixel " << i << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+
+  TMz::fdtdSolver<T> s;
+  s.initialize(nx, ny, 0.0, 0.0, delta);
+  const double x1 = s.getXmax() - 1.0e-8 * delta;
+  const double y1 = s.getYmax() - 1.0e-8 * delta;
+  checkerboard(s);
+  TMz::fdtdRaster<T> direct;
+  direct.setPyramidBudget(-1);
+  direct.renderEz(s, b.data(), w, h, identity, -1.0, 1.0, 0.0, x1, 0.0, y1);
+  if (std::fabs(direct.renderedMinimum()) < 0.89 || std::fabs(direct.renderedMaximum()) < 0.89) {
+    std::cout << "checkerboard point sampled to [" << direct.renderedMinimum() << ", " << direct.renderedMaximum() << "]" << std::endl;
+    return false;
+  }
+  TMz::fdtdRaster<T> fresh;
+  fresh.setPyramidBudget(0);
+  fresh.renderEz(s, c.data(), w, h, identity, -1.0, 1.0, 0.0, x1, 0.0, y1);
+  for (int j = 8; j < h - 8; j++) {
+    for (int i = 8; i < w - 8; i++) {
+      if (std::abs(static_cast<int>(c[j * w + i]) - 127) > 2) {
+        std::cout << "checkerboard: pyramid " << c[j * w + i] << " at pixel (" << i << ", " << j << ")" << std::endl;
+        return false;
+      }
+    }
+  }
+
+  // one node per pixel and frame: about 9 grid rows, some 65 frames for the whole grid
+  TMz::fdtdRaster<T> lazy;
+  lazy.setPyramidBudget(1);
+  smooth(s);
+  lazy.renderEz(s, a.data(), w, h, identity, -1.0, 1.0, 0.0, x1, 0.0, y1);
+  checkerboard(s);
+  lazy.renderEz(s, a.data(), w, h, identity, -1.0, 1.0, 0.0, x1, 0.0, y1);
+  if (a == c) {
+    std::cout << "the pyramid caught up at once" << std::endl;
+    return false;
+  }
+  for (int n = 0; n < 70; n++)
+    lazy.renderEz(s, a.data(), w, h, identity, -1.0, 1.0, 0.0, x1, 0.0, y1);
+  if (a != c) {
+    std::cout << "the pyramid did not catch up" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// a frame of the browser app's default size from a grid of its default size (and the grid image)
+bool rasterBench(double delta)
+{
+  TMz::fdtdSolver<double> s;
+  s.initialize(300, 175, 0.0, 0.0, delta);
+  s.superimposeGaussian(150.0, 80.0, 20.0, 20.0);
+  s.advance(100);
+  const int w = 1200;
+  const int h = 700;
+  const int frames = 20;
+  std::vector<uint32_t> a(w * h);
+  std::vector<uint32_t> b(w * h);
+  TMz::fdtdRaster<double> raster;
+  const double x1 = s.getXmax() - 1.0e-8 * delta;
+  const double y1 = s.getYmax() - 1.0e-8 * delta;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int n = 0; n < frames; n++)
+    s.rasterizeEz(a.data(), w, h, true, -0.5, 0.5, s.getXmin(), x1, s.getYmin(), y1);
+  const auto t1 = std::chrono::steady_clock::now();
+  for (int n = 0; n < frames; n++)
+    raster.renderEz(s, b.data(), w, h, rgb_packed_viridis.rgba, -0.5, 0.5, s.getXmin(), x1, s.getYmin(), y1);
+  const auto t2 = std::chrono::steady_clock::now();
+  std::vector<uint32_t> c(raster.nodesWidth(s, 1) * raster.nodesHeight(s, 1));
+  for (int n = 0; n < frames; n++)
+    raster.renderEzNodes(s, c.data(), rgb_packed_viridis.rgba, -0.5, 0.5, 1);
+  const auto t3 = std::chrono::steady_clock::now();
+  for (int n = 0; n < frames; n++)
+    raster.renderField(s, TMz::fdtdFieldType::MagnitudeS, b.data(), w, h, rgb_packed_viridis.rgba, 0.0, 0.25, s.getXmin(), x1, s.getYmin(), y1);
+  const auto t4 = std::chrono::steady_clock::now();
+  const double ta = std::chrono::duration<double>(t1 - t0).count() * 1.0e3 / frames;
+  const double tb = std::chrono::duration<double>(t2 - t1).count() * 1.0e3 / frames;
+  const double tc = std::chrono::duration<double>(t3 - t2).count() * 1.0e3 / frames;
+  const double td = std::chrono::duration<double>(t4 - t3).count() * 1.0e3 / frames;
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "raster " << w << "x" << h << " (simd: " << fdtdSimdName() << "): rasterizeEz " << ta << " ms, fdtdRaster " << tb << " ms, "
+            << "at grid resolution " << tc << " ms per frame; |S| " << td << " ms" << std::endl;
+  raster.renderEz(s, b.data(), w, h, rgb_packed_viridis.rgba, -0.5, 0.5, s.getXmin(), x1, s.getYmin(), y1);
+  return sameImage(a, b);
+}
+
+// boundary/medium/source setup shared by the whole-grid solver and the subdomains
+template <typename T>
+void setupDomainCase(TMz::fdtdSolver<T>& s, 
+                     int bc,
+                     int nx,
+                     int ny,
+                     double delta)
+{
+  if (bc == 0 || bc == 3) s.setAbsorbingX();
+  if (bc == 2 || bc == 4) s.setPECX();
+  const int glass = s.defineMaterial(1.0, 2.5, 0.0, 0.0);
+  (void) glass;
+  s.sourcePlace((bc % 2 == 0 ? 0.3 : 0.7) * nx * delta, (bc < 3 ? 1.0 : ny - 2.0) * delta);
+  if (bc == 5) s.sourceType(RickerPulse);
+}
+
+// each rank is a forked process talking over local sockets; rank 0 gathers the fields
+// and compares them with the whole-grid solver
+template <typename T>
+bool testDomain(double delta)
+{
+  const int nx = 123;
+  const int ny = 97;
+  const int steps = 157;
+  for (int p = 1; p <= 4; p++) {
+    for (int bc = 0; bc < 6; bc++) {
+      int fds[2 * 4 * 4];
+      if (!fdtdSocketTransport::connectLocal(p, fds)) return false;
+      int rank = 0;
+      pid_t children[4];
+      for (int q = 1; q < p; q++) {
+        const pid_t pid = fork();
+        if (pid == 0) { rank = q; break; }
+        children[q] = pid;
+      }
+
+      fdtdSocketTransport comm(rank, p, fds);
+      TMz::fdtdDomain<T> dom;
+      bool ok = dom.initialize(&comm, nx, ny, 0.0, 0.0, delta);
+      // (the local settings come before the y boundary in the odd cases)
+      if (bc % 2 == 1) { setupDomainCase(dom.local(), bc, nx, ny, delta); dom.paintMaterial(1, 40, 20, 80, 60); }
+      if (bc == 0 || bc == 1) ok = ok && dom.setAbsorbingY();
+      if (bc == 2 || bc == 5) ok = ok && dom.setPECY();
+      if (bc == 3) ok = ok && dom.setPECY() && dom.setPeriodicY();
+      if (bc % 2 == 0) { setupDomainCase(dom.local(), bc, nx, ny, delta); dom.paintMaterial(1, 40, 20, 80, 60); }
+      ok = ok && dom.advance(steps);
+
+      std::vector<T> ez(nx * ny), hx(nx * ny), hy(nx * ny);
+      ok = ok && dom.gather(ez.data(), hx.data(), hy.data());
+      if (rank != 0) _exit(ok ? 0 : 1);
+
+      for (int q = 1; q < p; q++) {
+        int status = 0;
+        waitpid(children[q], &status, 0);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+      }
+      fdtdSocketTransport::closeLocal(p, fds);
+      if (!ok) return false;
+
+      TMz::fdtdSolver<T> ref;
+      ref.initialize(nx, ny, 0.0, 0.0, delta);
+      if (bc == 0 || bc == 1) ref.setAbsorbingY();
+      if (bc == 2 || bc == 5) ref.setPECY();
+      setupDomainCase(ref, bc, nx, ny, delta);
+      ref.paintMaterial(1, 40, 20, 80, 60);
+      ref.advance(steps);
+
+      const size_t bytes = sizeof(T) * nx * ny;
+      if (std::memcmp(ez.data(), ref.dataEz(), bytes) != 0 ||
+          std::memcmp(hx.data(), ref.dataHx(), bytes) != 0 ||
+          std::memcmp(hy.data(), ref.dataHy(), bytes) != 0) {
+        std::cout << "domain mismatch: " << p << " ranks, case " << bc << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// a subdomain solver set up beyond what the slab split handles is refused before any step
+template <typename T>
+bool testDomainRefusals(double delta)
+{
+  int fds[2];
+  if (!fdtdSocketTransport::connectLocal(1, fds)) return false;
+  fdtdSocketTransport comm(0, 1, fds);
+  TMz::fdtdDomain<T> dom;
+  bool ok = dom.initialize(&comm, 64, 48, 0.0, 0.0, delta);
+  dom.local().setStencil(TMz::fdtdStencilType::FourthOrder);
+  ok = ok && !dom.advance(1) && dom.local().getUpdateCount() == 0;
+  dom.local().setStencil(TMz::fdtdStencilType::SecondOrder);
+  ok = ok && dom.local().setIntegrator(TMz::fdtdIntegratorType::FourthOrderInTime);
+  ok = ok && !dom.advance(1);
+  ok = ok && dom.local().setCourant(1.6) && !dom.advance(1) && dom.local().getUpdateCount() == 0;
+  dom.local().setIntegrator(TMz::fdtdIntegratorType::Leapfrog);
+  ok = ok && dom.local().setCPMLY() && !dom.advance(1) && dom.local().getUpdateCount() == 0;
+  ok = ok && dom.setAbsorbingY();
+  ok = ok && dom.advance(1) && dom.local().getUpdateCount() == 1;
+  fdtdSocketTransport::closeLocal(1, fds);
+  if (!ok) std::cout << "domain: unsupported local solver not refused" << std::endl;
+  return ok;
+}
+
+template <typename T>
+bool runBench(double delta, 
+              const char* label)
+{
+  const int dims[3][2] = { {300, 175}, {1000, 1000}, {2000, 2000} };
+  const int steps[3] = { 400, 48, 16 };
+  std::cout << label << " (simd: " << fdtdSimdName() << ")" << std::endl;
+  std::cout << std::fixed << std::setprecision(1);
+  for (int k = 0; k < 3; k++) {
+    const int nx = dims[k][0];
+    const int ny = dims[k][1];
+    TMz::fdtdSolver<T> sim;
+    if (!sim.initialize(nx, ny, -0.5 * delta * nx, -0.5 * delta * ny, delta)) return false;
+    sim.sourcePlace(0.0, 0.0);
+    sim.setActivityTracking(false); // full-grid throughput
+    sim.setKernel(TMz::fdtdKernelType::Reference);
+    const double mref = benchmark(sim, steps[k]);
+    sim.setKernel(TMz::fdtdKernelType::Tiled);
+    const double mtiled = benchmark(sim, steps[k]);
+    sim.setAbsorbingY(); // periodic y is not blocked in time
+    const double mblocked = benchmarkAdvance(sim, steps[k]);
+    const int nt = sim.setThreads(std::thread::hardware_concurrency());
+    const double mthreads = benchmarkAdvance(sim, steps[k]);
+    sim.setThreads(1);
+    std::cout << nx << "x" << ny << ": reference " << mref << ", tiled " << mtiled << ", temporal blocking " << mblocked 
+              << ", " << nt << " threads " << mthreads << " Mcells/s" << std::endl;
+  }
+  return true;
+}
+
+// lossless closed (PEC) box with an initial Gaussian; the total energy should stay put
+template <typename T>
+void energyHistory(TMz::fdtdSolver<T>& sim, 
+                   double delta,
+                   int steps,
+                   int every,
+                   std::vector<double>& U)
+{
+  sim.initialize(300, 175, 0.0, 0.0, delta);
+  sim.sourceType(NoSource);
+  sim.setPECX();
+  sim.setPECY();
+  sim.superimposeGaussian(150.0, 87.0, 10.0, 10.0);
+  U.clear();
+  for (int n = 0; n <= steps; n++) {
+    if (n % every == 0) U.push_back(sim.energyE() + sim.energyB());
+    sim.update();
+  }
+}
+
+// energy drift of the single precision solver against the double precision one
+// time for the same simulated time with the two integrators (a PEC box, the leapfrog at its limit)
+void integratorCost(double delta)
+{
+  const int leapfrogSteps = 600;
+  const double S[2] = { courant_factor, 1.5 };
+  double ms[2];
+  for (int i = 0; i < 2; i++) {
+    TMz::fdtdSolver<double> sim;
+    sim.initialize(300, 300, 0.0, 0.0, delta);
+    sim.sourceType(NoSource);
+    sim.setPECX();
+    sim.setPECY();
+    sim.superimposeGaussian(150.0, 150.0, 10.0, 10.0);
+    if (i == 1) { sim.setIntegrator(TMz::fdtdIntegratorType::FourthOrderInTime); sim.setCourant(S[i]); }
+    const int steps = static_cast<int>(leapfrogSteps * S[0] / S[i] + 0.5);
+    const auto t0 = std::chrono::steady_clock::now();
+    sim.advance(steps);
+    const auto t1 = std::chrono::steady_clock::now();
+    ms[i] = std::chrono::duration<double, std::milli>(t1 - t0).count();
+  }
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "same simulated time (300x300): leapfrog at S = " << S[0] << " " << std::setprecision(1) << ms[0] << " ms, fourth order at S = " 
+            << std::setprecision(3) << S[1] << " " << std::setprecision(1) << ms[1] << " ms (" << std::setprecision(2) << ms[1] / ms[0] << " times)" << std::endl;
+}
+
+bool accuracyReport(double delta)
+{
+  integratorCost(delta);
+
+  const int steps = 20000;
+  const int every = 2000;
+  TMz::fdtdSolver<double> simd;
+  TMz::fdtdSolver<float> sims;
+  std::vector<double> Ud;
+  std::vector<double> Us;
+  energyHistory(simd, delta, steps, every, Ud);
+  energyHistory(sims, delta, steps, every, Us);
+
+  std::cout << std::scientific << std::setprecision(3);
+  std::cout << "step, drift(double), drift(float), float - double (relative)" << std::endl;
+  double worst = 0.0;
+  for (size_t i = 0; i < Ud.size(); i++) {
+    const double dd = (Ud[i] - Ud[0]) / Ud[0];
+    const double ds = (Us[i] - Us[0]) / Us[0];
+    const double rel = (Us[i] - Ud[i]) / Ud[i];
+    if (std::fabs(rel) > worst) worst = std::fabs(rel);
+    std::cout << i * every << ", " << dd << ", " << ds << ", " << rel << std::endl;
+  }
+
+  double sum2 = 0.0;
+  double dif2 = 0.0;
+  for (int i = 0; i < simd.size(); i++) {
+    const double e = simd.dataEz()[i];
+    sum2 += e * e;
+    dif2 += (sims.dataEz()[i] - e) * (sims.dataEz()[i] - e);
+  }
+  std::cout << "relative L2 difference of Ez after " << steps << " steps: " << std::sqrt(dif2 / sum2) << std::endl;
+
+  return worst < 1.0e-4;
+}
+
+int main(int argc, 
+         const char** argv)
+{
+  if (argc != 2) {
+    std::cout << "need one argument" << std::endl;
+    return 1;
+  }
+
+  const double delta = 1.0e-3;
+
+  if (std::string(argv[1]) == "smoke")
+  {
+    TMz::fdtdSolver<> sim;
+
+    // grids below the minimum size must be rejected
+    if (sim.initialize(8, 8, 0.0, 0.0, delta)) return 1;
+
+    // the same object can be re-initialized at a different resolution
+    const int dims[3][2] = { {300, 175}, {64, 48}, {521, 333} };
+    for (int k = 0; k < 3; k++) {
+      const int nx = dims[k][0];
+      const int ny = dims[k][1];
+      if (!sim.initialize(nx, ny, -0.5 * delta * nx, -0.5 * delta * ny, delta)) return 1;
+      if (sim.getNX() != nx || sim.getNY() != ny) return 1;
+      sim.sourcePlace(0.0, 0.0);
+      sim.setAbsorbingX();
+      if (sim.getMediumType() != TMz::LosslessMedium) return 1;
+      if (k == 1) {
+        sim.setDamping(10.0);
+        if (sim.getMediumType() != TMz::UniformMedium) return 1;
+      }
+      for (int n = 0; n < 200; n++) sim.update();
+      const double uE = sim.energyE();
+      if (!std::isfinite(uE) || uE <= 0.0) return 1;
+    }
+  }
+  else if (std::string(argv[1]) == "tiled")
+  {
+    if (!testTiled<double>(delta)) return 1;
+    if (!testTiled<float>(delta)) return 1;
+  }
+  else if (std::string(argv[1]) == "advance")
+  {
+    if (!testAdvance<double>(delta)) return 1;
+    if (!testAdvance<float>(delta)) return 1;
+  }
+  else if (std::string(argv[1]) == "materials")
+  {
+    if (!testMaterials<double>(delta)) return 1;
+    if (!testMaterials<float>(delta)) return 1;
+  }
+  else if (std::string(argv[1]) == "threads")
+  {
+    if (!testThreads<double>(delta)) return 1;
+    if (!testThreads<float>(delta)) return 1;
+  }
+  else if (std::string(argv[1]) == "domain")
+  {
+    if (!testDomain<double>(delta)) return 1;
+    if (!testDomain<float>(delta)) return 1;
+    if (!testDomainRefusals<double>(delta)) return 1;
+    if (!testDomainRefusals<float>(delta)) return 1;
+  }
+  else if (std::string(argv[1]) == "cpml")
+  {
+    if (!testCPML<double>(delta)) return 1;
+    if (!testCPML<float>(delta)) return 1;
+    const double rpml = edgeReflection(delta, 0);
+    const double rmur = edgeReflection(delta, 1);
+    std::cout << std::scientific << std::setprecision(3);
+    std::cout << "edge reflection (max relative to peak): cpml " << rpml << ", mur " << rmur << std::endl;
+    if (!(rpml < 1.0e-2)) return 1;
+  }
+  else if (std::string(argv[1]) == "activity")
+  {
+    if (!testActivity<double>(delta)) return 1;
+    if (!testActivity<float>(delta)) return 1;
+  }
+  else if (std::string(argv[1]) == "stencil")
+  {
+    if (!testStencil<double>(delta)) return 1;
+    if (!testStencil<float>(delta)) return 1;
+    if (!dispersionReport(delta)) return 1;
+  }
+  else if (std::string(argv[1]) == "integrator")
+  {
+    if (!testIntegrator<double>(delta)) return 1;
+    if (!testIntegrator<float>(delta)) return 1;
+    if (!integratorStability(delta)) return 1;
+    if (!integratorDispersion(delta)) return 1;
+  }
+  else if (std::string(argv[1]) == "symmetry")
+  {
+    if (!testSymmetry<double>(delta)) return 1;
+    if (!testSymmetry<float>(delta)) return 1;
+    if (!symmetryEquivalence(delta)) return 1;
+    if (!periodicCorners(delta)) return 1;
+  }
+  else if (std::string(argv[1]) == "bloch")
+  {
+    if (!testBloch<double>(delta)) return 1;
+    if (!testBloch<float>(delta)) return 1;
+    if (!blochDispersion(delta)) return 1;
+  }
+  else if (std::string(argv[1]) == "subgrid")
+  {
+    if (!testSubgrid<double>(delta)) return 1;
+    if (!testSubgrid<float>(delta)) return 1;
+    std::cout << std::scientific << std::setprecision(3);
+    std::cout << "patch interface reflection (max relative to peak):";
+    for (int r = 2; r <= 4; r++) {
+      const double R = subgridReflection(delta, r);
+      std::cout << " " << r << "x " << R;
+      if (!(R < 1.0e-2)) return 1;
+    }
+    std::cout << std::endl;
+  }
+  else if (std::string(argv[1]) == "graded")
+  {
+    if (!testGraded<double>(delta)) return 1;
+    if (!testGraded<float>(delta)) return 1;
+    if (!gradedEnergy(delta)) return 1;
+    std::cout << std::scientific << std::setprecision(3);
+    std::cout << "graded band reflection (max relative to peak):";
+    for (int r = 2; r <= 4; r++) {
+      const double R = gradedReflection(delta, r);
+      std::cout << " " << r << "x " << R;
+      if (!(R < 1.0e-3)) return 1;
+    }
+    std::cout << std::endl;
+  }
+  else if (std::string(argv[1]) == "raster")
+  {
+    if (!testRaster<double>(delta)) return 1;
+    if (!testRaster<float>(delta)) return 1;
+    if (!testRasterFields<double>(delta)) return 1;
+    if (!testRasterFields<float>(delta)) return 1;
+    if (!testRasterRange<double>(delta)) return 1;
+    if (!testRasterRange<float>(delta)) return 1;
+    if (!testRasterPyramid<double>(delta)) return 1;
+    if (!testRasterPyramid<float>(delta)) return 1;
+    if (!rasterBench(delta)) return 1;
+  }
+  else if (std::string(argv[1]) == "diagnostics")
+  {
+    if (!testDiagnostics<double>(delta)) return 1;
+    if (!testDiagnostics<float>(delta)) return 1;
+    if (!testDiagnosticsActive<double>(delta)) return 1;
+    if (!testDiagnosticsActive<float>(delta)) return 1;
+    if (!energyConservation(delta)) return 1;
+  }
+  else if (std::string(argv[1]) == "accuracy")
+  {
+    if (!accuracyReport(delta)) return 1;
+  }
+  else if (std::string(argv[1]) == "bench")
+  {
+    if (!runBench<double>(delta, "double")) return 1;
+    if (!runBench<float>(delta, "float")) return 1;
+  }
+  else 
+  {
+    std::cout << "did not recognize: \"" << argv[1] << "\"" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
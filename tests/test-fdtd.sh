@@ -0,0 +1,37 @@
+rm test-fdtd*.exe
+g++ -Wall -O2 -std=c++14 -pthread -o test-fdtd.exe test-fdtd.cpp
+./test-fdtd.exe smoke && echo OK smoke
+./test-fdtd.exe tiled && echo OK tiled
+./test-fdtd.exe advance && echo OK advance
+./test-fdtd.exe materials && echo OK materials
+./test-fdtd.exe threads && echo OK threads
+./test-fdtd.exe domain && echo OK domain
+./test-fdtd.exe cpml && echo OK cpml
+./test-fdtd.exe activity && echo OK activity
+./test-fdtd.exe stencil && echo OK stencil
+./test-fdtd.exe integrator && echo OK integrator
+./test-fdtd.exe symmetry && echo OK symmetry
+./test-fdtd.exe bloch && echo OK bloch
+./test-fdtd.exe subgrid && echo OK subgrid
+./test-fdtd.exe graded && echo OK graded
+./test-fdtd.exe diagnostics && echo OK diagnostics
+./test-fdtd.exe raster && echo OK raster
+./test-fdtd.exe accuracy && echo OK accuracy
+./test-fdtd.exe bench
+# native vector build; FMA contraction would break the bit-exact comparisons
+g++ -Wall -O2 -std=c++14 -march=native -ffp-contract=off -pthread -o test-fdtd-native.exe test-fdtd.cpp
+./test-fdtd-native.exe tiled && echo OK native tiled
+./test-fdtd-native.exe advance && echo OK native advance
+./test-fdtd-native.exe materials && echo OK native materials
+./test-fdtd-native.exe threads && echo OK native threads
+./test-fdtd-native.exe cpml && echo OK native cpml
+./test-fdtd-native.exe activity && echo OK native activity
+./test-fdtd-native.exe stencil && echo OK native stencil
+./test-fdtd-native.exe integrator && echo OK native integrator
+./test-fdtd-native.exe symmetry && echo OK native symmetry
+./test-fdtd-native.exe bloch && echo OK native bloch
+./test-fdtd-native.exe subgrid && echo OK native subgrid
+./test-fdtd-native.exe graded && echo OK native graded
+./test-fdtd-native.exe diagnostics && echo OK native diagnostics
+./test-fdtd-native.exe raster && echo OK native raster
+./test-fdtd-native.exe bench
@@ -1,17 +1,101 @@
 #include <emscripten.h>
 #include <cstring>
+#include <cstdlib>
+#include <cstdint>
 #include <cmath>
 
 #include "halfband.hpp"
 #include "rgb-utils.hpp"
+#include "fdtd-arena.hpp"
+#include "fdtd-simd.hpp"
+#include "fdtd-threads.hpp"
 #include "fdtd-constants.hpp"
 #include "fdtd-source.hpp"
 #include "fdtd-tmz.hpp"
+#include "fdtd-raster.hpp"
+
+#ifdef WASMEM_SINGLE_PRECISION
+typedef float wasmemScalar;
+#else
+typedef double wasmemScalar;
+#endif
+
+static TMz::fdtdSolver<wasmemScalar> sim;
+static TMz::fdtdRaster<wasmemScalar> raster;
+static TMz::fdtdRaster<wasmemScalar> gridRaster;
+static fdtdArena imageArena;
+static fdtdArena gridImageArena;
+static fdtdArena gridArena;
+static TMz::fdtdFieldType fieldView = TMz::fdtdFieldType::Ez;
+static const TMz::fdtdRaster<wasmemScalar>* lastRaster = &raster;
+static double autoMin = 0.0;
+static double autoMax = 0.0;
+static double viewXmin = 0.0; // the window of the canvas image (the whole domain while empty)
+static double viewXmax = 0.0;
+static double viewYmin = 0.0;
+static double viewYmax = 0.0;
+
+// n points centered on 0, spaced delta at the ends and delta / ratio over the middle third,
+// with a raised cosine in between (neighbouring cells differ by a few percent at most)
+static void gradedAxis(double* g,
+                       int n,
+                       double delta,
+                       double ratio)
+{
+  const double c = 0.5 * (n - 2);
+  g[0] = 0.0;
+  for (int i = 0; i < n - 1; i++) {
+    double u = (std::fabs(i - c) / c - 1.0 / 3.0) * 3.0;
+    u = (u < 0.0 ? 0.0 : (u > 1.0 ? 1.0 : u));
+    const double fine = 0.5 * (1.0 + std::cos(M_PI * u)); // 1 in the middle, 0 at the ends
+    g[i + 1] = g[i] + delta * (1.0 - (1.0 - 1.0 / ratio) * fine);
+  }
+  const double mid = 0.5 * (g[0] + g[n - 1]);
+  for (int i = 0; i < n; i++) g[i] -= mid;
+}
 
-const int NX = 300;
-const int NY = 175; // 300 / 175 = 1200 / 700 (same aspect ratio)
+// the color range of the source amplitude (if asked for, or if the range given is empty): +/- the
+// amplitude for the fields, from zero for |H|, and to its square for the quadratic quantities;
+// three decades below that with a log scale
+static void colorRange(bool useSourceAmp,
+                       double& cmin,
+                       double& cmax)
+{
+  const bool logScale = (raster.getColorScale() == TMz::fdtdColorScale::Logarithmic);
+  if (useSourceAmp || cmin >= cmax || (logScale && cmin <= 0.0)) {
+    const double srcamp = std::fabs(sim.sourceAmplitude());
+    cmin = -1.0 * srcamp;
+    cmax = srcamp;
+    if (fieldView == TMz::fdtdFieldType::MagnitudeH) {
+      cmin = 0.0;
+    } else if (fieldView == TMz::fdtdFieldType::EnergyDensity || fieldView == TMz::fdtdFieldType::MagnitudeS) {
+      cmin = 0.0;
+      cmax = srcamp * srcamp;
+    }
+    if (logScale)
+      cmin = 1.0e-3 * cmax;
+  }
+}
 
-static TMz::fdtdSolver<NX, NY> sim;
+// the window of the canvas image, within the domain (and its mirror images); the top and right
+// edges are pulled in by a hair so that the last pixel stays inside the grid
+static void viewWindow(double& xmin,
+                       double& xmax,
+                       double& ymin,
+                       double& ymax)
+{
+  const double eps = 1.0e-8 * sim.getDelta();
+  xmin = sim.getImageXmin();
+  xmax = sim.getXmax() - eps;
+  ymin = sim.getImageYmin();
+  ymax = sim.getYmax() - eps;
+  if (viewXmin < viewXmax && viewYmin < viewYmax) {
+    xmin = (viewXmin > xmin ? viewXmin : xmin);
+    xmax = (viewXmax < xmax ? viewXmax : xmax);
+    ymin = (viewYmin > ymin ? viewYmin : ymin);
+    ymax = (viewYmax < ymax ? viewYmax : ymax);
+  }
+}
 
 extern "C" {
 
@@ -22,17 +106,38 @@ void* simulatorAddress(void) {
 
 EMSCRIPTEN_KEEPALIVE
 int simulatorBytesize(void) {
-  return sizeof(sim);
+  return sizeof(sim) + sim.bytesize();
 }
 
 EMSCRIPTEN_KEEPALIVE
-void initSolver(double xmin, 
+bool initSolver(int nx,
+                int ny,
+                double xmin, 
                 double ymin, 
                 double delta)
 {
-  sim.initialize(xmin, 
-                 ymin, 
-                 delta);
+  return sim.initialize(nx,
+                        ny,
+                        xmin, 
+                        ymin, 
+                        delta);
+}
+
+// grade the mesh of the initialized solver: ratio times finer in the middle (see gradedAxis())
+EMSCRIPTEN_KEEPALIVE
+bool gradeSolverMesh(double ratio) {
+  const int nx = sim.getNX();
+  const int ny = sim.getNY();
+  const double delta = sim.getX(1) - sim.getX(0);
+  if (!gridArena.reserve(fdtdArena::footprint<double>(nx) + fdtdArena::footprint<double>(ny)))
+    return false;
+  double* x = gridArena.allocate<double>(nx);
+  double* y = gridArena.allocate<double>(ny);
+  gradedAxis(x, nx, delta, ratio);
+  gradedAxis(y, ny, delta, ratio);
+  raster.invalidate();
+  gridRaster.invalidate();
+  return sim.setGrid(x, y);
 }
 
 EMSCRIPTEN_KEEPALIVE
@@ -40,6 +145,37 @@ void takeOneTimestep(void) {
   sim.update();
 }
 
+EMSCRIPTEN_KEEPALIVE
+void takeNTimesteps(int n) {
+  sim.advance(n);
+}
+
+// Step for (about) budgetms milliseconds but at most maxsteps steps; returns the number of steps taken.
+// Steps are taken in batches sized from the measured step rate so that the clock is read rarely.
+EMSCRIPTEN_KEEPALIVE
+int takeTimestepsFor(double budgetms, 
+                     int maxsteps)
+{
+  static double msPerStep = 0.0;
+  const double t0 = emscripten_get_now();
+  int steps = 0;
+  while (steps < maxsteps) {
+    const double elapsed = emscripten_get_now() - t0;
+    const double remaining = budgetms - elapsed;
+    if (remaining <= 0.0)
+      break;
+    int batch = (msPerStep > 0.0 ? static_cast<int>(0.5 * remaining / msPerStep) : 1);
+    if (batch < 1) batch = 1;
+    if (batch > maxsteps - steps) batch = maxsteps - steps;
+    const double tb = emscripten_get_now();
+    sim.advance(batch);
+    const double tbatch = (emscripten_get_now() - tb) / batch;
+    msPerStep = (msPerStep > 0.0 ? 0.5 * (msPerStep + tbatch) : tbatch);
+    steps += batch;
+  }
+  return steps;
+}
+
 EMSCRIPTEN_KEEPALIVE
 void resetSolver(void) {
   sim.reset();
@@ -95,6 +231,42 @@ void setPECY(void) {
   sim.setPECY();
 }
 
+EMSCRIPTEN_KEEPALIVE
+bool setCPMLX(void) {
+  return sim.setCPMLX();
+}
+
+EMSCRIPTEN_KEEPALIVE
+bool getCPMLX(void) {
+  return sim.isCPMLX();
+}
+
+EMSCRIPTEN_KEEPALIVE
+bool setCPMLY(void) {
+  return sim.setCPMLY();
+}
+
+EMSCRIPTEN_KEEPALIVE
+bool getCPMLY(void) {
+  return sim.isCPMLY();
+}
+
+// symmetry plane at the left (bottom) edge: parity 1 even (PMC), -1 odd (PEC), 0 none
+static TMz::fdtdSymmetryType symmetryType(int parity) {
+  return (parity > 0 ? TMz::fdtdSymmetryType::EvenSymmetry : 
+         (parity < 0 ? TMz::fdtdSymmetryType::OddSymmetry : TMz::fdtdSymmetryType::NoSymmetry));
+}
+
+EMSCRIPTEN_KEEPALIVE
+bool setSymmetryX(int parity) {
+  return sim.setSymmetryX(symmetryType(parity));
+}
+
+EMSCRIPTEN_KEEPALIVE
+bool setSymmetryY(int parity) {
+  return sim.setSymmetryY(symmetryType(parity));
+}
+
 EMSCRIPTEN_KEEPALIVE
 void setVacuum(void) {
   sim.setVacuum();
@@ -110,6 +282,40 @@ void setDamping(double lhat) {
   sim.setDamping(lhat);
 }
 
+// spatial order of accuracy: 2 (Yee) or 4 (FDTD(2,4); meant for half the resolution, at a much shorter timestep)
+EMSCRIPTEN_KEEPALIVE
+void setStencilOrder(int order) {
+  sim.setStencil(order == 4 ? TMz::fdtdStencilType::FourthOrder : TMz::fdtdStencilType::SecondOrder);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int getStencilOrder(void) {
+  return (sim.getStencil() == TMz::fdtdStencilType::FourthOrder ? 4 : 2);
+}
+
+// temporal order of accuracy: 2 (leapfrog) or 4 (larger stable timestep, about four sweeps per step;
+// PEC or periodic edges only, returns false otherwise)
+EMSCRIPTEN_KEEPALIVE
+bool setTimeOrder(int order) {
+  return sim.setIntegrator(order == 4 ? TMz::fdtdIntegratorType::FourthOrderInTime : TMz::fdtdIntegratorType::Leapfrog);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int getTimeOrder(void) {
+  return (sim.getIntegrator() == TMz::fdtdIntegratorType::FourthOrderInTime ? 4 : 2);
+}
+
+// returns false (and keeps the timestep) above getStabilityLimit()
+EMSCRIPTEN_KEEPALIVE
+bool setCourantNumber(double c) {
+  return sim.setCourant(c);
+}
+
+EMSCRIPTEN_KEEPALIVE
+double getStabilityLimit(void) {
+  return sim.getStabilityLimit();
+}
+
 EMSCRIPTEN_KEEPALIVE
 void dropGaussian(double x, 
                   double y) 
@@ -196,6 +402,38 @@ double getDelta(void) {
   return sim.getDelta();
 }
 
+// extent of the grid (the Ez points at the corners)
+EMSCRIPTEN_KEEPALIVE
+double getXmin(void) {
+  return sim.getXmin();
+}
+
+EMSCRIPTEN_KEEPALIVE
+double getXmax(void) {
+  return sim.getXmax();
+}
+
+EMSCRIPTEN_KEEPALIVE
+double getYmin(void) {
+  return sim.getYmin();
+}
+
+EMSCRIPTEN_KEEPALIVE
+double getYmax(void) {
+  return sim.getYmax();
+}
+
+// lower corner of the displayed domain (mirror images included)
+EMSCRIPTEN_KEEPALIVE
+double getImageXmin(void) {
+  return sim.getImageXmin();
+}
+
+EMSCRIPTEN_KEEPALIVE
+double getImageYmin(void) {
+  return sim.getImageYmin();
+}
+
 EMSCRIPTEN_KEEPALIVE
 double getTimestep(void) {
   return sim.getTimestep();
@@ -211,6 +449,11 @@ int getNY(void) {
   return sim.getNY();
 }
 
+EMSCRIPTEN_KEEPALIVE
+int getScalarBytesize(void) {
+  return sizeof(wasmemScalar);
+}
+
 EMSCRIPTEN_KEEPALIVE
 double getVacuumImpedance(void) {
   return vacuum_impedance;
@@ -223,7 +466,38 @@ double getVacuumVelocity(void) {
 
 EMSCRIPTEN_KEEPALIVE
 double getCourantFactor(void) {
-  return courant_factor;
+  return sim.getCourant();
+}
+
+// reductions gathered by the update sweep (see fdtdDiagnostics); step is -1 until one was taken
+EMSCRIPTEN_KEEPALIVE
+void setDiagnostics(bool on) {
+  sim.setDiagnostics(on);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int diagnosticsStep(void) {
+  return sim.getDiagnostics().step;
+}
+
+EMSCRIPTEN_KEEPALIVE
+double diagnosticsEnergyE(void) {
+  return sim.getDiagnostics().energyE;
+}
+
+EMSCRIPTEN_KEEPALIVE
+double diagnosticsEnergyH(void) {
+  return sim.getDiagnostics().energyH;
+}
+
+EMSCRIPTEN_KEEPALIVE
+double diagnosticsMinimumEz(void) {
+  return sim.getDiagnostics().minimumEz;
+}
+
+EMSCRIPTEN_KEEPALIVE
+double diagnosticsMaximumEz(void) {
+  return sim.getDiagnostics().maximumEz;
 }
 
 EMSCRIPTEN_KEEPALIVE
@@ -236,6 +510,17 @@ double maximumEz(void) {
   return sim.maximumEz();
 }
 
+// returns 0 if the buffer could not be allocated
+EMSCRIPTEN_KEEPALIVE
+uint32_t* allocDataBuffer(int w, 
+                          int h)
+{
+  const size_t bytes = fdtdArena::footprint<uint32_t>(static_cast<size_t>(w) * h);
+  if (!imageArena.reserve(bytes))
+    return nullptr;
+  return imageArena.allocate<uint32_t>(static_cast<size_t>(w) * h);
+}
+
 EMSCRIPTEN_KEEPALIVE
 uint32_t* initDataBuffer(int offset, 
                          int w, 
@@ -256,33 +541,166 @@ void renderDataBufferTestPattern(int offset,
   sim.rasterizeTestPattern(data, w, h, viridis);
 }
 
+// what the images show: 0 Ez, 1 Hx, 2 Hy, 3 |H|, 4 energy density, 5 |S| (see fdtdFieldType; H
+// and the derived quantities in the units of Ez)
+EMSCRIPTEN_KEEPALIVE
+void setFieldView(int view) {
+  if (view >= 0 && view <= static_cast<int>(TMz::fdtdFieldType::MagnitudeS))
+    fieldView = static_cast<TMz::fdtdFieldType>(view);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int getFieldView(void) {
+  return static_cast<int>(fieldView);
+}
+
+// range of the field over the pixels of the last image (whatever the color range)
+EMSCRIPTEN_KEEPALIVE
+double renderedMinimum(void) {
+  return lastRaster->renderedMinimum();
+}
+
+EMSCRIPTEN_KEEPALIVE
+double renderedMaximum(void) {
+  return lastRaster->renderedMaximum();
+}
+
+EMSCRIPTEN_KEEPALIVE
+void setLogColorScale(bool on) {
+  const TMz::fdtdColorScale scale = (on ? TMz::fdtdColorScale::Logarithmic : TMz::fdtdColorScale::Linear);
+  raster.setColorScale(scale);
+  gridRaster.setColorScale(scale);
+}
+
+EMSCRIPTEN_KEEPALIVE
+bool isLogColorScale(void) {
+  return raster.getColorScale() == TMz::fdtdColorScale::Logarithmic;
+}
+
+// a color range from the histogram of the last image: the percentiles plo and phi, symmetric about
+// zero if asked (see fdtdRaster::autoRange()); false if the image was flat
 EMSCRIPTEN_KEEPALIVE
-void renderDataBufferEz(int offset, 
-                        int w, 
-                        int h,
-                        bool viridis,
-                        bool useSourceAmp,
-                        double cmin,
-                        double cmax)
+bool autoColorRange(double plo,
+                    double phi,
+                    bool symmetric)
 {
-  if (useSourceAmp || cmin >= cmax) {
-    const double srcamp = std::fabs(sim.sourceAmplitude());
-    cmin = -1.0 * srcamp;
-    cmax = srcamp;
-  }
+  return lastRaster->autoRange(plo, phi, symmetric, autoMin, autoMax);
+}
+
+EMSCRIPTEN_KEEPALIVE
+double autoRangeMinimum(void) {
+  return autoMin;
+}
+
+EMSCRIPTEN_KEEPALIVE
+double autoRangeMaximum(void) {
+  return autoMax;
+}
+
+// zoom and pan: the window of the canvas image (an empty one goes back to the whole domain);
+// zoomed out on a large grid the image comes from the halfband pyramid of the raster
+EMSCRIPTEN_KEEPALIVE
+void setView(double xmin,
+             double xmax,
+             double ymin,
+             double ymax)
+{
+  viewXmin = xmin;
+  viewXmax = xmax;
+  viewYmin = ymin;
+  viewYmax = ymax;
+}
+
+// the pyramid level the last canvas image was sampled from (0: the grid itself)
+EMSCRIPTEN_KEEPALIVE
+int viewPyramidLevel(void) {
+  return raster.getPyramidLevel();
+}
+
+EMSCRIPTEN_KEEPALIVE
+void renderDataBufferField(int offset, 
+                           int w, 
+                           int h,
+                           bool viridis,
+                           bool useSourceAmp,
+                           double cmin,
+                           double cmax)
+{
+  colorRange(useSourceAmp, cmin, cmax);
+
+  uint32_t* data = reinterpret_cast<uint32_t*>(offset);
+
+  double xmin, xmax, ymin, ymax;
+  viewWindow(xmin, xmax, ymin, ymax);
+  lastRaster = &raster;
+  raster.renderField(sim,
+                     fieldView,
+                     data, 
+                     w, 
+                     h, 
+                     viridis ? rgb_packed_viridis.rgba : rgb_packed_jet.rgba,
+                     cmin, 
+                     cmax, 
+                     xmin, 
+                     xmax,
+                     ymin,
+                     ymax);
+}
+
+// size of the grid resolution image: every step-th node of the whole domain (step 1: all of them)
+EMSCRIPTEN_KEEPALIVE
+int gridImageWidth(int step) {
+  return TMz::fdtdRaster<wasmemScalar>::nodesWidth(sim, step);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int gridImageHeight(int step) {
+  return TMz::fdtdRaster<wasmemScalar>::nodesHeight(sim, step);
+}
+
+// a second image buffer (the canvas one stays valid); returns 0 if it could not be allocated
+EMSCRIPTEN_KEEPALIVE
+uint32_t* allocGridBuffer(int w, 
+                          int h)
+{
+  const size_t bytes = fdtdArena::footprint<uint32_t>(static_cast<size_t>(w) * h);
+  if (!gridImageArena.reserve(bytes))
+    return nullptr;
+  return gridImageArena.allocate<uint32_t>(static_cast<size_t>(w) * h);
+}
+
+// the field at every step-th node, one pixel each, for the page to scale onto the canvas; a graded
+// mesh is sampled evenly at the same resolution instead
+EMSCRIPTEN_KEEPALIVE
+void renderGridBufferField(int offset, 
+                           int step,
+                           bool viridis,
+                           bool useSourceAmp,
+                           double cmin,
+                           double cmax)
+{
+  colorRange(useSourceAmp, cmin, cmax);
 
   uint32_t* data = reinterpret_cast<uint32_t*>(offset);
+  const uint32_t* lut = (viridis ? rgb_packed_viridis.rgba : rgb_packed_jet.rgba);
 
-  sim.rasterizeEz(data, 
-                  w, 
-                  h, 
-                  viridis,
-                  cmin, 
-                  cmax, 
-                  sim.getXmin(), 
-                  sim.getXmax() - 1.0e-8 * getDelta(),
-                  sim.getYmin(),
-                  sim.getYmax() - 1.0e-8 * getDelta());
+  lastRaster = &gridRaster;
+  if (!sim.isGraded()) {
+    gridRaster.renderFieldNodes(sim, fieldView, data, lut, cmin, cmax, step);
+    return;
+  }
+  gridRaster.renderField(sim,
+                         fieldView,
+                         data,
+                         gridImageWidth(step),
+                         gridImageHeight(step),
+                         lut,
+                         cmin,
+                         cmax,
+                         sim.getImageXmin(),
+                         sim.getXmax() - 1.0e-8 * getDelta(),
+                         sim.getImageYmin(),
+                         sim.getYmax() - 1.0e-8 * getDelta());
 }
 
 } // close extern "C"
@@ -1,19 +1,50 @@
-// Each unit is 16kb; so 512 such units should well cover 1200*700*4 bytes of image data
-const memSize = 512;
-const memory = new WebAssembly.Memory( { initial: memSize, maximum: memSize } );
+// The module owns (and exports) its memory; the solver and image buffers are heap allocated
+// and the heap may grow at runtime (which detaches any previously created views).
+var wasmMemory = null; // set once the module is instantiated
 
 var importObject = {
     env: {
-        memory,
+        emscripten_notify_memory_growth: function(index) { },
+    },
+    wasi_snapshot_preview1: {
+        // monotonic clock (nanoseconds) used by emscripten_get_now() in the standalone build
+        clock_time_get: function(clockId, precision, timePtr) {
+            const nanoseconds = BigInt(Math.round(performance.now() * 1.0e6));
+            new DataView(wasmMemory.buffer).setBigUint64(timePtr, nanoseconds, true);
+            return 0;
+        },
     },
 };
 
+// Grid size can be chosen per run, e.g. index.html?nx=2000&ny=1200
+const urlParams = new URLSearchParams(window.location.search);
+const gridNX = parseInt(urlParams.get('nx') || '300');
+const gridNY = parseInt(urlParams.get('ny') || '175'); // 300 / 175 = 1200 / 700 (same aspect ratio)
+// and graded, e.g. index.html?grade=3 for cells three times smaller over the middle third
+const gridGrade = parseFloat(urlParams.get('grade') || '1');
+// and halved by a symmetry plane through the center, e.g. index.html?mirrorx=even&mirrory=odd
+// (even: PMC plane, odd: PEC plane); the image shows the whole domain
+const parityOf = { 'even': 1, 'odd': -1 };
+const mirrorX = parityOf[urlParams.get('mirrorx')] || 0;
+const mirrorY = parityOf[urlParams.get('mirrory')] || 0;
+// and rendered at screen resolution (interpolated), at grid resolution (one pixel per node, scaled
+// by the browser), or as a reduced resolution preview, e.g. index.html?render=grid
+const renderModes = ['screen', 'grid', 'preview'];
+const initialRenderMode = Math.max(0, renderModes.indexOf(urlParams.get('render') || 'screen'));
+
 WebAssembly.instantiateStreaming(fetch('wasmem.wasm'), importObject)
 .then((results) =>
 {
+    wasmMemory = results.instance.exports.memory;
+
+    if (results.instance.exports._initialize)
+        results.instance.exports._initialize();
+
     var initSolver = results.instance.exports.initSolver;
     var resetSolver = results.instance.exports.resetSolver;
     var takeOneTimestep = results.instance.exports.takeOneTimestep;
+    var takeNTimesteps = results.instance.exports.takeNTimesteps;
+    var takeTimestepsFor = results.instance.exports.takeTimestepsFor;
 
     var getPeriodicX = results.instance.exports.getPeriodicX;
     var setPeriodicX = results.instance.exports.setPeriodicX;
@@ -26,25 +57,49 @@ WebAssembly.instantiateStreaming(fetch('wasmem.wasm'), importObject)
     var setAbsorbingY = results.instance.exports.setAbsorbingY;
     var setPECX = results.instance.exports.setPECX;
     var setPECY = results.instance.exports.setPECY;
+    var setCPMLX = results.instance.exports.setCPMLX;
+    var getCPMLX = results.instance.exports.getCPMLX;
+    var setCPMLY = results.instance.exports.setCPMLY;
+    var getCPMLY = results.instance.exports.getCPMLY;
+    var setSymmetryX = results.instance.exports.setSymmetryX;
+    var setSymmetryY = results.instance.exports.setSymmetryY;
 
     var applyHalfbandFilter = results.instance.exports.applyHalfbandFilter;
 
     var setVacuum = results.instance.exports.setVacuum;
     var isVacuum = results.instance.exports.isVacuum;
     var setDamping = results.instance.exports.setDamping;
+    var setStencilOrder = results.instance.exports.setStencilOrder;
+    var getStencilOrder = results.instance.exports.getStencilOrder;
+    var setTimeOrder = results.instance.exports.setTimeOrder;
+    var getTimeOrder = results.instance.exports.getTimeOrder;
+    var setCourantNumber = results.instance.exports.setCourantNumber;
 
     var simulatorAddress = results.instance.exports.simulatorAddress;
     var simulatorBytesize = results.instance.exports.simulatorBytesize;
 
     var getNX = results.instance.exports.getNX;
     var getNY = results.instance.exports.getNY;
+    var getScalarBytesize = results.instance.exports.getScalarBytesize;
     var getVacuumImpedance = results.instance.exports.getVacuumImpedance;
     var getVacuumVelocity = results.instance.exports.getVacuumVelocity;
     var getCourantFactor = results.instance.exports.getCourantFactor;
     var getDelta = results.instance.exports.getDelta;
+    var gradeSolverMesh = results.instance.exports.gradeSolverMesh;
+    var getXmin = results.instance.exports.getXmin;
+    var getXmax = results.instance.exports.getXmax;
+    var getYmin = results.instance.exports.getYmin;
+    var getYmax = results.instance.exports.getYmax;
+    var getImageXmin = results.instance.exports.getImageXmin;
+    var getImageYmin = results.instance.exports.getImageYmin;
     var getTimestep = results.instance.exports.getTimestep;
-    var minimumEz = results.instance.exports.minimumEz;
-    var maximumEz = results.instance.exports.maximumEz;
+
+    var setDiagnostics = results.instance.exports.setDiagnostics;
+    var diagnosticsStep = results.instance.exports.diagnosticsStep;
+    var diagnosticsEnergyE = results.instance.exports.diagnosticsEnergyE;
+    var diagnosticsEnergyH = results.instance.exports.diagnosticsEnergyH;
+    var diagnosticsMinimumEz = results.instance.exports.diagnosticsMinimumEz;
+    var diagnosticsMaximumEz = results.instance.exports.diagnosticsMaximumEz;
 
     var dropGaussian = results.instance.exports.dropGaussian;
     var fieldEnergyE = results.instance.exports.fieldEnergyE;
@@ -62,26 +117,48 @@ WebAssembly.instantiateStreaming(fetch('wasmem.wasm'), importObject)
     var sourceSquare = results.instance.exports.sourceSquare;
     var sourceSaw = results.instance.exports.sourceSaw;
 
+    var allocDataBuffer = results.instance.exports.allocDataBuffer;
     var initDataBuffer = results.instance.exports.initDataBuffer;
     var renderDataBufferTestPattern = results.instance.exports.renderDataBufferTestPattern;
-    var renderDataBufferEz = results.instance.exports.renderDataBufferEz;
+    var renderDataBufferField = results.instance.exports.renderDataBufferField;
+    var gridImageWidth = results.instance.exports.gridImageWidth;
+    var gridImageHeight = results.instance.exports.gridImageHeight;
+    var allocGridBuffer = results.instance.exports.allocGridBuffer;
+    var renderGridBufferField = results.instance.exports.renderGridBufferField;
+    var setFieldView = results.instance.exports.setFieldView;
+    var getFieldView = results.instance.exports.getFieldView;
+    var setLogColorScale = results.instance.exports.setLogColorScale;
+    var isLogColorScale = results.instance.exports.isLogColorScale;
+    var autoColorRange = results.instance.exports.autoColorRange;
+    var autoRangeMinimum = results.instance.exports.autoRangeMinimum;
+    var autoRangeMaximum = results.instance.exports.autoRangeMaximum;
+    var setView = results.instance.exports.setView;
+    var viewPyramidLevel = results.instance.exports.viewPyramidLevel;
 
     const dx = 1.0e-3; // 1mm per point
     const dppw = 1.0;
 
     var skinLength = 10.0; // points per skinlength (if damped medium)
+    var timeOrder4Courant = 1.5; // Courant number with fourth order time integration (stable up to 2.013)
 
     var showStats = true;
     var showTestPattern = false;
     var pauseUpdater = false;
 
+    var stepsPerFrame = 1;       // fixed number of timesteps per rendered frame
+    var useStepBudget = false;   // or: step for a fixed wall-clock budget per frame
+    const stepBudgetMs = 12.0;
+    const maxStepsPerFrame = 4096;
+
     var simTime = 0.0;
 
     var sourceName = 'sine';
     var useViridis = true;
-    var useSourceColorValue = true;
+    const colorModes = ['source', 'auto', 'hold']; // source amplitude, percentiles of each frame, the last of those
+    var colorMode = 0;
     var minColorValue = 0.0;
     var maxColorValue = 0.0;
+    const fieldViews = ['Ez', 'eta0 Hx', 'eta0 Hy', 'eta0 |H|', 'energy density / eps0', 'eta0 |S|']; // (setFieldView() order)
     
     function keyDownEvent(e)
     {
@@ -149,23 +226,41 @@ WebAssembly.instantiateStreaming(fetch('wasmem.wasm'), importObject)
         }
 
         if (key == 'c' || key == 'C') {
-            useSourceColorValue = !useSourceColorValue;
-            if (!useSourceColorValue) {
-                minColorValue = minimumEz();
-                maxColorValue = maximumEz();
+            colorMode = (colorMode + 1) % colorModes.length;
+            if (colorMode == 1) updateAutoRange();
+            if (colorMode == 2) {
                 console.log(['cmin = ' + minColorValue]);
                 console.log(['cmax = ' + maxColorValue]);
             }
         }
 
+        if (key == 'l' || key == 'L') {
+            setLogColorScale(!isLogColorScale());
+            if (colorMode == 2) colorMode = 1; // (the range held is for the other scale)
+            if (colorMode == 1) updateAutoRange();
+        }
+
         if (key == 's' || key == 'S') {
             showStats = !showStats;
+            setDiagnostics(showStats);
         }
 
         if (key == 'z' || key == 'Z') {
             showTestPattern = !showTestPattern;
         }
 
+        if (key == ']') {
+            if (stepsPerFrame < maxStepsPerFrame) stepsPerFrame *= 2;
+        }
+
+        if (key == '[') {
+            if (stepsPerFrame > 1) stepsPerFrame /= 2;
+        }
+
+        if (key == 't' || key == 'T') {
+            useStepBudget = !useStepBudget;
+        }
+
         if (key == 'p' || key == 'P') {
             pauseUpdater = !pauseUpdater;
         }
@@ -177,14 +272,18 @@ WebAssembly.instantiateStreaming(fetch('wasmem.wasm'), importObject)
 
         if (key == 'x' || key == 'X') { // cycle boundary condition style for X dimension
             if (getPeriodicX()) setAbsorbingX(); 
-                else if (getAbsorbingX()) setPECX();
-                    else setPeriodicX();
+                else if (getAbsorbingX()) setCPMLX();
+                    else if (getCPMLX()) setPECX();
+                        else if (mirrorX != 0) setAbsorbingX(); // (periodic would remove the plane)
+                            else setPeriodicX();
         }
 
         if (key == 'y' || key == 'Y') { // cycle BC for Y dimension
             if (getPeriodicY()) setAbsorbingY(); 
-                else if (getAbsorbingY()) setPECY();
-                    else setPeriodicY();
+                else if (getAbsorbingY()) setCPMLY();
+                    else if (getCPMLY()) setPECY();
+                        else if (mirrorY != 0) setAbsorbingY();
+                            else setPeriodicY();
         }
 
         if (key == 'd' || key == 'D') {
@@ -195,6 +294,15 @@ WebAssembly.instantiateStreaming(fetch('wasmem.wasm'), importObject)
             }
         }
 
+        if (key == 'o' || key == 'O') {
+            setStencilOrder(getStencilOrder() == 4 ? 2 : 4);
+        }
+
+        if (key == 'i' || key == 'I') { // fourth order time integration at a larger timestep (PEC/periodic edges)
+            if (getTimeOrder() == 4) setTimeOrder(2);
+                else if (setTimeOrder(4)) setCourantNumber(timeOrder4Courant);
+        }
+
         if (key == 'a' || key == 'A') {
             sourceAdditive(!isSourceAdditive());
         }
@@ -204,8 +312,9 @@ WebAssembly.instantiateStreaming(fetch('wasmem.wasm'), importObject)
         }
 
         if (key == 'e' || key == 'E') {
-            const uE = fieldEnergyE() * 1.0e15; // femto-joule
-            const uB = fieldEnergyB() * 1.0e15;
+            const fused = (diagnosticsStep() >= 0);
+            const uE = (fused ? diagnosticsEnergyE() : fieldEnergyE()) * 1.0e15; // femto-joule
+            const uB = (fused ? diagnosticsEnergyH() : fieldEnergyB()) * 1.0e15;
             const splitE = uE / (uE + uB);
             console.log('uE + uB = ' + (uE + uB) + ' [fJ / m]; fract.(E) = ' + splitE.toFixed(4));
         }
@@ -217,6 +326,29 @@ WebAssembly.instantiateStreaming(fetch('wasmem.wasm'), importObject)
         if (key == 'k' || key == 'K') {
             useViridis = !useViridis;
         }
+
+        if (key == 'm' || key == 'M') {
+            setRenderMode((renderMode + 1) % renderModes.length);
+        }
+
+        if (key == 'f' || key == 'F') {
+            setViewWindow(getImageXmin(), getImageYmin(), domainWidth); // fit the whole domain
+        }
+
+        if (key == 'v' || key == 'V') {
+            setFieldView((getFieldView() + 1) % fieldViews.length);
+            if (colorMode == 2) colorMode = 0; // (the range held is in other units)
+        }
+    }
+
+    // the 1% and 99% points of the last image (symmetric about zero for the signed fields), for
+    // the next one; its range when the image was flat
+    function updateAutoRange()
+    {
+        if (autoColorRange(0.01, 0.99, getFieldView() <= 2 && !isLogColorScale())) {
+            minColorValue = autoRangeMinimum();
+            maxColorValue = autoRangeMaximum();
+        }
     }
 
     /*function keyUpEvent(e)
@@ -225,39 +357,108 @@ WebAssembly.instantiateStreaming(fetch('wasmem.wasm'), importObject)
         var key = e.key;
     }*/
 
-    console.log('sim data ptr = ' + simulatorAddress());
-    console.log('sim bytesize = ' + simulatorBytesize());
-
     const canvas = document.getElementById('canvas');
     const width = canvas.width;
     const height = canvas.height;
 
     console.log('width,height=' + width.toFixed(0) + ',' + height.toFixed(0));
-    console.log(results.instance.exports.memory.buffer);
 
-    const safeImageDataByteOffset = simulatorAddress() + simulatorBytesize(); // place image buffer memory after simulation object
-    const imageDataBytesize = width * height * 4;
+    const xmin = (mirrorX != 0 ? 0.0 : -1.0 * dx * gridNX / 2.0);
+    const ymin = (mirrorY != 0 ? 0.0 : -1.0 * dx * gridNY / 2.0);
+    const solverNX = (mirrorX != 0 ? Math.floor(gridNX / 2) + 1 : gridNX);
+    const solverNY = (mirrorY != 0 ? Math.floor(gridNY / 2) + 1 : gridNY);
 
-    if (memory.byteLength < safeImageDataByteOffset + imageDataBytesize) {
-        throw "not enough memory in WASM environment";
+    if (!initSolver(solverNX, solverNY, xmin, ymin, dx)) { // place (0,0) at center of grid 
+        throw "could not allocate a " + solverNX + "x" + solverNY + " solver in WASM environment";
+    }
+
+    if (gridGrade > 1.0 && (mirrorX != 0 || mirrorY != 0)) {
+        throw "a graded mesh is centered on the domain; it does not combine with symmetry planes";
     }
 
-    const dataArray = new Uint8ClampedArray(results.instance.exports.memory.buffer, safeImageDataByteOffset, imageDataBytesize);
-    const img = new ImageData(dataArray, width, height);
+    if (gridGrade > 1.0 && !gradeSolverMesh(gridGrade)) {
+        throw "could not grade the mesh by " + gridGrade;
+    }
 
-    console.log(dataArray.byteOffset);
-    console.log(dataArray.length);
+    if (mirrorX != 0) setSymmetryX(mirrorX);
+    if (mirrorY != 0) setSymmetryY(mirrorY);
 
-    const dataPtr = initDataBuffer(dataArray.byteOffset, width, height);
+    console.log('sim data ptr = ' + simulatorAddress());
+    console.log('sim bytesize = ' + simulatorBytesize());
+
+    const dataPtr = allocDataBuffer(width, height);
+    if (dataPtr == 0) {
+        throw "not enough memory in WASM environment";
+    }
+    initDataBuffer(dataPtr, width, height);
     console.log('img data ptr = ' + dataPtr);
 
-    const xmin = -1.0 * dx * getNX() / 2.0;
-    const ymin = -1.0 * dx * getNY() / 2.0;
+    const imageDataBytesize = width * height * 4;
+    var dataArray = null;
+    var img = null;
+
+    function refreshImageView() // (re)create the views whenever the memory has grown
+    {
+        const buffer = results.instance.exports.memory.buffer;
+        if (dataArray === null || dataArray.buffer !== buffer) {
+            dataArray = new Uint8ClampedArray(buffer, dataPtr, imageDataBytesize);
+            img = new ImageData(dataArray, width, height);
+        }
+    }
+
+    refreshImageView();
+
+    // Grid resolution images are colored one pixel per node (every previewStep-th node for the
+    // preview, which keeps it within a quarter of the canvas) and drawn scaled onto the canvas, so
+    // their cost goes with the number of nodes; the buffer is allocated when a mode is first chosen
+    var previewStep = 2;
+    while (gridImageWidth(previewStep) > width / 2 || gridImageHeight(previewStep) > height / 2) previewStep++;
+    const gridCanvas = document.createElement('canvas');
+    const gridCtx = gridCanvas.getContext('2d');
+    var renderMode = 0;
+    var gridStep = 1;
+    var gridPtr = 0;
+    var gridArray = null;
+    var gridImg = null;
+
+    function setRenderMode(mode)
+    {
+        if (mode == 0) {
+            renderMode = 0;
+            return;
+        }
+        const step = (mode == 1 ? 1 : previewStep);
+        const w = gridImageWidth(step);
+        const h = gridImageHeight(step);
+        const ptr = allocGridBuffer(w, h);
+        if (ptr == 0) {
+            console.log('no memory for a ' + w + 'x' + h + ' grid image; staying at screen resolution');
+            renderMode = 0;
+            return;
+        }
+        renderMode = mode;
+        gridStep = step;
+        gridPtr = ptr;
+        gridCanvas.width = w;
+        gridCanvas.height = h;
+        gridArray = null;
+        refreshGridView();
+    }
+
+    function refreshGridView()
+    {
+        const buffer = results.instance.exports.memory.buffer;
+        if (gridArray === null || gridArray.buffer !== buffer) {
+            gridArray = new Uint8ClampedArray(buffer, gridPtr, gridCanvas.width * gridCanvas.height * 4);
+            gridImg = new ImageData(gridArray, gridCanvas.width, gridCanvas.height);
+        }
+    }
 
-    initSolver(xmin, ymin, dx); // place (0,0) at center of grid 
+    setRenderMode(initialRenderMode);
 
     console.log('NX = ' + getNX());
     console.log('NY = ' + getNY());
+    console.log('precision = ' + (getScalarBytesize() == 4 ? 'single' : 'double'));
     console.log('delta = ' + getDelta() + ' [m]');
     console.log('timestep = ' + getTimestep() + '[s]');
     console.log('Courant factor = ' + getCourantFactor());
@@ -265,8 +466,27 @@ WebAssembly.instantiateStreaming(fetch('wasmem.wasm'), importObject)
     console.log('vacuum velocity = ' + getVacuumVelocity());
     console.log('isVacuum() = ' + isVacuum());
 
-    const domainWidth = getDelta() * getNX();
-    const domainHeight = getDelta() * getNY();
+    setDiagnostics(showStats);
+
+    const domainWidth = getXmax() - getImageXmin(); // (the rasterizer spans the grid points and their mirror images)
+    const domainHeight = getYmax() - getImageYmin();
+
+    // the window shown: the lower left corner and the width (the height keeps the domain's aspect),
+    // kept inside the domain and at least a few cells wide
+    var viewX0 = getImageXmin();
+    var viewY0 = getImageYmin();
+    var viewWidth = domainWidth;
+    var viewHeight = domainHeight;
+
+    function setViewWindow(x0, y0, w)
+    {
+        viewWidth = Math.min(domainWidth, Math.max(w, 16.0 * getDelta()));
+        viewHeight = viewWidth * domainHeight / domainWidth;
+        viewX0 = Math.min(Math.max(x0, getImageXmin()), getXmax() - viewWidth);
+        viewY0 = Math.min(Math.max(y0, getImageYmin()), getYmax() - viewHeight);
+        if (viewWidth >= domainWidth) setView(0.0, 0.0, 0.0, 0.0); // (the whole domain, as at the start)
+        else setView(viewX0, viewX0 + viewWidth, viewY0, viewY0 + viewHeight);
+    }
 
     const ctx = canvas.getContext('2d');
     
@@ -275,6 +495,8 @@ WebAssembly.instantiateStreaming(fetch('wasmem.wasm'), importObject)
     
     const betaFPSfilter = 1.0 / 100.0;
     var filteredFPS = 0.0;
+    var filteredSPS = 0.0; // timesteps per second
+    var stepsLastFrame = 0;
    
     function main()
     {
@@ -285,24 +507,47 @@ WebAssembly.instantiateStreaming(fetch('wasmem.wasm'), importObject)
         const elapsedTimeSeconds = elapsedTime * 1.0e-3;
         time += elapsedTimeSeconds;
 
-        if (elapsedTimeSeconds > 0.0 && elapsedTimeSeconds < 1.0)
+        if (elapsedTimeSeconds > 0.0 && elapsedTimeSeconds < 1.0) {
             filteredFPS = (betaFPSfilter) * (1.0 / elapsedTimeSeconds) + (1.0 - betaFPSfilter) * filteredFPS; 
+            filteredSPS = (betaFPSfilter) * (stepsLastFrame / elapsedTimeSeconds) + (1.0 - betaFPSfilter) * filteredSPS;
+        }
 
         if (showTestPattern) {
-            renderDataBufferTestPattern(dataArray.byteOffset, 
+            renderDataBufferTestPattern(dataPtr, 
                                         width, 
                                         height,
                                         useViridis);
+        } else if (renderMode != 0) {
+            renderGridBufferField(gridPtr,
+                                  gridStep,
+                                  useViridis,
+                                  colorMode == 0,
+                                  minColorValue,
+                                  maxColorValue);
+        } else {
+            renderDataBufferField(dataPtr, 
+                                  width, 
+                                  height, 
+                                  useViridis,
+                                  colorMode == 0, 
+                                  minColorValue, 
+                                  maxColorValue);
+        }
+        if (colorMode == 1 && !showTestPattern) updateAutoRange();
+        if (renderMode != 0 && !showTestPattern) {
+            refreshGridView();
+            gridCtx.putImageData(gridImg, 0, 0);
+            ctx.imageSmoothingEnabled = true;
+            // (the window's part of the whole grid image)
+            const gw = gridCanvas.width - 1;
+            const gh = gridCanvas.height - 1;
+            const sx = (viewX0 - getImageXmin()) / domainWidth * gw;
+            const sy = (getYmax() - viewY0 - viewHeight) / domainHeight * gh;
+            ctx.drawImage(gridCanvas, sx, sy, viewWidth / domainWidth * gw, viewHeight / domainHeight * gh, 0, 0, width, height);
         } else {
-            renderDataBufferEz(dataArray.byteOffset, 
-                               width, 
-                               height, 
-                               useViridis,
-                               useSourceColorValue, 
-                               minColorValue, 
-                               maxColorValue);
+            refreshImageView();
+            ctx.putImageData(img, 0, 0);
         }
-        ctx.putImageData(img, 0, 0);
 
         if (showStats) {
             ctx.fillStyle = 'rgb(255, 255, 255)';
@@ -317,20 +562,51 @@ WebAssembly.instantiateStreaming(fetch('wasmem.wasm'), importObject)
             if (isSourceAdditive()) src_str += ' additive'; else src_str += ' hardwired';
             ctx.fillText(src_str, 10.0, 60.0);
 
+            var step_str = (useStepBudget ? 'steps/frame = ' + stepsLastFrame + ' (' + stepBudgetMs.toFixed(0) + ' ms budget)' : 'steps/frame = ' + stepsPerFrame);
+            step_str += ', <steps/s> = ' + filteredSPS.toFixed(0) + ' (' + (filteredSPS * getNX() * getNY() * 1.0e-6).toFixed(1) + ' Mcells/s)';
+            ctx.fillText(step_str, 10.0, 80.0);
+
+            var render_str = 'render = ' + renderModes[renderMode];
+            if (renderMode != 0) render_str += ' (' + gridCanvas.width + 'x' + gridCanvas.height + (gridStep > 1 ? ', every ' + gridStep + ' nodes' : '') + ')';
+            if (viewWidth < domainWidth) render_str += ', zoom ' + (domainWidth / viewWidth).toFixed(1) + 'x';
+            if (renderMode == 0 && viewPyramidLevel() > 0) render_str += ', mip level ' + viewPyramidLevel();
+            render_str += ', view = ' + fieldViews[getFieldView()];
+            ctx.fillText(render_str, 10.0, 120.0);
+
+            var color_str = 'colors = ' + colorModes[colorMode] + (isLogColorScale() ? ' (log)' : '');
+            if (colorMode != 0) color_str += ' [' + minColorValue.toExponential(2) + ', ' + maxColorValue.toExponential(2) + ']';
+            ctx.fillText(color_str, 10.0, 140.0);
+
+            if (diagnosticsStep() >= 0) {
+                const uEH = (diagnosticsEnergyE() + diagnosticsEnergyH()) * 1.0e15;
+                ctx.fillText('U = ' + uEH.toExponential(3) + ' [fJ / m], Ez in [' + diagnosticsMinimumEz().toFixed(3) + ', ' + diagnosticsMaximumEz().toFixed(3) + ']', 10.0, 100.0);
+            }
+
             if (!isVacuum()) {
                 ctx.fillText('lossy medium (' + skinLength.toFixed(1) + ' ppsl)', 10.0, 650.0);
             }
             var bc_str = 'BCs: x = ';
-            if (getPeriodicX()) bc_str += 'periodic'; else if (getAbsorbingX()) bc_str += 'absorb'; else bc_str += 'reflect';
+            if (getPeriodicX()) bc_str += 'periodic'; else if (getAbsorbingX()) bc_str += 'absorb'; else if (getCPMLX()) bc_str += 'cpml'; else bc_str += 'reflect';
+            if (mirrorX != 0) bc_str += (mirrorX > 0 ? ' (PMC mirror)' : ' (PEC mirror)');
             bc_str += ', y = ';
-            if (getPeriodicY()) bc_str += 'periodic'; else if (getAbsorbingY()) bc_str += 'absorb'; else bc_str += 'reflect';
-            ctx.fillText('TMz: Ez(x,y), ' + bc_str, 10.0, 670.0);
+            if (getPeriodicY()) bc_str += 'periodic'; else if (getAbsorbingY()) bc_str += 'absorb'; else if (getCPMLY()) bc_str += 'cpml'; else bc_str += 'reflect';
+            if (mirrorY != 0) bc_str += (mirrorY > 0 ? ' (PMC mirror)' : ' (PEC mirror)');
+            ctx.fillText('TMz: Ez(x,y), FDTD(' + getTimeOrder() + ',' + getStencilOrder() + '), S = ' + getCourantFactor().toFixed(3) + ', ' + bc_str, 10.0, 670.0);
             ctx.fillText('xdim, ydim = ' + (domainWidth * 100.0).toFixed(1) + ', ' + (domainHeight * 100.0).toFixed(1) + ' [cm]', 10.0, 690.0);
         }
 
+        stepsLastFrame = 0;
         if (!pauseUpdater) {
-            takeOneTimestep();
-            simTime += getTimestep();
+            if (useStepBudget) {
+                stepsLastFrame = takeTimestepsFor(stepBudgetMs, maxStepsPerFrame);
+            } else if (stepsPerFrame == 1) {
+                takeOneTimestep();
+                stepsLastFrame = 1;
+            } else {
+                takeNTimesteps(stepsPerFrame);
+                stepsLastFrame = stepsPerFrame;
+            }
+            simTime += stepsLastFrame * getTimestep();
         }
 
         window.requestAnimationFrame(main);
@@ -339,16 +615,54 @@ WebAssembly.instantiateStreaming(fetch('wasmem.wasm'), importObject)
     window.addEventListener('keydown', keyDownEvent);
     //window.addEventListener('keyup', keyUpEvent);
 
+    var dragging = false;
+    var dragX = 0.0;
+    var dragY = 0.0;
+
     function handleMouseDown(event) {
         const rect = canvas.getBoundingClientRect();
         const mouseX = event.clientX - rect.left;
         const mouseY = event.clientY - rect.top;
-        const newX = xmin + (mouseX / width) * domainWidth;
-        const newY = domainHeight / 2.0 - (mouseY / height) * domainHeight;
+        if (event.button == 2 || event.shiftKey) { // pan
+            dragging = true;
+            dragX = mouseX;
+            dragY = mouseY;
+            return;
+        }
+        var newX = viewX0 + (mouseX / width) * viewWidth;
+        var newY = viewY0 + viewHeight - (mouseY / height) * viewHeight;
+        if (newX < getXmin()) newX = 2.0 * getXmin() - newX; // (the source of the mirror image)
+        if (newY < getYmin()) newY = 2.0 * getYmin() - newY;
         sourcePlace(newX, newY); 
     }
 
+    function handleMouseMove(event) {
+        if (!dragging) return;
+        const rect = canvas.getBoundingClientRect();
+        const mouseX = event.clientX - rect.left;
+        const mouseY = event.clientY - rect.top;
+        setViewWindow(viewX0 - (mouseX - dragX) / width * viewWidth, viewY0 + (mouseY - dragY) / height * viewHeight, viewWidth);
+        dragX = mouseX;
+        dragY = mouseY;
+    }
+
+    // zoom about the point under the cursor
+    function handleWheel(event) {
+        event.preventDefault();
+        const rect = canvas.getBoundingClientRect();
+        const fx = (event.clientX - rect.left) / width;
+        const fy = 1.0 - (event.clientY - rect.top) / height;
+        const x = viewX0 + fx * viewWidth;
+        const y = viewY0 + fy * viewHeight;
+        const w = viewWidth * Math.exp(0.002 * event.deltaY);
+        setViewWindow(x - fx * w, y - fy * w * domainHeight / domainWidth, w);
+    }
+
     canvas.addEventListener('mousedown', handleMouseDown);
+    canvas.addEventListener('mousemove', handleMouseMove);
+    window.addEventListener('mouseup', function() { dragging = false; });
+    canvas.addEventListener('wheel', handleWheel, { passive: false });
+    canvas.addEventListener('contextmenu', function(event) { event.preventDefault(); });
 
     window.requestAnimationFrame(main); 
 